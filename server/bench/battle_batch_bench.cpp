@@ -0,0 +1,135 @@
+// Rollout throughput of the BattleBatch kernels versus the scalar rules on
+// one BattleState at a time: the same mid-game battles played on in
+// lockstep, every creature attacking the first enemy creature (or the hero)
+// before the turn ends.
+// Usage: battle_batch_bench [battles] [rollout depth]
+
+#include "battle_batch.hpp"
+#include "battle_rules.hpp"
+#include "card_catalog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace cardbattle;
+using Clock = std::chrono::steady_clock;
+
+// Battles a few turns in, with creatures on both sides
+std::vector<BattleState> MakeBattles(std::size_t count, const std::shared_ptr<const CardCatalog>& catalog) {
+    std::mt19937_64 random(1);
+    std::vector<BattleState> battles;
+    std::vector<BattleAction> actions;
+    for (std::size_t i = 0; i < count; ++i) {
+        BattleState state = NewBattleState(std::to_string(i), "host", "guest", random(), catalog);
+        // Play cards only, so the fields fill up
+        for (int step = 0; step < 24 && !state.is_finished; ++step) {
+            ListLegalActions(state, actions);
+            ApplyAction(state, actions.front().type == BattleAction::Type::PLAY_CARD ? actions.front() : actions.back());
+        }
+        battles.push_back(std::move(state));
+    }
+    return battles;
+}
+
+double Seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// One rollout policy step for a scalar battle
+void ScalarStep(BattleState& state) {
+    const int seat = state.current_seat;
+    const auto& field = state.players[seat].field;
+    for (std::size_t slot = 0; slot < field.size(); ++slot) {
+        if (!field[slot].used_this_turn) {
+            const bool no_target = state.players[OpponentSeat(seat)].field.empty();
+            ApplyAttack(state, seat, static_cast<int>(slot), no_target ? kNoSeat : 0);
+            return;
+        }
+    }
+    ApplyEndTurn(state, seat);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096;
+    const int depth = argc > 2 ? std::atoi(argv[2]) : 16;
+    constexpr int kRounds = 50;
+    auto catalog = MakeBuiltinCardCatalog();
+    const auto battles = MakeBattles(count, catalog);
+
+    // Scalar: one battle after another
+    std::vector<BattleState> scalar;
+    long scalar_actions = 0;
+    double scalar_seconds = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        scalar = battles;
+        const auto start = Clock::now();
+        for (auto& state : scalar) {
+            for (int step = 0; step < depth && !state.is_finished; ++step) {
+                ScalarStep(state);
+                ++scalar_actions;
+            }
+        }
+        scalar_seconds += Seconds(start);
+    }
+
+    // Batch: every battle a lane, one kernel call per step, until every
+    // lane is done
+    BattleBatch batch(count, catalog);
+    std::vector<std::int16_t> attacker(count), attacking(count), ending(count), target(count);
+    long batch_actions = 0;
+    double batch_seconds = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        for (std::size_t lane = 0; lane < count; ++lane) batch.Load(lane, battles[lane]);
+        const auto start = Clock::now();
+        for (int step = 0; step < depth; ++step) {
+            batch.FindReadyAttacker(attacker.data());
+            const std::int16_t* seat = batch.CurrentSeat();
+            const std::int16_t* finished = batch.Finished();
+            const std::int16_t* field_count0 = batch.FieldCount(0);
+            const std::int16_t* field_count1 = batch.FieldCount(1);
+            long live = 0;
+            for (std::size_t lane = 0; lane < count; ++lane) {
+                const std::int16_t opponent_count = seat[lane] ? field_count0[lane] : field_count1[lane];
+                attacking[lane] = attacker[lane] >= 0;
+                ending[lane] = attacker[lane] < 0;
+                target[lane] = opponent_count > 0 ? 0 : -1;
+                live += !finished[lane];
+            }
+            if (live == 0) break;
+            batch_actions += live;
+            batch.Attack(attacking.data(), attacker.data(), target.data());
+            batch.EndTurn(ending.data());
+        }
+        batch_seconds += Seconds(start);
+    }
+
+    int mismatches = 0;
+    for (std::size_t lane = 0; lane < count; ++lane) {
+        BattleState state = battles[lane];
+        batch.Store(lane, state);
+        if (state.is_finished != scalar[lane].is_finished || state.winner != scalar[lane].winner ||
+            state.players[0].health != scalar[lane].players[0].health ||
+            state.players[1].health != scalar[lane].players[1].health) {
+            ++mismatches;
+        }
+    }
+
+    std::printf("%zu battles, rollouts of up to %d actions, %d rounds\n", count, depth, kRounds);
+    std::printf("scalar rules: %10ld actions in %.3fs, %6.1f M actions/s\n", scalar_actions, scalar_seconds,
+                scalar_actions / scalar_seconds / 1e6);
+    std::printf("battle batch: %10ld actions in %.3fs, %6.1f M actions/s (%.1fx)\n", batch_actions, batch_seconds,
+                batch_actions / batch_seconds / 1e6, (batch_actions / batch_seconds) / (scalar_actions / scalar_seconds));
+    if (mismatches != 0) {
+        std::fprintf(stderr, "%d battles ended differently\n", mismatches);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+// Counts heap allocations per game action for the old by-value state
+// reads versus shared per-version snapshots.
+// Usage: battle_state_alloc_bench
+
+#include "types.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+namespace {
+
+std::size_t g_allocations = 0;
+
+cardbattle::BattleState MakeBattle() {
+    using cardbattle::Card;
+    cardbattle::BattleState state;
+    state.session_id = "123456";
+    const char* player_ids[] = {"host-user-id-0000000000000000", "guest-user-id-000000000000000"};
+    for (int seat = 0; seat < 2; ++seat) {
+        auto& player = state.players[seat];
+        player.player_id = player_ids[seat];
+        for (int i = 0; i < 10; ++i) {
+            Card card{static_cast<std::uint16_t>(i), 6, 7};
+            if (i < 4) {
+                player.hand.push_back(card);
+            } else if (i < 7) {
+                player.deck.push_back(card);
+            } else if (i < 9) {
+                player.field.push_back(card);
+            } else {
+                player.graveyard.push_back(card);
+            }
+        }
+    }
+    return state;
+}
+
+void Report(const char* name, std::size_t allocations, int actions) {
+    std::printf("%-40s %8.1f allocations/action\n", name, static_cast<double>(allocations) / actions);
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    if (void* ptr = std::malloc(size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+int main() {
+    constexpr int kActions = 1000;
+    cardbattle::BattleState live = MakeBattle();
+
+    // Before: each action broadcasts from a by-value GetBattleState copy and
+    // get_battle_state takes another
+    g_allocations = 0;
+    for (int i = 0; i < kActions; ++i) {
+        live.last_action = "action";
+        ++live.version;
+        cardbattle::BattleState for_broadcast = live;
+        cardbattle::BattleState for_reader = live;
+    }
+    Report("by-value reads (broadcast + 1 reader)", g_allocations, kActions);
+
+    // After: the broadcast serializes the live state in place and readers
+    // share one snapshot per version
+    std::shared_ptr<const cardbattle::BattleState> snapshot;
+    g_allocations = 0;
+    for (int i = 0; i < kActions; ++i) {
+        live.last_action = "action";
+        ++live.version;
+        const cardbattle::BattleState& for_broadcast = live;
+        (void)for_broadcast;
+        for (int reader = 0; reader < 2; ++reader) {
+            if (!snapshot || snapshot->version != live.version) {
+                snapshot = std::make_shared<const cardbattle::BattleState>(live);
+            }
+        }
+    }
+    Report("snapshots (broadcast + 2 readers)", g_allocations, kActions);
+
+    g_allocations = 0;
+    for (int i = 0; i < kActions; ++i) {
+        live.last_action = "action";
+        ++live.version;
+    }
+    Report("snapshots (broadcast only)", g_allocations, kActions);
+    return 0;
+}
@@ -0,0 +1,182 @@
+// Size and encode/decode time of a full BattleState snapshot: the binary
+// codec versus the JSON form snapshots used to be written in.
+// Usage: battle_state_codec_bench
+
+#include "battle_state_codec.hpp"
+#include "card_catalog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include <userver/formats/json.hpp>
+#include <userver/formats/json/value_builder.hpp>
+
+namespace {
+
+using namespace cardbattle;
+namespace json = userver::formats::json;
+
+constexpr const char* kCards =
+    "fire_imp|Fire Imp|A small demon|3|2|2|creature|\n"
+    "stone_golem|Stone Golem|Slow but sturdy|2|6|4|creature|\n"
+    "shadow_assassin|Shadow Assassin|Strikes from the dark|5|1|3|creature|\n"
+    "fireball|Fireball|Deals 3 damage|0|0|3|spell|damage:opponent:3\n"
+    "heal|Heal|Restores 4 health|0|0|2|spell|heal:self:4\n";
+
+// A mid-game battle: 30-card decks partly drawn, played and traded
+BattleState MakeBattle(const std::shared_ptr<const CardCatalog>& catalog) {
+    BattleState state;
+    state.catalog = catalog;
+    state.session_id = "123456";
+    state.version = 57;
+    state.turn_number = 12;
+    state.last_action = "Attack with Shadow Assassin";
+    state.seed = 0x243F6A8885A308D3ull;
+    state.rng.Seed(state.seed);
+    const char* player_ids[] = {"host-user-id-0000000000000000", "guest-user-id-000000000000000"};
+    for (int seat = 0; seat < 2; ++seat) {
+        auto& player = state.players[seat];
+        player.player_id = player_ids[seat];
+        player.health = 17;
+        player.mana = 4;
+        player.max_mana = 6;
+        for (int i = 0; i < 30; ++i) {
+            Card card = catalog->Instantiate(static_cast<std::uint16_t>(i % catalog->Size()));
+            if (i < 5) {
+                player.hand.push_back(card);
+            } else if (i < 21) {
+                player.deck.push_back(card);
+            } else if (i < 25) {
+                player.field.push_back(card);
+            } else {
+                player.graveyard.push_back(card);
+            }
+        }
+    }
+    return state;
+}
+
+json::Value CardsToJson(const Card* begin, const Card* end) {
+    json::ValueBuilder cards(json::Type::kArray);
+    for (const Card* card = begin; card != end; ++card) {
+        json::ValueBuilder card_builder;
+        card_builder["definition"] = static_cast<int>(card->definition);
+        card_builder["attack"] = static_cast<int>(card->attack);
+        card_builder["defense"] = static_cast<int>(card->defense);
+        card_builder["used_this_turn"] = card->used_this_turn;
+        cards.PushBack(card_builder.ExtractValue());
+    }
+    return cards.ExtractValue();
+}
+
+std::string ToJson(const BattleState& state) {
+    json::ValueBuilder builder;
+    builder["session_id"] = state.session_id;
+    builder["version"] = state.version;
+    builder["current_seat"] = state.current_seat;
+    builder["turn_number"] = state.turn_number;
+    builder["winner"] = state.winner;
+    builder["is_finished"] = state.is_finished;
+    builder["last_action"] = state.last_action;
+    builder["seed"] = state.seed;
+    json::ValueBuilder rng_builder(json::Type::kArray);
+    for (int i = 0; i < 4; ++i) rng_builder.PushBack(state.rng.State()[i]);
+    builder["rng"] = rng_builder.ExtractValue();
+    json::ValueBuilder players_builder(json::Type::kArray);
+    for (const auto& player : state.players) {
+        json::ValueBuilder player_builder;
+        player_builder["player_id"] = player.player_id;
+        player_builder["health"] = player.health;
+        player_builder["max_health"] = player.max_health;
+        player_builder["mana"] = player.mana;
+        player_builder["max_mana"] = player.max_mana;
+        player_builder["is_active"] = player.is_active;
+        player_builder["hand"] = CardsToJson(player.hand.begin(), player.hand.end());
+        player_builder["deck"] = CardsToJson(player.deck.begin(), player.deck.end());
+        player_builder["field"] = CardsToJson(player.field.begin(), player.field.end());
+        player_builder["graveyard"] = CardsToJson(player.graveyard.begin(), player.graveyard.end());
+        players_builder.PushBack(player_builder.ExtractValue());
+    }
+    builder["players"] = players_builder.ExtractValue();
+    return json::ToString(builder.ExtractValue());
+}
+
+template <std::size_t Capacity>
+void CardsFromJson(const json::Value& cards_json, InlineVector<Card, Capacity>& cards) {
+    for (const auto& card_json : cards_json) {
+        Card card;
+        card.definition = static_cast<std::uint16_t>(card_json["definition"].As<int>());
+        card.attack = static_cast<std::int16_t>(card_json["attack"].As<int>());
+        card.defense = static_cast<std::int16_t>(card_json["defense"].As<int>());
+        card.used_this_turn = card_json["used_this_turn"].As<bool>();
+        cards.push_back(card);
+    }
+}
+
+BattleState FromJson(const std::string& text, std::shared_ptr<const CardCatalog> catalog) {
+    auto value = json::FromString(text);
+    BattleState state;
+    state.catalog = std::move(catalog);
+    state.session_id = value["session_id"].As<std::string>();
+    state.version = value["version"].As<std::uint64_t>();
+    state.current_seat = value["current_seat"].As<int>();
+    state.turn_number = value["turn_number"].As<int>();
+    state.winner = value["winner"].As<std::string>();
+    state.is_finished = value["is_finished"].As<bool>();
+    state.last_action = value["last_action"].As<std::string>();
+    state.seed = value["seed"].As<std::uint64_t>();
+    std::uint64_t rng_state[4];
+    for (int i = 0; i < 4; ++i) rng_state[i] = value["rng"][i].As<std::uint64_t>();
+    state.rng.SetState(rng_state);
+    for (int seat = 0; seat < 2; ++seat) {
+        const auto player_json = value["players"][seat];
+        auto& player = state.players[seat];
+        player.player_id = player_json["player_id"].As<std::string>();
+        player.health = player_json["health"].As<int>();
+        player.max_health = player_json["max_health"].As<int>();
+        player.mana = player_json["mana"].As<int>();
+        player.max_mana = player_json["max_mana"].As<int>();
+        player.is_active = player_json["is_active"].As<bool>();
+        CardsFromJson(player_json["hand"], player.hand);
+        CardsFromJson(player_json["deck"], player.deck);
+        CardsFromJson(player_json["field"], player.field);
+        CardsFromJson(player_json["graveyard"], player.graveyard);
+    }
+    return state;
+}
+
+template <typename Function>
+double NanosPerCall(int iterations, Function function) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) function();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+} // namespace
+
+int main() {
+    constexpr int kIterations = 20000;
+    std::istringstream input(kCards);
+    auto catalog = CardCatalog::FromImage(CardCatalog::Compile(CardCatalog::ParseText(input, "bench")), "bench");
+    const BattleState state = MakeBattle(catalog);
+
+    const std::string binary = EncodeBattleState(state);
+    const std::string text = ToJson(state);
+    std::size_t sink = 0;
+
+    const double binary_encode = NanosPerCall(kIterations, [&] { sink += EncodeBattleState(state).size(); });
+    const double binary_decode =
+        NanosPerCall(kIterations, [&] { sink += DecodeBattleState(binary, catalog).players[0].deck.size(); });
+    const double json_encode = NanosPerCall(kIterations, [&] { sink += ToJson(state).size(); });
+    const double json_decode = NanosPerCall(kIterations, [&] { sink += FromJson(text, catalog).players[0].deck.size(); });
+
+    std::printf("%-8s %8s %14s %14s\n", "format", "bytes", "encode ns", "decode ns");
+    std::printf("%-8s %8zu %14.0f %14.0f\n", "binary", binary.size(), binary_encode, binary_decode);
+    std::printf("%-8s %8zu %14.0f %14.0f\n", "json", text.size(), json_encode, json_decode);
+    std::printf("ratio    %8.1fx %13.1fx %13.1fx\n", static_cast<double>(text.size()) / binary.size(),
+                json_encode / binary_encode, json_decode / binary_decode);
+    return sink == 0;
+}
@@ -0,0 +1,191 @@
+// Size and encode/decode time of what the battle socket sends: the binary
+// protocol (battle_wire.hpp) versus the JSON text frames, for a full state,
+// a one-action delta and an inbound action.
+// Usage: battle_wire_bench
+
+#include "battle_rules.hpp"
+#include "battle_wire.hpp"
+#include "card_catalog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <userver/formats/json.hpp>
+#include <userver/formats/json/value_builder.hpp>
+
+namespace {
+
+using namespace cardbattle;
+namespace json = userver::formats::json;
+
+// Same fields as BattleWebSocketHandler::BattleStateToJson
+template <typename Zone>
+json::Value ZoneToJson(const Zone& zone, const CardCatalog& catalog) {
+    json::ValueBuilder cards(json::Type::kArray);
+    for (const auto& card : zone) {
+        const CardDefinition definition = catalog.Get(card.definition);
+        json::ValueBuilder card_builder;
+        card_builder["id"] = std::string(definition.id);
+        card_builder["name"] = std::string(definition.name);
+        card_builder["attack"] = static_cast<int>(card.attack);
+        card_builder["defense"] = static_cast<int>(card.defense);
+        card_builder["mana_cost"] = definition.mana_cost;
+        card_builder["type"] = static_cast<int>(definition.type);
+        cards.PushBack(card_builder.ExtractValue());
+    }
+    return cards.ExtractValue();
+}
+
+std::string StateToJson(const BattleState& state) {
+    json::ValueBuilder builder;
+    builder["success"] = true;
+    builder["session_id"] = state.session_id;
+    builder["version"] = state.version;
+    builder["current_turn"] = state.CurrentPlayerId();
+    builder["turn_number"] = state.turn_number;
+    builder["is_finished"] = state.is_finished;
+    builder["winner"] = state.winner;
+    builder["last_action"] = state.last_action;
+    json::ValueBuilder players_builder;
+    for (const auto& player : state.players) {
+        json::ValueBuilder player_builder;
+        player_builder["health"] = player.health;
+        player_builder["max_health"] = player.max_health;
+        player_builder["mana"] = player.mana;
+        player_builder["max_mana"] = player.max_mana;
+        player_builder["is_active"] = player.is_active;
+        player_builder["hand"] = ZoneToJson(player.hand, *state.catalog);
+        player_builder["field"] = ZoneToJson(player.field, *state.catalog);
+        json::ValueBuilder deck_builder;
+        deck_builder["count"] = static_cast<int>(player.deck.size());
+        player_builder["deck"] = deck_builder.ExtractValue();
+        player_builder["graveyard"] = ZoneToJson(player.graveyard, *state.catalog);
+        players_builder[player.player_id] = player_builder.ExtractValue();
+    }
+    builder["players"] = players_builder.ExtractValue();
+    return json::ToString(builder.ExtractValue());
+}
+
+std::vector<WireCard> ZoneFromJson(const json::Value& cards_json) {
+    std::vector<WireCard> cards;
+    for (const auto& card_json : cards_json) {
+        cards.push_back(WireCard{card_json["id"].As<std::string>(), card_json["name"].As<std::string>(),
+                                 card_json["attack"].As<int>(), card_json["defense"].As<int>(),
+                                 card_json["mana_cost"].As<int>(), card_json["type"].As<int>()});
+    }
+    return cards;
+}
+
+// What a JSON client does with a full state
+WireBattleState StateFromJson(const std::string& text) {
+    auto value = json::FromString(text);
+    WireBattleState state;
+    state.session_id = value["session_id"].As<std::string>();
+    state.version = value["version"].As<std::uint64_t>();
+    state.current_turn = value["current_turn"].As<std::string>();
+    state.turn_number = value["turn_number"].As<int>();
+    state.is_finished = value["is_finished"].As<bool>();
+    state.winner = value["winner"].As<std::string>();
+    state.last_action = value["last_action"].As<std::string>();
+    const auto players_json = value["players"];
+    int seat = 0;
+    for (auto it = players_json.begin(); it != players_json.end() && seat < 2; ++it) {
+        const auto& player_json = *it;
+        auto& player = state.players[seat++];
+        player.player_id = it.GetName();
+        player.health = player_json["health"].As<int>();
+        player.max_health = player_json["max_health"].As<int>();
+        player.mana = player_json["mana"].As<int>();
+        player.max_mana = player_json["max_mana"].As<int>();
+        player.is_active = player_json["is_active"].As<bool>();
+        player.hand = ZoneFromJson(player_json["hand"]);
+        player.field = ZoneFromJson(player_json["field"]);
+        player.deck_count = player_json["deck"]["count"].As<int>();
+        player.graveyard = ZoneFromJson(player_json["graveyard"]);
+    }
+    return state;
+}
+
+std::string ActionToJson(const ClientAction& action) {
+    json::ValueBuilder builder;
+    builder["action"] = "attack";
+    builder["attacker_hand_index"] = action.attacker_index;
+    builder["target_hand_index"] = action.target_index;
+    return json::ToString(builder.ExtractValue());
+}
+
+ClientAction ActionFromJson(const std::string& text) {
+    auto value = json::FromString(text);
+    ClientAction action;
+    if (value["action"].As<std::string>() == "attack") action.type = ClientAction::Type::ATTACK;
+    action.attacker_index = value["attacker_hand_index"].As<int>();
+    action.target_index = value["target_hand_index"].As<int>();
+    return action;
+}
+
+template <typename Function>
+double NanosPerCall(int iterations, Function function) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) function();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+void PrintRow(const char* name, std::size_t bytes, double encode, double decode) {
+    std::printf("%-14s %8zu %14.0f %14.0f\n", name, bytes, encode, decode);
+}
+
+} // namespace
+
+int main() {
+    constexpr int kIterations = 20000;
+    // A mid-game battle reached by random legal play
+    const auto catalog = MakeBuiltinCardCatalog();
+    BattleState state = NewBattleState("123456", "host-user-id-0000000000000000", "guest-user-id-000000000000000",
+                                       42, catalog);
+    BattleRng rng(42);
+    std::vector<BattleAction> actions;
+    for (int step = 0; step < 24 && !state.is_finished; ++step) {
+        ListLegalActions(state, actions);
+        ApplyAction(state, actions[rng.NextBelow(static_cast<std::uint32_t>(actions.size()))]);
+        ++state.version;
+    }
+    BattleState after = state;
+    ApplyEndTurn(after, after.current_seat);
+    ++after.version;
+
+    ClientAction action;
+    action.type = ClientAction::Type::ATTACK;
+    action.attacker_index = 1;
+    action.target_index = 2;
+
+    const std::string state_binary = EncodeWireState(state);
+    const std::string state_text = StateToJson(state);
+    const std::string delta_binary = EncodeWireDelta(state, after);
+    const std::string action_binary = EncodeClientAction(action);
+    const std::string action_text = ActionToJson(action);
+    WireBattleState client = DecodeWireState(state_binary);
+    std::size_t sink = 0;
+
+    std::printf("%-14s %8s %14s %14s\n", "message", "bytes", "encode ns", "decode ns");
+    PrintRow("state binary", state_binary.size(), NanosPerCall(kIterations, [&] { sink += EncodeWireState(state).size(); }),
+             NanosPerCall(kIterations, [&] { sink += DecodeWireState(state_binary).players[0].hand.size(); }));
+    PrintRow("state json", state_text.size(), NanosPerCall(kIterations, [&] { sink += StateToJson(state).size(); }),
+             NanosPerCall(kIterations, [&] { sink += StateFromJson(state_text).players[0].hand.size(); }));
+    PrintRow("delta binary", delta_binary.size(),
+             NanosPerCall(kIterations, [&] { sink += EncodeWireDelta(state, after).size(); }),
+             NanosPerCall(kIterations, [&] {
+                 WireBattleState copy = client;
+                 ApplyWireDelta(copy, delta_binary);
+                 sink += copy.players[0].hand.size();
+             }));
+    PrintRow("action binary", action_binary.size(),
+             NanosPerCall(kIterations, [&] { sink += EncodeClientAction(action).size(); }),
+             NanosPerCall(kIterations, [&] { sink += DecodeClientAction(action_binary).target_index; }));
+    PrintRow("action json", action_text.size(), NanosPerCall(kIterations, [&] { sink += ActionToJson(action).size(); }),
+             NanosPerCall(kIterations, [&] { sink += ActionFromJson(action_text).target_index; }));
+    std::printf("state ratio    %7.1fx\n", static_cast<double>(state_text.size()) / state_binary.size());
+    return sink == 0;
+}
@@ -0,0 +1,75 @@
+// Compares the cost of finding a battle's recipients with the old full scan
+// over every connection context against the per-session subscriber index.
+// Usage: broadcast_fanout_bench [iterations]
+
+#include "handlers/session_subscribers.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct FakeConnection {
+    int sent = 0;
+};
+
+struct FakeContext {
+    std::string session_id;
+    std::string user_id;
+    bool session_joined = true;
+};
+
+double NsPerOp(std::chrono::steady_clock::time_point start, int iterations) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+    std::printf("%12s %18s %18s\n", "connections", "full scan ns/op", "index ns/op");
+    for (int connections : {100, 1000, 10000, 100000}) {
+        std::vector<FakeConnection> sockets(connections);
+        std::unordered_map<FakeConnection*, FakeContext> contexts;
+        cardbattle::SessionSubscriberIndex<FakeConnection> index;
+
+        // Two players per battle
+        for (int i = 0; i < connections; ++i) {
+            std::string session_id = std::to_string(100000 + i / 2);
+            contexts[&sockets[i]] = FakeContext{session_id, "user_" + std::to_string(i)};
+            index.Subscribe(&sockets[i], session_id);
+        }
+
+        std::vector<std::string> targets;
+        for (int i = 0; i < iterations; ++i) {
+            targets.push_back(std::to_string(100000 + (i * 7919) % (connections / 2)));
+        }
+
+        // Old BroadcastBattleState: copy every key, then filter by session
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& session_id : targets) {
+            std::vector<FakeConnection*> keys;
+            for (const auto& pair : contexts) keys.push_back(pair.first);
+            for (auto* conn : keys) {
+                const auto& ctx = contexts[conn];
+                if (ctx.session_id == session_id && ctx.session_joined) ++conn->sent;
+            }
+        }
+        double scan_ns = NsPerOp(start, iterations);
+
+        start = std::chrono::steady_clock::now();
+        for (const auto& session_id : targets) {
+            index.ForEach(session_id, [](FakeConnection* conn) { ++conn->sent; });
+        }
+        double index_ns = NsPerOp(start, iterations);
+
+        std::printf("%12d %18.0f %18.0f\n", connections, scan_ns, index_ns);
+    }
+    return 0;
+}
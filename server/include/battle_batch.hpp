@@ -0,0 +1,105 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cardbattle {
+
+// Many battles side by side in structure-of-arrays form, for Monte Carlo
+// rollouts and balance runs that play thousands of games in lockstep. Every
+// number of a battle (health, mana, counts, each field slot's attack and
+// defense, ...) is a column with one int16 per battle ("lane"), so the
+// kernels below run each step of the rules as a loop over contiguous
+// columns with no per-lane branches, which the compiler turns into SIMD.
+// Per-lane choices (which slot attacks, whose turn it is) become compares
+// and selects across the few slots of a zone instead of indexing.
+//
+// The kernels apply exactly what ApplyAttack and ApplyEndTurn do to the
+// numbers; last_action and the other strings are not kept. Lanes run legal
+// actions only (see FindReadyAttacker): unlike the rules, kernels do not
+// validate. Anything else (playing cards, spells) goes through the scalar
+// rules on a stored BattleState and is loaded back.
+//
+// Hand and deck cards are stored as their definition only, since the rules
+// never change a card before it reaches the field.
+class BattleBatch {
+public:
+    // All lanes use `catalog`
+    BattleBatch(std::size_t lanes, std::shared_ptr<const CardCatalog> catalog);
+
+    std::size_t Lanes() const { return lanes_; }
+
+    // Copies a battle into a lane. Throws std::runtime_error if it uses
+    // another catalog.
+    void Load(std::size_t lane, const BattleState& state);
+    // Writes the lane back into a battle loaded from it (or a copy), leaving
+    // its ids, strings, seed and rng alone
+    void Store(std::size_t lane, BattleState& state) const;
+
+    // Per-lane arguments are columns of Lanes() values; lanes with
+    // active == 0 and finished lanes are left alone.
+    //
+    // ApplyAttack for the player to act in each lane. A target outside the
+    // opponent's field attacks the opponent directly.
+    void Attack(const std::int16_t* active, const std::int16_t* attacker_index, const std::int16_t* target_index);
+    // ApplyEndTurn for the player to act in each lane
+    void EndTurn(const std::int16_t* active);
+    // First creature of the player to act that has not attacked this turn,
+    // -1 if there is none or the lane is finished
+    void FindReadyAttacker(std::int16_t* attacker_index) const;
+
+    // Read-only views of single columns, Lanes() values each
+    const std::int16_t* Health(int seat) const { return Column(kHealth + seat); }
+    const std::int16_t* FieldCount(int seat) const { return Column(kFieldCount + seat); }
+    const std::int16_t* CurrentSeat() const { return Column(kSeat); }
+    const std::int16_t* Finished() const { return Column(kFinished); }
+    const std::int16_t* Winner() const { return Column(kWinner); }  // Seat, valid once finished
+
+private:
+    // Column numbers. Per-seat columns come in pairs, per-slot ones in runs
+    // of seat * capacity + slot.
+    static constexpr std::size_t kFieldSlots = kMaxFieldSize;
+    static constexpr std::size_t kHandSlots = kMaxHandSize;
+    static constexpr std::size_t kDeckSlots = kMaxDeckSize;
+    static constexpr std::size_t kGraveyardSlots = kMaxGraveyardSize;
+    static constexpr std::size_t kHealth = 0;
+    static constexpr std::size_t kMaxHealth = kHealth + 2;
+    static constexpr std::size_t kMana = kMaxHealth + 2;
+    static constexpr std::size_t kMaxMana = kMana + 2;
+    static constexpr std::size_t kTurn = kMaxMana + 2;
+    static constexpr std::size_t kSeat = kTurn + 1;
+    static constexpr std::size_t kFinished = kSeat + 1;
+    static constexpr std::size_t kWinner = kFinished + 1;
+    static constexpr std::size_t kFieldCount = kWinner + 1;
+    static constexpr std::size_t kHandCount = kFieldCount + 2;
+    static constexpr std::size_t kDeckCount = kHandCount + 2;
+    static constexpr std::size_t kGraveyardCount = kDeckCount + 2;
+    static constexpr std::size_t kFieldDefinition = kGraveyardCount + 2;
+    static constexpr std::size_t kFieldAttack = kFieldDefinition + 2 * kFieldSlots;
+    static constexpr std::size_t kFieldDefense = kFieldAttack + 2 * kFieldSlots;
+    static constexpr std::size_t kFieldUsed = kFieldDefense + 2 * kFieldSlots;
+    static constexpr std::size_t kHandDefinition = kFieldUsed + 2 * kFieldSlots;
+    static constexpr std::size_t kDeckDefinition = kHandDefinition + 2 * kHandSlots;
+    static constexpr std::size_t kGraveyardDefinition = kDeckDefinition + 2 * kDeckSlots;
+    static constexpr std::size_t kGraveyardAttack = kGraveyardDefinition + 2 * kGraveyardSlots;
+    static constexpr std::size_t kGraveyardDefense = kGraveyardAttack + 2 * kGraveyardSlots;
+    static constexpr std::size_t kGraveyardUsed = kGraveyardDefense + 2 * kGraveyardSlots;
+    static constexpr std::size_t kColumnCount = kGraveyardUsed + 2 * kGraveyardSlots;
+
+    std::int16_t* Column(std::size_t column) { return data_.data() + column * stride_; }
+    const std::int16_t* Column(std::size_t column) const { return data_.data() + column * stride_; }
+    std::int16_t* Scratch(std::size_t index) { return scratch_.data() + index * stride_; }
+    // Appends the field card in `slot` to the same seat's graveyard
+    void BuryFieldCard(std::size_t lane, int seat, int slot);
+
+    std::size_t lanes_;
+    std::size_t stride_;  // Lanes rounded up to a whole number of vectors
+    std::shared_ptr<const CardCatalog> catalog_;
+    std::vector<std::int16_t> data_;
+    std::vector<std::int16_t> scratch_;  // Per-call temporaries, kept to avoid allocating
+};
+
+} // namespace cardbattle
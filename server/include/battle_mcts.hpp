@@ -0,0 +1,52 @@
+#pragma once
+
+#include "battle_rules.hpp"
+#include "types.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cardbattle {
+
+// Monte Carlo tree search for the player to act, on the plain game rules
+// (no userver), so the server's bot and offline tools search the same way.
+//
+// The searcher sees the whole BattleState, but plays fair: each tree first
+// deals the cards it cannot know (the opponent's hand and both decks) at
+// random from the same pool and reseeds the battle rng, then searches that
+// one world. Root parallelism runs several trees on different deals and
+// different seeds and lets them vote (PickMctsAction); the bot's own moves
+// do not depend on the deal, so the roots of all trees line up.
+
+struct MctsSettings {
+    // Per tree; 0 runs until the deadline
+    std::size_t max_iterations = 0;
+    // Random moves per playout before the position is scored on health
+    int rollout_depth = 40;
+    // UCB1 exploration constant
+    double exploration = 1.0;
+    // The tree stops growing here and keeps playing out from its leaves
+    std::size_t max_nodes = 1 << 18;
+};
+
+// What one tree learned about the moves at its root
+struct MctsRootStats {
+    std::vector<BattleAction> actions;  // ListLegalActions order
+    std::vector<std::uint32_t> visits;
+    std::vector<double> rewards;  // Summed over visits, 1 = win for the searching player
+    std::size_t iterations = 0;
+};
+
+// Grows one tree from `state` until `deadline` or settings.max_iterations;
+// at least one iteration runs, so there is a move even past the deadline.
+// `seed` picks the deal and the playouts; the same seed and iteration count
+// give the same result. Empty stats if the battle is finished.
+MctsRootStats RunMctsTree(const BattleState& state, std::uint64_t seed, const MctsSettings& settings,
+                          std::chrono::steady_clock::time_point deadline);
+
+// Root-parallel vote: the move with the most visits summed over all trees.
+// Throws std::runtime_error if no tree has a move.
+BattleAction PickMctsAction(const std::vector<MctsRootStats>& trees);
+
+} // namespace cardbattle
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "types.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cardbattle {
+
+// Journal records and what recovery makes of them, with no userver or I/O:
+// BattleJournal writes and reads the records, BattleManager::RecoverBattles
+// feeds what it read to ReplayJournal, and the tests feed it made-up
+// segments.
+
+enum class JournalRecordType : std::uint8_t {
+    BATTLE_STARTED = 1,  // seed and seats; the deck setup follows from them
+    PLAY_CARD,           // arg0 = hand index
+    ATTACK,              // arg0 = attacker index, arg1 = target index
+    END_TURN,
+    SURRENDER,
+    BATTLE_ENDED,        // Battle dropped from memory, nothing to recover
+    BATTLE_HIBERNATED    // Battle moved to disk; recovered from there on access
+};
+
+// One accepted action. Strings are views: into the caller's data when
+// appending, into the mapped segment when reading.
+struct JournalRecord {
+    JournalRecordType type = JournalRecordType::END_TURN;
+    int seat = kNoSeat;  // Acting seat
+    int arg0 = 0;
+    int arg1 = 0;
+    std::uint64_t version = 0;  // State version after the action
+    std::uint64_t seed = 0;     // BATTLE_STARTED only
+    std::string_view session_id;
+    std::string_view host_id;   // BATTLE_STARTED only
+    std::string_view guest_id;  // BATTLE_STARTED only
+};
+
+// A record copied out of its segment before it is unmapped
+struct OwnedJournalRecord {
+    JournalRecordType type = JournalRecordType::END_TURN;
+    int seat = kNoSeat;
+    int arg0 = 0;
+    int arg1 = 0;
+    std::uint64_t version = 0;
+    std::uint64_t seed = 0;
+    std::string session_id;
+    std::string host_id;
+    std::string guest_id;
+
+    OwnedJournalRecord() = default;
+    explicit OwnedJournalRecord(const JournalRecord& record);
+};
+
+struct ReplayResult {
+    std::vector<BattleState> battles;  // The battles that were live
+    // Battles that could not be rebuilt: session id and why
+    std::vector<std::pair<std::string, std::string>> failed;
+    std::size_t records = 0;
+};
+
+// Rebuilds the live battles from journal segments (oldest first, each in
+// append order). Each battle starts from its entry in `snapshots` if there
+// is one of the same battle, else from its journaled start, then replays
+// the journaled actions newer than that. Battles that ended, and battles
+// whose last record hibernated them, are left out. Replay is spread over
+// `threads` OS threads.
+ReplayResult ReplayJournal(const std::vector<std::vector<OwnedJournalRecord>>& segments,
+                           std::vector<BattleState> snapshots, std::shared_ptr<const CardCatalog> catalog,
+                           unsigned threads);
+
+// Runs func(0..count-1) on up to `threads` OS threads; rethrows the first error
+template <typename Func>
+void ParallelFor(std::size_t count, unsigned threads, const Func& func) {
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&] {
+        for (std::size_t i = next++; i < count; i = next++) {
+            try {
+                func(i);
+            } catch (...) {
+                std::lock_guard lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    const auto extra = std::min<std::size_t>(threads, count);
+    for (std::size_t t = 1; t < extra; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+    if (error) std::rethrow_exception(error);
+}
+
+// Applies a journaled action with the same rules the live path used
+void ApplyJournaled(BattleState& battle_state, JournalRecordType type, int seat, int arg0, int arg1);
+
+// What one segment holds of each battle, enough to tell when recovery no
+// longer needs it
+struct JournalSegmentSummary {
+    struct Battle {
+        std::uint64_t max_version = 0;  // Newest version journaled for it
+        bool ended = false;             // Its last record here is BATTLE_ENDED
+    };
+
+    std::string path;
+    std::unordered_map<std::string, Battle> battles;
+
+    void Add(const JournalRecord& record);
+};
+
+// Whether recovery can do without a segment's records of one battle.
+// `snapshot_version` is that of its persisted snapshot, if it has one;
+// `live` is whether it is resident or hibernated. Replay skips everything
+// up to a snapshot, so one at least as new covers the records; an ended
+// battle needs nothing, as long as no snapshot brings it back; and a live
+// battle without a snapshot needs every record from its start.
+bool IsJournalCovered(const JournalSegmentSummary::Battle& battle, std::optional<std::uint64_t> snapshot_version,
+                      bool live);
+
+// How many of the oldest segments can be deleted: the longest run from the
+// front in which `covered` holds for every battle. Only a prefix, because a
+// kept older segment could otherwise outlive the end of a battle it starts.
+std::size_t RetirableSegments(
+    const std::vector<std::shared_ptr<const JournalSegmentSummary>>& segments,
+    const std::function<bool(const std::string& session_id, const JournalSegmentSummary::Battle& battle)>& covered);
+
+} // namespace cardbattle
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace cardbattle {
+
+// Small seeded PRNG owned by each battle (xoshiro256**, seeded through
+// splitmix64). Given the same seed and the same actions a battle plays out
+// bit-for-bit the same, on any platform: unlike std::shuffle and the
+// std::*_distribution types, every step here is spelled out.
+class BattleRng {
+public:
+    BattleRng() { Seed(0); }
+    explicit BattleRng(std::uint64_t seed) { Seed(seed); }
+
+    void Seed(std::uint64_t seed) {
+        std::uint64_t x = seed;
+        for (auto& word : state_) word = SplitMix64(x);
+    }
+
+    std::uint64_t Next() {
+        const std::uint64_t result = Rotl(state_[1] * 5, 7) * 9;
+        const std::uint64_t t = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = Rotl(state_[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound) without modulo bias (Lemire's method)
+    std::uint32_t NextBelow(std::uint32_t bound) {
+        std::uint64_t product = (Next() >> 32) * bound;
+        auto low = static_cast<std::uint32_t>(product);
+        if (low < bound) {
+            const std::uint32_t threshold = static_cast<std::uint32_t>(-bound) % bound;
+            while (low < threshold) {
+                product = (Next() >> 32) * bound;
+                low = static_cast<std::uint32_t>(product);
+            }
+        }
+        return static_cast<std::uint32_t>(product >> 32);
+    }
+
+    // Fisher-Yates over [first, last)
+    template <typename RandomIt>
+    void Shuffle(RandomIt first, RandomIt last) {
+        const auto count = static_cast<std::uint32_t>(last - first);
+        for (std::uint32_t i = count; i > 1; --i) {
+            using std::swap;
+            swap(first[i - 1], first[NextBelow(i)]);
+        }
+    }
+
+    // Raw state, for persisting a battle mid-game
+    const std::uint64_t* State() const { return state_; }
+    void SetState(const std::uint64_t (&state)[4]) {
+        for (std::size_t i = 0; i < 4; ++i) state_[i] = state[i];
+    }
+
+    // Mixes a counter into a well-spread 64-bit value; also used to derive seeds
+    static std::uint64_t SplitMix64(std::uint64_t& x) {
+        std::uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+private:
+    static std::uint64_t Rotl(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    std::uint64_t state_[4];
+};
+
+} // namespace cardbattle
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cardbattle {
+
+// The game rules as plain functions on a BattleState, with no userver, I/O
+// or logging, so the server, journal replay and the headless simulator
+// (tools/battle_simulator.cpp) all run exactly the same code.
+//
+// Actions check everything before they change anything: an illegal action
+// throws std::runtime_error and leaves the state as it was. Given the same
+// state, actions are deterministic; all randomness comes from state.rng.
+
+// The cards battles are played with when no compiled catalog is loaded;
+// mirrors configs/cards.txt
+std::shared_ptr<const CardCatalog> MakeBuiltinCardCatalog();
+
+// Card ids every player's deck is built from
+const std::vector<std::string>& StarterDeckCardIds();
+
+// Fresh battle: both decks built from the starter deck and shuffled, opening
+// hands drawn, the host to move. Starter cards missing from `catalog` are
+// left out.
+BattleState NewBattleState(const std::string& session_id, const std::string& host_id, const std::string& guest_id,
+                           std::uint64_t seed, std::shared_ptr<const CardCatalog> catalog);
+
+void ApplyPlayCard(BattleState& battle_state, int seat, int hand_index);
+// A target_index outside the opponent's field attacks the opponent directly
+void ApplyAttack(BattleState& battle_state, int attacker_seat, int attacker_index, int target_index);
+void ApplyEndTurn(BattleState& battle_state, int seat);
+void ApplySurrender(BattleState& battle_state, int seat);
+void EndGame(BattleState& battle_state, int winner_seat);
+
+// One move of the player to act, for bots and simulations
+struct BattleAction {
+    enum class Type : std::uint8_t { PLAY_CARD, ATTACK, END_TURN };
+
+    Type type = Type::END_TURN;
+    int arg0 = 0;  // Hand index to play, or attacking creature
+    int arg1 = 0;  // Attack target on the opponent's field, kNoSeat for the hero
+};
+
+// Replaces `actions` with every legal move of the player to act; empty once
+// the battle is finished. END_TURN is always last.
+void ListLegalActions(const BattleState& battle_state, std::vector<BattleAction>& actions);
+// Applies a move for the player to act
+void ApplyAction(BattleState& battle_state, const BattleAction& action);
+
+} // namespace cardbattle
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "types.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace cardbattle {
+
+// Compact versioned binary form of a whole BattleState: turn data, all four
+// card zones of both players, the seed and the RNG position. Used for
+// snapshots (persistence, recovery, hibernation) and anything else that
+// must restore a battle exactly.
+//
+// Integers are LEB128 varints (zigzag for signed values), so the encoding
+// is independent of byte order and a mid-game battle takes about 300
+// bytes, against over 4 KB as JSON. Cards refer to their definitions
+// through a per-state table of card ids rather than catalog indices, so a
+// snapshot stays valid across catalog reloads that reorder cards.
+constexpr std::uint8_t kBattleStateCodecVersion = 1;
+
+std::string EncodeBattleState(const BattleState& state);
+
+// Rebuilds a state encoded by EncodeBattleState, resolving cards against
+// `catalog` (which the state then pins). Throws std::runtime_error on
+// malformed input, an unknown format version or a card missing from the
+// catalog.
+BattleState DecodeBattleState(std::string_view data, std::shared_ptr<const CardCatalog> catalog);
+
+} // namespace cardbattle
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "types.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cardbattle {
+
+// Binary form of the battle socket's messages, for clients that ask for the
+// kBinaryWireProtocol WebSocket subprotocol; others get JSON text frames.
+// States, deltas and actions travel as binary frames; errors stay JSON text.
+//
+// A message is a type byte and its fields, with integers as varints (see
+// byte_io.hpp). States and deltas carry the same information as their JSON
+// forms (BattleWebSocketHandler::BattleStateToJson and
+// BattleStateDeltaToJson), but a card is an index into a table of the
+// message's distinct cards (id, name, mana cost, type) plus its attack and
+// defense, so nothing is spelled out twice.
+//
+// The Decode/Apply functions are the client side, kept here as the
+// reference for client authors and for tests.
+constexpr std::string_view kBinaryWireProtocol = "zzcb.binary.v1";
+
+enum class WireMessageType : std::uint8_t {
+    // Server to client
+    STATE = 1,
+    DELTA = 2,
+    DEFLATED = 3,  // Either of the above, compressed (frame_deflate.hpp)
+    // Client to server
+    ACTION = 16,
+};
+
+// What a client sees of a card
+struct WireCard {
+    std::string id;
+    std::string name;
+    int attack = 0;
+    int defense = 0;
+    int mana_cost = 0;
+    int type = 0;
+
+    bool operator==(const WireCard&) const = default;
+};
+
+struct WirePlayer {
+    std::string player_id;
+    int health = 0;
+    int max_health = 0;
+    int mana = 0;
+    int max_mana = 0;
+    bool is_active = false;
+    std::vector<WireCard> hand;
+    std::vector<WireCard> field;
+    int deck_count = 0;
+    std::vector<WireCard> graveyard;
+
+    bool operator==(const WirePlayer&) const = default;
+};
+
+// What a client sees of a battle
+struct WireBattleState {
+    std::string session_id;
+    std::uint64_t version = 0;
+    std::string current_turn;  // Player id
+    int turn_number = 0;
+    bool is_finished = false;
+    std::string winner;
+    std::string last_action;
+    std::array<WirePlayer, 2> players;  // By seat
+
+    bool operator==(const WireBattleState&) const = default;
+};
+
+// Server side
+std::string EncodeWireState(const BattleState& state);
+// The change from `before` to the next version `after`
+std::string EncodeWireDelta(const BattleState& before, const BattleState& after);
+
+// Client side. Throw std::runtime_error on malformed input; ApplyWireDelta
+// also throws if `state` is not at the delta's base version (the client
+// should resync), leaving it unchanged.
+WireBattleState DecodeWireState(std::string_view data);
+void ApplyWireDelta(WireBattleState& state, std::string_view data);
+
+// A request from a client, either encoding
+struct ClientAction {
+    enum class Type : std::uint8_t {
+        UNKNOWN = 0,
+        JOIN_SESSION = 1,
+        PLAY_CARD = 2,
+        ATTACK = 3,
+        END_TURN = 4,
+        SURRENDER = 5,
+        GET_BATTLE_STATE = 6,
+        RESYNC = 7,
+    };
+
+    Type type = Type::UNKNOWN;
+    std::string session_id;  // JOIN_SESSION
+    std::string user_id;     // JOIN_SESSION
+    bool delta_updates = false;  // JOIN_SESSION
+    bool deflate = false;        // JOIN_SESSION
+    int hand_index = 0;          // PLAY_CARD
+    int attacker_index = 0;      // ATTACK
+    int target_index = 0;        // ATTACK
+
+    bool operator==(const ClientAction&) const = default;
+};
+
+std::string EncodeClientAction(const ClientAction& action);
+// Throws std::runtime_error on malformed input or an unknown action type
+ClientAction DecodeClientAction(std::string_view data);
+
+} // namespace cardbattle
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace cardbattle {
+
+// Byte buffers for the binary encodings (battle_state_codec.hpp,
+// battle_wire.hpp). Integers are LEB128 varints, zigzag for signed values,
+// so the encodings are independent of byte order and small numbers take a
+// byte.
+
+// Appends into a buffer grown ahead of the cursor, so the per-field cost
+// is a bounds check and a few stores
+class ByteWriter {
+public:
+    explicit ByteWriter(std::size_t initial_size = 512) { out_.resize(initial_size); }
+
+    void Bytes(const void* data, std::size_t size) {
+        char* out = Reserve(size);
+        std::memcpy(out, data, size);
+        size_ += size;
+    }
+
+    void U8(std::uint8_t value) {
+        *Reserve(1) = static_cast<char>(value);
+        ++size_;
+    }
+
+    void Varint(std::uint64_t value) {
+        char* out = Reserve(10);
+        char* begin = out;
+        while (value >= 0x80) {
+            *out++ = static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<char>(value);
+        size_ += static_cast<std::size_t>(out - begin);
+    }
+
+    void Signed(std::int64_t value) {
+        Varint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+    }
+
+    void String(std::string_view value) {
+        Varint(value.size());
+        Bytes(value.data(), value.size());
+    }
+
+    std::string Finish() {
+        out_.resize(size_);
+        return std::move(out_);
+    }
+
+private:
+    char* Reserve(std::size_t size) {
+        if (out_.size() - size_ < size) out_.resize(std::max(out_.size() * 2, size_ + size));
+        return out_.data() + size_;
+    }
+
+    std::string out_;
+    std::size_t size_ = 0;
+};
+
+// Reads what ByteWriter wrote. Throws std::runtime_error, prefixed with
+// `what` ("Battle state: truncated"), on malformed input.
+class ByteReader {
+public:
+    ByteReader(std::string_view data, const char* what) : data_(data), what_(what) {}
+
+    std::uint8_t U8() {
+        Need(1);
+        return static_cast<std::uint8_t>(data_[offset_++]);
+    }
+
+    std::uint64_t Varint() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const std::uint8_t byte = U8();
+            value |= std::uint64_t{byte & 0x7fu} << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        Fail("varint too long");
+    }
+
+    std::int64_t Signed() {
+        const std::uint64_t value = Varint();
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
+
+    // Varint bounded to [min, max], for fields narrower than 64 bits
+    std::int64_t Int(std::int64_t min, std::int64_t max) {
+        const std::int64_t value = Signed();
+        if (value < min || value > max) Fail("value out of range");
+        return value;
+    }
+
+    std::uint64_t Count(std::uint64_t max) {
+        const std::uint64_t value = Varint();
+        if (value > max) Fail("count out of range");
+        return value;
+    }
+
+    std::string_view String() {
+        const std::uint64_t size = Varint();
+        Need(size);
+        std::string_view value = data_.substr(offset_, size);
+        offset_ += size;
+        return value;
+    }
+
+    void Bytes(void* out, std::size_t size) {
+        Need(size);
+        std::memcpy(out, data_.data() + offset_, size);
+        offset_ += size;
+    }
+
+    bool AtEnd() const { return offset_ == data_.size(); }
+
+    [[noreturn]] void Fail(const char* problem) const {
+        throw std::runtime_error(std::string(what_) + ": " + problem);
+    }
+
+private:
+    void Need(std::uint64_t size) const {
+        if (size > data_.size() - offset_) Fail("truncated");
+    }
+
+    std::string_view data_;
+    const char* what_;
+    std::size_t offset_ = 0;
+};
+
+} // namespace cardbattle
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cardbattle {
+
+// Source form of a card, as written in the text catalog (configs/cards.txt)
+struct CardSpec {
+    std::string id;
+    std::string name;
+    std::string description;
+    int attack = 0;
+    int defense = 0;
+    int mana_cost = 0;
+    CardType type = CardType::CREATURE;
+    InlineVector<CardEffect, kMaxCardEffects> effects;
+};
+
+// Immutable table of card definitions backed by one binary image: either a
+// memory-mapped file produced by CardCatalogCompiler or an in-memory image
+// of the built-in cards. Lookups by id go through a hash index stored in
+// the image, so loading does no per-card work beyond validation.
+//
+// In-battle Cards refer to definitions by index, so a catalog must outlive
+// every battle that uses it.
+class CardCatalog {
+public:
+    // Parses the text form: one card per line,
+    //   id|name|description|attack|defense|mana_cost|creature or spell|effects
+    // where effects is a comma-separated list of op:target:amount, e.g.
+    // damage:opponent:3. Blank lines and lines starting with '#' are skipped.
+    static std::vector<CardSpec> ParseText(std::istream& input, const std::string& source_name);
+
+    // Builds the binary image the server maps at startup
+    static std::string Compile(const std::vector<CardSpec>& cards);
+
+    // Maps a compiled catalog file read-only
+    static std::shared_ptr<const CardCatalog> Load(const std::string& path);
+
+    // Catalog over an in-memory image (built-in cards)
+    static std::shared_ptr<const CardCatalog> FromImage(std::string image, std::string source_name);
+
+    ~CardCatalog();
+    CardCatalog(const CardCatalog&) = delete;
+    CardCatalog& operator=(const CardCatalog&) = delete;
+
+    // Views into the image, valid as long as the catalog
+    CardDefinition Get(std::uint16_t index) const;
+    std::optional<std::uint16_t> Find(std::string_view id) const;
+    std::size_t Size() const { return card_count_; }
+
+    // Fresh in-battle instance with the definition's base stats
+    Card Instantiate(std::uint16_t index) const;
+
+    // File path or "<built-in>", for logs
+    const std::string& SourceName() const { return source_name_; }
+
+private:
+    struct Record;
+
+    CardCatalog() = default;
+    void Validate();
+    const Record& GetRecord(std::uint16_t index) const;
+    std::string_view GetString(std::uint32_t offset, std::uint16_t length) const;
+
+    std::string source_name_;
+    std::string owned_image_;  // Empty when the image is a mapped file
+    void* mapping_ = nullptr;
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::uint32_t card_count_ = 0;
+    std::uint32_t index_slots_ = 0;
+    const Record* records_ = nullptr;
+    const std::uint32_t* index_ = nullptr;
+    const char* strings_ = nullptr;
+    std::uint32_t strings_size_ = 0;
+};
+
+} // namespace cardbattle
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace cardbattle {
+
+// Compression for battle socket frames, for clients that ask for it on
+// join_session. A deflated frame is a binary frame holding the
+// WireMessageType::DEFLATED byte and then the message (a JSON text or a
+// binary wire message) compressed the way permessage-deflate (RFC 7692)
+// compresses a message: raw deflate, sync-flushed, without the trailing
+// 00 00 ff ff. Clients with a permessage-deflate inflater can feed it the
+// bytes after the type byte.
+//
+// With context takeover the window carries over from one message to the
+// next, so repeated card names and keys cost a few bytes each after their
+// first appearance; frames must then reach the client in the order they
+// were deflated. Without it each frame stands alone, so one deflated frame
+// can go to every client.
+
+// Compresses messages for one client (or, without context takeover, for
+// any number of them)
+class FrameDeflater {
+public:
+    // `level` is zlib's, 1 (fastest) to 9 (smallest)
+    FrameDeflater(int level, bool context_takeover);
+    ~FrameDeflater();
+
+    FrameDeflater(const FrameDeflater&) = delete;
+    FrameDeflater& operator=(const FrameDeflater&) = delete;
+
+    std::string Deflate(std::string_view message);
+
+private:
+    struct Stream;
+    std::unique_ptr<Stream> stream_;
+    bool context_takeover_;
+};
+
+// Client side, kept as the reference for client authors and for tests.
+// Throws std::runtime_error on a malformed frame, after which a context
+// takeover inflater is out of step and the client should reconnect.
+class FrameInflater {
+public:
+    explicit FrameInflater(bool context_takeover);
+    ~FrameInflater();
+
+    FrameInflater(const FrameInflater&) = delete;
+    FrameInflater& operator=(const FrameInflater&) = delete;
+
+    std::string Inflate(std::string_view frame);
+
+private:
+    struct Stream;
+    std::unique_ptr<Stream> stream_;
+    bool context_takeover_;
+};
+
+} // namespace cardbattle
@@ -36,4 +36,13 @@ public:
     std::string HandleRequestThrow(const userver::server::http::HttpRequest& request, userver::server::request::RequestContext&) const override;
 };
 
+// Seats a bot as the guest of the caller's session
+class AddBotHandler final : public userver::server::handlers::HttpHandlerBase {
+public:
+    static constexpr std::string_view kName = "handler-add-bot";
+    using HttpHandlerBase::HttpHandlerBase;
+
+    std::string HandleRequestThrow(const userver::server::http::HttpRequest& request, userver::server::request::RequestContext&) const override;
+};
+
 } // namespace cardbattle 
\ No newline at end of file
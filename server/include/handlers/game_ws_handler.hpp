@@ -1,16 +1,18 @@
 #pragma once
 #include <userver/server/websocket/websocket_handler.hpp>
 #include <userver/formats/json.hpp>
+#include <userver/yaml_config/schema.hpp>
 #include "../types.hpp"
 #include "../../src/sqlite_db.hpp"
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 namespace cardbattle {
 
 // Forward declarations
-class BattleState;
+struct BattleState;
 class BattleManager;
 class GameSessionManager;
 class UserManager;
@@ -18,14 +20,38 @@ class UserManager;
 class BattleWebSocketHandler final : public userver::server::websocket::WebsocketHandlerBase {
 public:
     static constexpr std::string_view kName = "handler-battle-ws";
-    using WebsocketHandlerBase::WebsocketHandlerBase;
+
+    BattleWebSocketHandler(const userver::components::ComponentConfig& config,
+                           const userver::components::ComponentContext& context);
+
+    static userver::yaml_config::Schema GetStaticConfigSchema();
+
+    // A connection's socket as senders share it, with its compression
+    // context (see frame_deflate.hpp)
+    struct SendChannel;
 
     struct ConnectionContext {
         std::string session_id;
         std::string user_id;
+        int seat = kNoSeat;  // Resolved once on join_session
         bool session_joined = false;
+        // Opted in on join_session ("updates": "delta"): after the full
+        // state, each action sends only what changed. See BattleStateDeltaToJson.
+        bool delta_updates = false;
+        // Negotiated the kBinaryWireProtocol subprotocol: states, deltas
+        // and actions are binary frames (see battle_wire.hpp)
+        bool binary_wire = false;
+        // Asked for on join_session ("compression": "deflate") and allowed by
+        // the config: states over the size threshold go out deflated
+        bool deflate = false;
+        // Shared with broadcasts, which send after releasing the connections lock
+        std::shared_ptr<SendChannel> channel;
     };
 
+    // Accepts the kBinaryWireProtocol subprotocol when the client offers it
+    bool HandleHandshake(const userver::server::http::HttpRequest& request,
+                         userver::server::http::HttpResponse& response,
+                         userver::server::request::RequestContext& context) const override;
     void Handle(userver::server::websocket::WebSocketConnection& websocket, userver::server::request::RequestContext& context) const override;
 
 private:
@@ -33,9 +59,15 @@ private:
 
 public:
     static void BroadcastSessionUpdate(const std::string& session_id);
+    // Sends the current state to the session's clients, each in its format
     static void BroadcastBattleState(const std::string& session_id);
     static void RefreshAllClients(const std::string& session_id);
     static std::string BattleStateToJson(const BattleState& state);
+    // The change from `before` to the next version `after`: the scalars
+    // that changed and, per changed player, each changed zone's new size
+    // plus the cards that differ at their index. Carries base_version and
+    // version; a client whose state is not at base_version sends "resync".
+    static std::string BattleStateDeltaToJson(const BattleState& before, const BattleState& after);
     static std::string GetPlayerKey(const std::string& player_id, const BattleState& state);
 
     static void HandleStartBattle(userver::server::websocket::WebSocketConnection& websocket,
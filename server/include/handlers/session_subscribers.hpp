@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cardbattle {
+
+// Index of which connections are subscribed to which game session.
+// Lets broadcasts touch only the sockets of one battle instead of scanning
+// every open connection. Not synchronized; the owner guards it.
+template <typename Connection>
+class SessionSubscriberIndex {
+public:
+    // Subscribes the connection to a session, moving it out of any session it
+    // was subscribed to before (a socket follows one battle at a time).
+    void Subscribe(Connection* conn, const std::string& session_id) {
+        auto it = session_of_.find(conn);
+        if (it != session_of_.end()) {
+            if (it->second == session_id) return;
+            RemoveFromSession(conn, it->second);
+            it->second = session_id;
+        } else {
+            session_of_.emplace(conn, session_id);
+        }
+        by_session_[session_id].insert(conn);
+    }
+
+    void Unsubscribe(Connection* conn) {
+        auto it = session_of_.find(conn);
+        if (it == session_of_.end()) return;
+        RemoveFromSession(conn, it->second);
+        session_of_.erase(it);
+    }
+
+    // Copies the subscribers out so callers can send without holding the lock
+    std::vector<Connection*> Subscribers(const std::string& session_id) const {
+        auto it = by_session_.find(session_id);
+        if (it == by_session_.end()) return {};
+        return std::vector<Connection*>(it->second.begin(), it->second.end());
+    }
+
+    template <typename Func>
+    void ForEach(const std::string& session_id, Func&& func) const {
+        auto it = by_session_.find(session_id);
+        if (it == by_session_.end()) return;
+        for (auto* conn : it->second) func(conn);
+    }
+
+    std::size_t SubscriberCount(const std::string& session_id) const {
+        auto it = by_session_.find(session_id);
+        return it == by_session_.end() ? 0 : it->second.size();
+    }
+
+    std::size_t SessionCount() const { return by_session_.size(); }
+
+private:
+    void RemoveFromSession(Connection* conn, const std::string& session_id) {
+        auto it = by_session_.find(session_id);
+        if (it == by_session_.end()) return;
+        it->second.erase(conn);
+        if (it->second.empty()) by_session_.erase(it);
+    }
+
+    std::unordered_map<std::string, std::unordered_set<Connection*>> by_session_;
+    std::unordered_map<Connection*, std::string> session_of_;
+};
+
+} // namespace cardbattle
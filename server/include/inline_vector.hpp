@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+
+namespace cardbattle {
+
+// Vector with a fixed capacity stored inline, no heap allocations. Meant for
+// small trivially copyable elements (Card), so the whole container is
+// trivially copyable too. Callers check full() where the rules allow
+// overflow; pushing into a full vector throws.
+template <typename T, std::size_t Capacity>
+class InlineVector {
+    static_assert(Capacity <= UINT16_MAX, "InlineVector size is stored in 16 bits");
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    InlineVector() = default;
+    InlineVector(std::initializer_list<T> values) {
+        for (const auto& value : values) push_back(value);
+    }
+
+    static constexpr std::size_t capacity() { return Capacity; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == Capacity; }
+
+    T& operator[](std::size_t index) { return items_[index]; }
+    const T& operator[](std::size_t index) const { return items_[index]; }
+    T& back() { return items_[size_ - 1]; }
+    const T& back() const { return items_[size_ - 1]; }
+
+    iterator begin() { return items_.data(); }
+    iterator end() { return items_.data() + size_; }
+    const_iterator begin() const { return items_.data(); }
+    const_iterator end() const { return items_.data() + size_; }
+
+    void push_back(const T& value) {
+        if (full()) throw std::length_error("InlineVector capacity exceeded");
+        items_[size_++] = value;
+    }
+
+    void pop_back() { --size_; }
+    void clear() { size_ = 0; }
+
+    // Keeps the order of the remaining elements
+    iterator erase(const_iterator position) {
+        auto* target = const_cast<T*>(position);
+        for (auto* it = target; it + 1 != end(); ++it) *it = *(it + 1);
+        --size_;
+        return target;
+    }
+
+private:
+    std::array<T, Capacity> items_{};
+    std::uint16_t size_ = 0;
+};
+
+} // namespace cardbattle
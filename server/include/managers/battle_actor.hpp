@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../types.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <userver/engine/future.hpp>
+
+namespace cardbattle {
+
+// Owns one battle's state and runs every command for it one at a time, in
+// arrival order. Commands are posted to a lock-free mailbox; the coroutine
+// that posts into an idle mailbox becomes its processor and keeps draining
+// until the mailbox is empty, so exactly one coroutine touches the state at
+// any moment and no lock is shared between battles.
+//
+// Commands must not post back into the same actor (they would wait on
+// themselves).
+class BattleActor {
+public:
+    using Command = std::function<void(BattleState&)>;
+    // Turns a state into what is sent to clients
+    using Serializer = std::function<std::string(const BattleState&)>;
+    // Same for the change from one state to a later one
+    using DeltaSerializer = std::function<std::string(const BattleState& before, const BattleState& after)>;
+
+    explicit BattleActor(BattleState state);
+
+    BattleActor(const BattleActor&) = delete;
+    BattleActor& operator=(const BattleActor&) = delete;
+
+    // Runs the command against the battle state and waits for it to finish.
+    // Whatever the command throws is rethrown to the caller.
+    void Execute(const Command& command);
+
+    // Immutable copy of the current state, shared by every reader until the
+    // state's version changes. At most one copy is made per version, and
+    // none when nobody reads between changes.
+    std::shared_ptr<const BattleState> Snapshot();
+
+    // Serialized forms are kept per format (JSON, binary, ...), an index
+    // below kMaxFormats picked by the caller. Every caller passes the same
+    // serializer for a format.
+    static constexpr std::size_t kMaxFormats = 2;
+
+    // The current state as serialized by `serialize`, shared the same way:
+    // it runs at most once per version, and the result goes to every reader
+    // of that version without copies.
+    std::shared_ptr<const std::string> Payload(std::size_t format, const Serializer& serialize);
+    // Same, for a command of this actor while it runs (it cannot Execute)
+    std::shared_ptr<const std::string> PayloadInCommand(std::size_t format, const Serializer& serialize);
+    // The change from the previous version to the current one, serialized
+    // by `serialize` once per version; for commands, like PayloadInCommand.
+    // Only the last version a delta was asked for is remembered, so this is
+    // null when the previous version was skipped.
+    std::shared_ptr<const std::string> DeltaInCommand(std::size_t format, const DeltaSerializer& serialize);
+
+private:
+    struct Envelope {
+        const Command* command;
+        userver::engine::Promise<void> promise;
+        Envelope* next = nullptr;
+    };
+
+    void Post(Envelope* envelope);
+    void Drain();
+    Envelope* TakeInbox();
+    std::shared_ptr<const BattleState> SnapshotInCommand();
+
+    // Producers push here (LIFO); the processor reverses it into local_
+    std::atomic<Envelope*> inbox_{nullptr};
+    // Number of posted but not yet finished commands. The poster that moves
+    // it from 0 to 1 becomes the processor.
+    std::atomic<std::size_t> pending_{0};
+    // Owned by the current processor; handed over through pending_
+    Envelope* local_ = nullptr;
+    BattleState state_;
+    std::shared_ptr<const BattleState> snapshot_;  // Touched by commands only
+    struct FormatCache {
+        std::shared_ptr<const std::string> payload;
+        std::uint64_t payload_version = 0;
+        std::shared_ptr<const std::string> delta;  // From delta_from_ to delta_to_
+    };
+    std::array<FormatCache, kMaxFormats> formats_;  // Same
+    // Versions the deltas run between, shared by all formats; delta_from_
+    // is null if the version before delta_to_ was skipped
+    std::shared_ptr<const BattleState> delta_from_;  // Same
+    std::shared_ptr<const BattleState> delta_to_;  // Same
+};
+
+} // namespace cardbattle
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <userver/components/component_base.hpp>
+#include <userver/components/component_config.hpp>
+#include <userver/components/component_context.hpp>
+#include <userver/utils/statistics/entry.hpp>
+#include <userver/utils/statistics/writer.hpp>
+#include <userver/yaml_config/schema.hpp>
+#include <memory>
+#include <string_view>
+
+namespace cardbattle {
+
+// Plays the bot seats of battles (see GameSessionManager::AddBot). Whenever
+// a battle reaches a state where a bot is to act, a move task searches it
+// with MCTS (battle_mcts.hpp) for the configured time budget: one tree per
+// `search-trees` on a dedicated task processor, so searches use their own
+// cores and never hold up the main task processor. The trees' votes decide
+// the move, which is then made like a player's, unless the battle moved on
+// in the meantime (the turn timed out, the host surrendered).
+//
+// A bot battle restored after a restart waits for its turn clock if it
+// stopped on the bot's turn, and so does one whose move failed. That clock
+// is what keeps bot battles going, so battle-maintenance must have a
+// non-zero turn-timeout.
+//
+// Exports cardbattle-bot.* (moves made, stale moves, search iterations).
+class BattleBotComponent final : public userver::components::ComponentBase {
+public:
+    static constexpr std::string_view kName = "battle-bot";
+
+    BattleBotComponent(const userver::components::ComponentConfig& config,
+                       const userver::components::ComponentContext& context);
+    ~BattleBotComponent() override;
+
+    static userver::yaml_config::Schema GetStaticConfigSchema();
+
+private:
+    class Bot;  // Shared with BattleManager's state listener, which outlives us
+
+    void WriteStatistics(userver::utils::statistics::Writer& writer) const;
+
+    std::shared_ptr<Bot> bot_;
+    userver::utils::statistics::Entry statistics_holder_;
+};
+
+} // namespace cardbattle
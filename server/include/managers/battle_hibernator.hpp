@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+#include <userver/engine/task/task_processor_fwd.hpp>
+
+namespace cardbattle {
+
+// Local disk store for battles hibernated out of memory: one file per
+// battle, <directory>/<session_id>.battle, holding its EncodeBattleState
+// bytes. A file is written to a temporary name, fsynced and renamed into
+// place, so it is always a whole state. The blocking file work runs on the
+// given task processor; callers may be on any.
+class BattleHibernator {
+public:
+    BattleHibernator(std::string directory, userver::engine::TaskProcessor& fs_task_processor);
+
+    BattleHibernator(const BattleHibernator&) = delete;
+    BattleHibernator& operator=(const BattleHibernator&) = delete;
+
+    void Store(const std::string& session_id, const std::string& data);
+    // Nothing if there is no file for the session
+    std::optional<std::string> Load(const std::string& session_id);
+    void Remove(const std::string& session_id);
+
+    // Sessions with a stored battle
+    std::vector<std::string> List();
+    // Sessions whose battle was stored longer than max_age ago
+    std::vector<std::string> ListOlderThan(std::chrono::seconds max_age);
+
+private:
+    std::string PathFor(const std::string& session_id) const;
+    std::vector<std::string> ListFiles(std::optional<std::chrono::seconds> max_age);
+
+    const std::string directory_;
+    userver::engine::TaskProcessor& fs_task_processor_;
+};
+
+} // namespace cardbattle
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../battle_replay.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <userver/engine/mutex.hpp>
+
+namespace cardbattle {
+
+// Append-only log of accepted battle actions, split into fixed-size
+// memory-mapped segment files (journal-NNNNNN.log). Appending is a memcpy
+// into the mapping under a short lock; Flush() msyncs everything appended
+// since the last flush in one go, so durability is paid per flush interval
+// rather than per action. A crash loses at most the unflushed tail. Flush()
+// also opens the next segment ahead of time, so a rollover in Append()
+// normally just switches to it.
+//
+// Each record is checksummed, so a torn write at the tail of a segment is
+// detected and reading stops there.
+//
+// Segments are never compacted in place. Instead Retire() deletes the
+// oldest ones once recovery no longer needs any of their records, which
+// the journal tracks per segment as a JournalSegmentSummary.
+class BattleJournal {
+public:
+    // `earlier_segments` are the summaries of the segments already in the
+    // directory, oldest first, as RecoverBattles built them. Unless they
+    // account for every one of them, nothing is ever retired.
+    BattleJournal(std::string directory, std::size_t segment_size,
+                  std::vector<std::shared_ptr<const JournalSegmentSummary>> earlier_segments = {});
+    ~BattleJournal();
+
+    BattleJournal(const BattleJournal&) = delete;
+    BattleJournal& operator=(const BattleJournal&) = delete;
+
+    void Append(const JournalRecord& record);
+    void Flush();
+    // Deletes the oldest segments that are rolled over and flushed and
+    // whose battles all pass `covered` (see RetirableSegments). Before
+    // that, `on_retire` sees each of them and may append records that take
+    // over from theirs; those are flushed first. Both run without journal
+    // locks held. Returns how many segments were deleted.
+    std::size_t Retire(
+        const std::function<bool(const std::string& session_id, const JournalSegmentSummary::Battle& battle)>& covered,
+        const std::function<void(const JournalSegmentSummary& segment)>& on_retire);
+
+    const std::string& Directory() const { return directory_; }
+    std::uint64_t AppendedRecords() const { return appended_records_.load(std::memory_order_relaxed); }
+    std::uint64_t RetiredSegments() const { return retired_segments_.load(std::memory_order_relaxed); }
+
+    // Segment files in the directory, oldest first
+    static std::vector<std::string> ListSegments(const std::string& directory);
+    // Calls on_record for every intact record of a segment, in append order.
+    // Returns false if the segment ended in a torn or corrupt record.
+    static bool ReadSegment(const std::string& path, const std::function<void(const JournalRecord&)>& on_record);
+
+private:
+    struct Segment;
+
+    std::shared_ptr<Segment> OpenSegment(std::uint64_t index);
+    // Opens the next segment into spare_ unless there is one. No lock is
+    // held while the file is created and mapped.
+    void PrepareSegment();
+
+    const std::string directory_;
+    const std::size_t segment_size_;
+    userver::engine::Mutex mutex_;  // Guards the segment lists and write offsets
+    std::vector<std::shared_ptr<Segment>> segments_;  // Unflushed ones; back() is written to
+    std::shared_ptr<Segment> spare_;  // Opened ahead, next after back()
+    // Rolled over, flushed and unmapped, oldest first: what Retire() may delete
+    std::vector<std::shared_ptr<const JournalSegmentSummary>> sealed_;
+    bool retirable_ = true;  // Every segment on disk is accounted for
+    std::uint64_t next_segment_index_ = 1;
+    userver::engine::Mutex flush_mutex_;   // One Flush() at a time
+    userver::engine::Mutex retire_mutex_;  // One Retire() at a time
+    std::atomic<std::uint64_t> appended_records_{0};
+    std::atomic<std::uint64_t> retired_segments_{0};
+};
+
+} // namespace cardbattle
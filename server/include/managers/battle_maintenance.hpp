@@ -0,0 +1,70 @@
+#pragma once
+
+#include <userver/components/component_base.hpp>
+#include <userver/components/component_config.hpp>
+#include <userver/components/component_context.hpp>
+#include <userver/engine/task/task_processor_fwd.hpp>
+#include <userver/utils/periodic_task.hpp>
+#include <userver/utils/statistics/entry.hpp>
+#include <userver/utils/statistics/writer.hpp>
+#include <userver/yaml_config/schema.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "battle_manager.hpp"
+
+namespace cardbattle {
+
+// Background upkeep for the in-memory battles, run as periodic tasks on the
+// fs task processor:
+//  - watches the compiled card catalog and publishes a new version to
+//    BattleManager whenever the file is replaced;
+//  - restores the previous run's battles at startup from their database
+//    snapshots plus the journal, then opens a new journal segment and
+//    group-flushes it;
+//  - deletes journal segments once ended battles and persisted snapshots
+//    cover all their records;
+//  - writes snapshots of changed battles to the database in batches;
+//  - evicts finished and abandoned battles from memory, or hibernates idle
+//    ones to disk when a hibernation directory is configured;
+//  - ends turns whose player ran out of time.
+// Exports cardbattle.battles.* (resident battles, evictions, turn timers),
+// cardbattle.recovery.* so recovery time can be tracked as the number of
+// live battles grows, cardbattle.journal.* for appended records and
+// retired segments, and cardbattle.snapshots.* for the write-behind
+// backlog.
+class BattleMaintenanceComponent final : public userver::components::ComponentBase {
+public:
+    static constexpr std::string_view kName = "battle-maintenance";
+
+    BattleMaintenanceComponent(const userver::components::ComponentConfig& config,
+                               const userver::components::ComponentContext& context);
+    ~BattleMaintenanceComponent() override;
+
+    static userver::yaml_config::Schema GetStaticConfigSchema();
+
+private:
+    void ReloadCardCatalog();
+    // Decodable battle snapshots left in the database by the last run
+    std::vector<BattleState> LoadSnapshots(const std::string& database_path);
+    void FlushJournal();
+    void FlushSnapshots();
+    void RetireJournalSegments();
+    void WriteStatistics(userver::utils::statistics::Writer& writer) const;
+
+    BattleManager& battle_manager_;
+    userver::engine::TaskProcessor& fs_task_processor_;
+    std::shared_ptr<BattleJournal> journal_;
+    std::shared_ptr<BattleSnapshotWriter> snapshot_writer_;
+    userver::utils::PeriodicTask catalog_reload_task_;
+    userver::utils::PeriodicTask journal_flush_task_;
+    userver::utils::PeriodicTask snapshot_flush_task_;
+    userver::utils::PeriodicTask eviction_task_;
+    userver::utils::PeriodicTask turn_timer_task_;
+    userver::utils::PeriodicTask hibernation_expiry_task_;
+    BattleManager::RecoveryStats recovery_stats_;  // Written once in the constructor
+    userver::utils::statistics::Entry statistics_holder_;
+};
+
+} // namespace cardbattle
@@ -1,43 +1,279 @@
 #pragma once
 
 #include "../types.hpp"
+#include "../card_catalog.hpp"
+#include "../timer_wheel.hpp"
 #include "session_manager.hpp"
+#include "battle_actor.hpp"
+#include "battle_hibernator.hpp"
+#include "battle_journal.hpp"
+#include "battle_snapshot_writer.hpp"
 #include <unordered_map>
+#include <unordered_set>
 #include <random>
 #include "../../src/sqlite_db.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
+#include <userver/engine/mutex.hpp>
+#include <userver/rcu/rcu.hpp>
 
 namespace cardbattle {
 
 class BattleManager {
 private:
-    std::unordered_map<std::string, BattleState> active_battles_;
-    std::vector<Card> default_cards_;
+    // Active battles are split into shards by session id. A shard lock only
+    // guards its map lookup; game actions run inside the battle's actor, so
+    // actions on different battles never wait for each other.
+    static constexpr std::size_t kShardCount = 64;
+
+    // A battle held in memory, with what eviction needs to know about it
+    struct ResidentBattle {
+        explicit ResidentBattle(BattleState state) : actor(std::move(state)) {}
+
+        BattleActor actor;
+        // Steady clock, in ms. Updated on every lookup under the shard lock.
+        std::atomic<std::int64_t> last_access_ms{0};
+        std::atomic<std::int64_t> finished_at_ms{0};  // 0 while the game runs
+        // When the current turn times out; 0 once finished or with no turn clock
+        std::atomic<std::int64_t> turn_deadline_ms{0};
+    };
+
+    struct Shard {
+        userver::engine::Mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<ResidentBattle>> battles;
+        // On disk, see BattleHibernator, with the catalog each one runs on;
+        // null for battles left by an earlier run, which take the current one
+        std::unordered_map<std::string, std::shared_ptr<const CardCatalog>> hibernated;
+    };
+
+    std::array<Shard, kShardCount> shards_;
+    // Catalog for new battles. Readers never lock; a reload publishes a new
+    // pointer and running battles keep the one pinned in their state.
+    userver::rcu::Variable<std::shared_ptr<const CardCatalog>> card_catalog_;
+    std::string card_catalog_path_;  // Touched only by the reload task
+    std::string card_catalog_stamp_;
+    std::atomic<std::uint64_t> next_seed_;  // Mixed into per-battle seeds
+    std::shared_ptr<BattleJournal> journal_;  // Optional, set before serving traffic
+    std::shared_ptr<BattleSnapshotWriter> snapshot_writer_;  // Same
+    std::shared_ptr<BattleHibernator> hibernator_;  // Same
+    // One eviction timer per resident battle, see RunEvictions
+    userver::engine::Mutex eviction_mutex_;
+    TimerWheel eviction_wheel_;
+    std::atomic<std::int64_t> finished_grace_ms_;
+    std::atomic<std::int64_t> idle_timeout_ms_;
+    std::atomic<std::int64_t> hibernate_after_ms_;
+    // Turn clocks of all resident battles, see RunTurnTimers. Separate from
+    // the eviction wheel: finer ticks, and it fires on every turn.
+    userver::engine::Mutex turn_timer_mutex_;
+    TimerWheel turn_wheel_;
+    std::atomic<std::int64_t> turn_timeout_ms_;
+    std::atomic<std::size_t> resident_battles_{0};
+    std::atomic<std::uint64_t> evicted_finished_{0};
+    std::atomic<std::uint64_t> evicted_idle_{0};
+    std::atomic<std::size_t> hibernated_battles_{0};
+    std::atomic<std::uint64_t> hibernations_{0};
+    std::atomic<std::uint64_t> rehydrations_{0};
+    std::atomic<std::uint64_t> turn_timeouts_{0};
 
 public:
+    // One way of serializing states for clients (JSON, binary, ...)
+    struct StateFormat {
+        BattleActor::Serializer full;
+        BattleActor::DeltaSerializer delta;  // Optional
+    };
+
+    // What listeners see of an accepted action. Serialized forms are made
+    // on first use, once per version, and kept for later readers.
+    class StateUpdate {
+    public:
+        StateUpdate(const BattleState& state, BattleActor& actor, const BattleManager& battle_manager)
+            : state_(state), actor_(actor), battle_manager_(battle_manager) {}
+
+        const BattleState& State() const { return state_; }
+        // See GetBattlePayload
+        std::shared_ptr<const std::string> Payload(std::size_t format) const;
+        // The change from the previous version; null if the format has no
+        // delta serializer or that version is unknown
+        std::shared_ptr<const std::string> Delta(std::size_t format) const;
+
+    private:
+        const BattleState& state_;
+        BattleActor& actor_;
+        const BattleManager& battle_manager_;
+    };
+
+    // Called inside the battle's actor after every accepted action, so it
+    // sees states in the order they were produced. Must not call back into
+    // the same battle (hand such work off to another task).
+    using StateListener = std::function<void(const StateUpdate&)>;
+    // Whether anyone is connected to the session; battles with a connected
+    // player are never evicted as idle
+    using PresenceProbe = std::function<bool(const std::string& session_id)>;
+
+    struct EvictionSettings {
+        // Finished battles stay this long so players can see the result
+        std::chrono::milliseconds finished_grace{std::chrono::minutes{1}};
+        // Running battles nobody is connected to or acting in
+        std::chrono::milliseconds idle_timeout{std::chrono::minutes{10}};
+        // With a hibernator, running battles nobody acted in or looked at
+        // for this long go to disk instead, connected players or not
+        std::chrono::milliseconds hibernate_after{std::chrono::minutes{2}};
+    };
+
     BattleManager();
+    // Listeners run in the order they were added
+    void AddStateListener(StateListener listener);
+    // Registers a format for GetBattlePayload and listeners and returns
+    // its index. At most BattleActor::kMaxFormats.
+    std::size_t AddStateFormat(StateFormat format);
+    // Every accepted action is appended to the journal from then on
+    void SetJournal(std::shared_ptr<BattleJournal> journal);
+    // Battles are marked dirty in the writer whenever they change
+    void SetSnapshotWriter(std::shared_ptr<BattleSnapshotWriter> snapshot_writer);
+    // Idle battles are hibernated to it and read back when touched.
+    // Battles it already holds (from the last run) become hibernated ones.
+    void SetHibernator(std::shared_ptr<BattleHibernator> hibernator);
+    void SetPresenceProbe(PresenceProbe probe);
+    void SetEvictionSettings(const EvictionSettings& settings);
+    // How long a player may take over a turn before it is ended for them;
+    // zero turns the clock off. Applies from the next turn on.
+    void SetTurnTimeout(std::chrono::milliseconds timeout);
+    std::chrono::milliseconds TurnTimeout() const {
+        return std::chrono::milliseconds{turn_timeout_ms_.load(std::memory_order_relaxed)};
+    }
     std::string StartBattle(const std::string& session_id);
-    void PlayCard(const std::string& session_id, const std::string& player_id, int hand_index);
-    void Attack(const std::string& session_id, const std::string& attacker_id, int attacker_index, int target_index);
-    void EndTurn(const std::string& session_id, const std::string& player_id);
-    void Surrender(const std::string& session_id, const std::string& player_id);
-    void EndGame(BattleState& battle_state, const std::string& winner_id);
-    BattleState GetBattleState(const std::string& session_id);
+    // Same, with a given seed instead of a fresh one (replays, simulations)
+    std::string StartBattle(const std::string& session_id, std::uint64_t seed);
+    // Seats are resolved once per connection, see SeatInSession
+    void PlayCard(const std::string& session_id, int seat, int hand_index);
+    void Attack(const std::string& session_id, int attacker_seat, int attacker_index, int target_index);
+    void EndTurn(const std::string& session_id, int seat);
+    void Surrender(const std::string& session_id, int seat);
+    static int SeatInSession(const GameSession& session, const std::string& user_id);
+    // Shared read-only snapshot; copied at most once per state version.
+    // Rehydrates a hibernated battle.
+    std::shared_ptr<const BattleState> GetBattleState(const std::string& session_id);
+    // Same for resident battles only, without counting as activity; null
+    // if the battle is not in memory
+    std::shared_ptr<const BattleState> PeekBattleState(const std::string& session_id);
+    // Current state in a format from AddStateFormat, made at most once per
+    // state version and shared with every broadcast and reader of that
+    // version. Rehydrates a hibernated battle.
+    std::shared_ptr<const std::string> GetBattlePayload(const std::string& session_id, std::size_t format);
+    // Resident or hibernated
+    bool HasBattle(const std::string& session_id);
+    bool IsHibernated(const std::string& session_id);
+    // Catalog new battles start with; a running battle uses BattleState::catalog
+    std::shared_ptr<const CardCatalog> GetCardCatalog() const;
+
+    // Compiled catalog file (see CardCatalogCompiler) to serve cards from
+    void SetCardCatalogPath(const std::string& path);
+    // Maps the catalog file if it changed since the last load and publishes
+    // it for new battles. Returns false if the file is missing or unchanged.
+    // Throws if the file is malformed; the current catalog stays in use.
+    bool ReloadCardCatalog();
     void EndBattle(const std::string& session_id);
+    // Fires the eviction timers that are due: finished battles past their
+    // grace period are archived and dropped, battles idle past the timeout
+    // with nobody connected are dropped. A battle whose timer fires early
+    // (it was touched since) gets a new one. Call once per wheel tick.
+    // Returns the number of battles evicted.
+    std::size_t RunEvictions();
+    std::size_t ResidentBattles() const { return resident_battles_.load(std::memory_order_relaxed); }
+    std::uint64_t EvictedFinished() const { return evicted_finished_.load(std::memory_order_relaxed); }
+    std::uint64_t EvictedIdle() const { return evicted_idle_.load(std::memory_order_relaxed); }
+    // Ends hibernated battles stored longer than max_age ago. Returns how many.
+    std::size_t ExpireHibernated(std::chrono::seconds max_age);
+    std::size_t HibernatedBattles() const { return hibernated_battles_.load(std::memory_order_relaxed); }
+    std::uint64_t Hibernations() const { return hibernations_.load(std::memory_order_relaxed); }
+    std::uint64_t Rehydrations() const { return rehydrations_.load(std::memory_order_relaxed); }
+    // Ends the turns whose clock ran out, as if their player had called
+    // EndTurn. Timing out is not activity: an abandoned battle still goes
+    // idle. Hibernated battles have no clock; it restarts when they are
+    // read back. Call once per turn wheel tick (kTurnTimerTick). Returns
+    // the number of turns ended.
+    std::size_t RunTurnTimers();
+    std::uint64_t TurnTimeouts() const { return turn_timeouts_.load(std::memory_order_relaxed); }
+    std::size_t PendingTurnTimers();
+    static constexpr std::chrono::milliseconds kTurnTimerTick{100};
+    static constexpr std::chrono::seconds kDefaultTurnTimeout{90};
     std::string GenerateId();
-    void SaveBattleState(const std::string& session_id, const BattleState& state);
+    struct RecoveryStats {
+        std::size_t segments = 0;
+        std::size_t records = 0;
+        std::size_t battles = 0;  // Restored as live battles
+        std::size_t failed = 0;   // Dropped because they could not be rebuilt
+        std::chrono::milliseconds duration{0};
+    };
+    // Rebuilds the battles that were live when the process stopped. Each
+    // starts from its entry in `snapshots` if there is one, else from its
+    // journaled start, then replays the journaled actions newer than that.
+    // Reading segments and replaying battles are spread over `threads` OS
+    // threads. Also restores the sessions of recovered battles. Call at
+    // startup, before a journal is attached and before serving traffic.
+    // `segment_summaries`, if given, receives what each segment read holds,
+    // for the new BattleJournal to retire them.
+    RecoveryStats RecoverBattles(const std::string& journal_dir, std::vector<BattleState> snapshots, unsigned threads,
+                                 std::vector<std::shared_ptr<const JournalSegmentSummary>>* segment_summaries = nullptr);
+    // Deletes the oldest journal segments recovery no longer needs: every
+    // battle in them has ended, or has a persisted snapshot at least as new
+    // as its records there. A hibernated battle is journaled as hibernated
+    // again, so retiring its old records does not wake it at recovery.
+    // Blocking file work; call after recovery and after snapshot flushes.
+    // Returns how many segments were deleted.
+    std::size_t RetireJournalSegments();
+    // Mutates the stored state in place inside the battle's actor
+    void UpdateBattleState(const std::string& session_id, const BattleActor::Command& update);
 
 private:
-    void InitializeDefaultCards();
-    void InitializePlayerDeck(BattleState& battle, const std::string& player_id);
-    void DrawCards(BattleState& battle, const std::string& player_id, int count);
-    void HandleSpellEffect(BattleState& battle_state, const std::string& player_id, const Card& spell);
+    Shard& GetShard(const std::string& session_id);
+    // Also counts as an access for idle eviction; rehydrates a hibernated battle
+    std::shared_ptr<ResidentBattle> FindBattle(const std::string& session_id);
+    std::shared_ptr<ResidentBattle> Rehydrate(const std::string& session_id);
+    // Stores the battle and drops it from memory unless it was touched
+    // after `last_access_ms` or changed since it was stored. Returns whether
+    // it was hibernated.
+    bool Hibernate(const std::string& session_id, const std::shared_ptr<ResidentBattle>& battle,
+                   std::int64_t last_access_ms);
+    void ScheduleEviction(const std::string& session_id, std::int64_t deadline_ms);
+    // (Re)starts the clock for the battle's current turn, unless it is
+    // finished or turn clocks are off. Call as the battle is published.
+    void StartTurnClock(const std::string& session_id, ResidentBattle& battle);
+    void ScheduleTurnTimer(const std::string& session_id, std::int64_t deadline_ms);
+    // Returns whether the turn was ended
+    bool ExpireTurn(const std::string& session_id, std::int64_t now_ms);
+    // Returns whether the battle was evicted
+    bool TryEvict(const std::string& session_id, std::int64_t now_ms);
+    // Drops the battle from memory or disk; `archive` keeps its final state stored
+    bool RemoveBattle(const std::string& session_id, bool archive);
+    // Ends a hibernated battle and deletes its file. Returns false if it is
+    // no longer hibernated.
+    bool EndHibernated(const std::string& session_id);
+    // First eviction check for a running battle: hibernation or idle drop
+    std::int64_t IdleDelayMs() const;
+    static std::int64_t NowMs();
+    // Runs an action in the battle's actor; if it is accepted, journals
+    // `record` (when given) stamped with the new state version
+    void RunAction(const std::string& session_id, const BattleActor::Command& action,
+                   JournalRecord* record = nullptr);
+    // Same, for a battle already looked up
+    void ExecuteAction(const std::string& session_id, const std::shared_ptr<ResidentBattle>& battle,
+                       const BattleActor::Command& action, JournalRecord* record);
+    void AppendToJournal(const JournalRecord& record);
+    // Whether recovery can do without a retiring segment's records of the battle
+    bool JournalCovers(const std::string& session_id, const JournalSegmentSummary::Battle& battle);
+    std::uint64_t NewBattleSeed();
     std::vector<Card> LoadDeckCards(const std::vector<std::string>& card_ids);
-    std::vector<Card> DrawInitialHand(std::vector<Card>& deck);
-    std::string BattleStateToJson(const BattleState& state);
-    BattleState BattleStateFromJson(const std::string& json_str);
     void UpdatePlayerStats(const std::string& player_id, bool won);
+
+    std::vector<StateListener> state_listeners_;  // Added before serving traffic
+    PresenceProbe presence_probe_;  // Same
+    std::vector<StateFormat> state_formats_;  // Same
 };
 
 } // namespace cardbattle 
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <userver/engine/mutex.hpp>
+
+class SQLiteDB;
+
+namespace cardbattle {
+
+class BattleManager;
+struct BattleState;
+
+// Write-behind persistence of battle snapshots to the SQLite battles table.
+// Actions only mark their battle dirty (a set insert under a short lock, so
+// repeated changes to one battle coalesce); Flush(), run periodically on the
+// fs task processor, snapshots every dirty battle and upserts the batch in
+// one transaction. Battles that are gone from memory are deleted, so the
+// table mirrors the live battles as of the last flush, except archived
+// ones: their final state is kept and their session marked finished.
+class BattleSnapshotWriter {
+public:
+    // `persisted` maps the battles already in the table (the snapshots
+    // recovery loaded) to their versions
+    BattleSnapshotWriter(BattleManager& battle_manager, std::unique_ptr<SQLiteDB> db,
+                         std::unordered_map<std::string, std::uint64_t> persisted = {});
+    ~BattleSnapshotWriter();
+
+    void MarkDirty(const std::string& session_id);
+    // Final state of a battle evicted after it finished; written once and
+    // never deleted
+    void Archive(std::shared_ptr<const BattleState> state);
+    // Blocking database work; keep it off the main task processor
+    void Flush();
+    // Version of the battle's row as of the last successful flush; nothing
+    // if it has none, or only an archived one recovery does not load
+    std::optional<std::uint64_t> PersistedVersion(const std::string& session_id);
+
+    std::size_t DirtyCount() const { return dirty_count_.load(std::memory_order_relaxed); }
+    std::uint64_t WrittenCount() const { return written_count_.load(std::memory_order_relaxed); }
+    std::uint64_t ArchivedCount() const { return archived_count_.load(std::memory_order_relaxed); }
+    std::uint64_t FailedFlushes() const { return failed_flushes_.load(std::memory_order_relaxed); }
+
+private:
+    BattleManager& battle_manager_;
+    std::unique_ptr<SQLiteDB> db_;  // Own connection, used by Flush only
+
+    userver::engine::Mutex mutex_;
+    std::unordered_set<std::string> dirty_;
+    std::unordered_map<std::string, std::shared_ptr<const BattleState>> archived_;
+    std::unordered_map<std::string, std::uint64_t> persisted_;
+    std::atomic<std::size_t> dirty_count_{0};
+    std::atomic<std::uint64_t> written_count_{0};
+    std::atomic<std::uint64_t> archived_count_{0};
+    std::atomic<std::uint64_t> failed_flushes_{0};
+};
+
+} // namespace cardbattle
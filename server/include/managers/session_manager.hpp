@@ -3,21 +3,34 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include "../types.hpp"
 
 namespace cardbattle {
 
+// Player ids of bot seats (see BattleBotComponent). User ids are UUIDs, so
+// they never start with it; the handlers refuse players claiming such an id.
+inline constexpr std::string_view kBotPlayerIdPrefix = "bot-";
+
+inline bool IsBotPlayer(std::string_view player_id) {
+    return player_id.starts_with(kBotPlayerIdPrefix);
+}
+
 // GameSession struct is defined in types.hpp
 
 class GameSessionManager {
 public:
     std::string CreateSession(const std::string& player1_id);
     void JoinSession(const std::string& session_id, const std::string& player2_id);
+    // Seats a bot as the guest; only the host may. Returns the bot's player id.
+    std::string AddBot(const std::string& session_id, const std::string& host_id);
     std::vector<GameSession> GetWaitingSessions();
     GameSession GetSession(const std::string& session_id);
     void EndSession(const std::string& session_id);
     void RemovePlayerFromSession(const std::string& session_id, const std::string& player_id);
     void ClearOldSessions();
+    // Puts back a session known from elsewhere (battle recovery)
+    void RestoreSession(const GameSession& session);
 private:
     std::string GenerateId();
     std::unordered_map<std::string, GameSession> sessions_;
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cardbattle {
+
+// Hierarchical timing wheel of string-keyed one-shot timers. Time is cut
+// into ticks. Level 0 has one slot per tick; each slot of level k spans
+// slot_count^k ticks. A timer goes to the lowest level whose span reaches
+// its deadline and moves down a level each time the wheel enters its slot,
+// so it is touched at most once per level before it fires. Scheduling is
+// O(1), and Advance() costs O(1) per tick plus the timers it fires or moves
+// down; nothing scans all timers. Deadlines beyond the top level wait there
+// for their round.
+//
+// There is no cancellation: owners re-check the condition when a timer
+// fires and drop or reschedule it. Not synchronized; the owner guards it.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel(Clock::duration tick, std::size_t slot_count, std::size_t level_count,
+               Clock::time_point start = Clock::now())
+        : tick_(tick), start_(start), slot_count_(slot_count), levels_(level_count) {
+        std::uint64_t span = 1;
+        for (auto& level : levels_) {
+            level.span = span;
+            level.slots.resize(slot_count);
+            span *= slot_count;
+        }
+    }
+
+    // Deadlines are rounded up to the next tick; past ones fire on the
+    // next Advance
+    void Schedule(Clock::time_point deadline, std::string key) {
+        std::uint64_t tick = TickAt(deadline, true);
+        if (tick <= current_tick_) tick = current_tick_ + 1;
+        Insert({tick, std::move(key)});
+        ++size_;
+    }
+
+    // Removes the timers that are due by `now` and returns their keys
+    std::vector<std::string> Advance(Clock::time_point now) {
+        std::vector<std::string> expired;
+        const std::uint64_t target = TickAt(now, false);
+        if (target <= current_tick_) return expired;
+        if (target - current_tick_ > slot_count_) {
+            // After a long stall, rebuilding is cheaper than walking every tick
+            Rebuild(target, expired);
+            return expired;
+        }
+        while (current_tick_ < target) {
+            ++current_tick_;
+            // Entering a slot of an upper level moves its timers down
+            for (std::size_t k = 1; k < levels_.size() && current_tick_ % levels_[k].span == 0; ++k) {
+                auto& slot = levels_[k].slots[(current_tick_ / levels_[k].span) % slot_count_];
+                std::vector<Timer> timers;
+                timers.swap(slot);
+                for (auto& timer : timers) Insert(std::move(timer));
+            }
+            // Only a single-level wheel keeps later rounds in level 0
+            auto& slot = levels_[0].slots[current_tick_ % slot_count_];
+            for (std::size_t i = 0; i < slot.size();) {
+                if (slot[i].tick <= current_tick_) {
+                    expired.push_back(std::move(slot[i].key));
+                    slot[i] = std::move(slot.back());
+                    slot.pop_back();
+                    --size_;
+                } else {
+                    ++i;
+                }
+            }
+        }
+        return expired;
+    }
+
+    std::size_t Size() const { return size_; }
+
+private:
+    struct Timer {
+        std::uint64_t tick;
+        std::string key;
+    };
+
+    struct Level {
+        std::uint64_t span = 1;  // Ticks per slot
+        std::vector<std::vector<Timer>> slots;
+    };
+
+    // A timer due at the current tick (moved down from the slot just
+    // entered) lands in the level 0 slot about to fire
+    void Insert(Timer timer) {
+        for (std::size_t k = 0; k < levels_.size(); ++k) {
+            const std::uint64_t span = levels_[k].span;
+            // Within this level's reach, and not in the slot already entered
+            if (timer.tick / span - current_tick_ / span < slot_count_ || k + 1 == levels_.size()) {
+                levels_[k].slots[(timer.tick / span) % slot_count_].push_back(std::move(timer));
+                return;
+            }
+        }
+    }
+
+    void Rebuild(std::uint64_t target, std::vector<std::string>& expired) {
+        std::vector<Timer> pending;
+        for (auto& level : levels_) {
+            for (auto& slot : level.slots) {
+                for (auto& timer : slot) {
+                    if (timer.tick <= target) {
+                        expired.push_back(std::move(timer.key));
+                    } else {
+                        pending.push_back(std::move(timer));
+                    }
+                }
+                slot.clear();
+            }
+        }
+        current_tick_ = target;
+        size_ = pending.size();
+        for (auto& timer : pending) Insert(std::move(timer));
+    }
+
+    std::uint64_t TickAt(Clock::time_point time, bool round_up) const {
+        if (time <= start_) return 0;
+        const auto elapsed = time - start_;
+        auto ticks = static_cast<std::uint64_t>(elapsed / tick_);
+        if (round_up && elapsed % tick_ != Clock::duration::zero()) ++ticks;
+        return ticks;
+    }
+
+    const Clock::duration tick_;
+    const Clock::time_point start_;
+    const std::size_t slot_count_;
+    std::vector<Level> levels_;
+    std::uint64_t current_tick_ = 0;
+    std::size_t size_ = 0;
+};
+
+} // namespace cardbattle
@@ -1,15 +1,21 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <chrono>
-#include <userver/formats/json/value.hpp>
-#include <userver/formats/json/value_builder.hpp>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include "battle_rng.hpp"
+#include "inline_vector.hpp"
 
 namespace cardbattle {
 
+class CardCatalog;
+
 // Card types
 enum class CardType {
     CREATURE,
@@ -28,23 +34,62 @@ struct User {
     User() = default;
 };
 
-struct Card {
-    std::string id;
-    std::string name;
-    std::string description;
+// What a card does when played, run by ApplyEffect in battle_rules.cpp
+enum class EffectOp : std::uint8_t {
+    DAMAGE,        // Deal `amount` damage
+    HEAL,          // Restore `amount` health/defense, capped at the maximum
+    BUFF_ATTACK,   // Creatures gain `amount` attack
+    BUFF_DEFENSE,  // Creatures gain `amount` defense
+    DRAW           // Draw `amount` cards (target SELF or OPPONENT)
+};
+
+// Who an effect applies to, relative to the player who played the card
+enum class EffectTarget : std::uint8_t {
+    SELF,           // Caster's hero
+    OPPONENT,       // Opposing hero
+    OWN_FIELD,      // Every creature on the caster's field
+    OPPONENT_FIELD  // Every creature on the opponent's field
+};
+
+struct CardEffect {
+    EffectOp op;
+    EffectTarget target;
+    std::int16_t amount;
+};
+
+constexpr std::size_t kMaxCardEffects = 4;
+
+// Static card data as read from the CardCatalog. Strings point into the
+// catalog image and stay valid as long as the catalog does.
+struct CardDefinition {
+    std::string_view id;
+    std::string_view name;
+    std::string_view description;
     int attack;
     int defense;
     int mana_cost;
     CardType type;
-    bool used_this_turn;  // Track if card has been used this turn
-    
-    Card() : used_this_turn(false) {}
-    Card(const std::string& id, const std::string& name, const std::string& description,
-         int attack, int defense, int mana_cost, CardType type)
-        : id(id), name(name), description(description), attack(attack), defense(defense),
-          mana_cost(mana_cost), type(type), used_this_turn(false) {}
+    InlineVector<CardEffect, kMaxCardEffects> effects;  // Run in order when played
+};
+
+// A card inside a battle: its definition plus the values that change in play.
+// Kept small and trivially copyable; names etc. come from the catalog.
+struct Card {
+    std::uint16_t definition = 0;  // Index into the CardCatalog
+    std::int16_t attack = 0;
+    std::int16_t defense = 0;
+    bool used_this_turn = false;  // Track if card has been used this turn
 };
 
+// Zone capacities. Cards are stored inline in PlayerState, so these bound a
+// battle's footprint; the rules enforce them (a full field rejects new
+// creatures, a draw into a full hand burns the card).
+constexpr std::size_t kMaxHandSize = 10;
+constexpr std::size_t kMaxFieldSize = 7;
+constexpr std::size_t kMaxDeckSize = 30;
+// Only a player's own cards end up in their graveyard
+constexpr std::size_t kMaxGraveyardSize = kMaxDeckSize;
+
 struct Deck {
     std::string id;
     std::string name;
@@ -65,25 +110,50 @@ struct PlayerState {
     int max_health;
     int mana;
     int max_mana;
-    std::vector<Card> hand;
-    std::vector<Card> deck;
-    std::vector<Card> field;  // Cards on the battlefield
-    std::vector<Card> graveyard;
+    InlineVector<Card, kMaxHandSize> hand;
+    InlineVector<Card, kMaxDeckSize> deck;
+    InlineVector<Card, kMaxFieldSize> field;  // Cards on the battlefield
+    InlineVector<Card, kMaxGraveyardSize> graveyard;
     bool is_active;  // Is it this player's turn
     
     PlayerState() : health(30), max_health(30), mana(1), max_mana(1), is_active(false) {}
 };
 
+// Battles always have exactly two seats
+constexpr int kHostSeat = 0;  // Host goes first
+constexpr int kGuestSeat = 1;
+constexpr int kNoSeat = -1;
+
+constexpr int OpponentSeat(int seat) { return 1 - seat; }
+
 struct BattleState {
     std::string session_id;
-    std::string current_turn;  // Player ID whose turn it is
+    int current_seat;  // Seat whose turn it is
     int turn_number;
-    std::unordered_map<std::string, PlayerState> players;
+    std::array<PlayerState, 2> players;  // Indexed by seat
     std::string winner;  // Empty if no winner yet
     bool is_finished;
     std::string last_action;  // For logging
+    std::uint64_t version;  // Bumped on every accepted change
+    // Catalog the battle started with; card indices refer to it, so it stays
+    // pinned even if a newer catalog is published mid-battle
+    std::shared_ptr<const CardCatalog> catalog;
+    // All randomness in the battle comes from rng, seeded with seed at the
+    // start, so seed + accepted actions replay the battle exactly
+    std::uint64_t seed;
+    BattleRng rng;
+    
+    BattleState() : current_seat(kHostSeat), turn_number(1), is_finished(false), version(0), seed(0) {}
+    
+    const std::string& CurrentPlayerId() const { return players[current_seat].player_id; }
     
-    BattleState() : turn_number(1), is_finished(false) {}
+    // Resolve once per connection; kNoSeat if the user is not in this battle
+    int SeatOf(const std::string& player_id) const {
+        for (int seat = 0; seat < 2; ++seat) {
+            if (players[seat].player_id == player_id) return seat;
+        }
+        return kNoSeat;
+    }
 };
 
 struct ApiResponse {
@@ -0,0 +1,381 @@
+#include "../include/battle_batch.hpp"
+#include "../include/card_catalog.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace cardbattle {
+
+namespace {
+
+// Lanes per 512-bit vector of int16
+constexpr std::size_t kLaneAlignment = 32;
+
+using I16 = std::int16_t;
+
+// Branch-free select: a mask blend, which compilers vectorize where they
+// would turn `condition ? a : b` into a jump
+inline I16 Select(bool condition, I16 if_true, I16 if_false) {
+    const auto mask = static_cast<I16>(-static_cast<int>(condition));
+    return static_cast<I16>((if_true & mask) | (if_false & ~mask));
+}
+
+} // namespace
+
+BattleBatch::BattleBatch(std::size_t lanes, std::shared_ptr<const CardCatalog> catalog)
+    : lanes_(lanes),
+      stride_((lanes + kLaneAlignment - 1) / kLaneAlignment * kLaneAlignment),
+      catalog_(std::move(catalog)),
+      data_(kColumnCount * stride_, 0),
+      scratch_(8 * stride_, 0) {}
+
+void BattleBatch::Load(std::size_t lane, const BattleState& state) {
+    if (state.catalog != catalog_) throw std::runtime_error("Battle batch: battle uses another card catalog");
+    Column(kTurn)[lane] = static_cast<I16>(state.turn_number);
+    Column(kSeat)[lane] = static_cast<I16>(state.current_seat);
+    Column(kFinished)[lane] = state.is_finished ? 1 : 0;
+    Column(kWinner)[lane] = static_cast<I16>(state.is_finished ? std::max(state.SeatOf(state.winner), 0) : 0);
+    for (int seat = 0; seat < 2; ++seat) {
+        const auto& player = state.players[seat];
+        Column(kHealth + seat)[lane] = static_cast<I16>(player.health);
+        Column(kMaxHealth + seat)[lane] = static_cast<I16>(player.max_health);
+        Column(kMana + seat)[lane] = static_cast<I16>(player.mana);
+        Column(kMaxMana + seat)[lane] = static_cast<I16>(player.max_mana);
+        Column(kFieldCount + seat)[lane] = static_cast<I16>(player.field.size());
+        Column(kHandCount + seat)[lane] = static_cast<I16>(player.hand.size());
+        Column(kDeckCount + seat)[lane] = static_cast<I16>(player.deck.size());
+        Column(kGraveyardCount + seat)[lane] = static_cast<I16>(player.graveyard.size());
+        for (std::size_t slot = 0; slot < kFieldSlots; ++slot) {
+            const Card card = slot < player.field.size() ? player.field[slot] : Card{};
+            const std::size_t index = seat * kFieldSlots + slot;
+            Column(kFieldDefinition + index)[lane] = static_cast<I16>(card.definition);
+            Column(kFieldAttack + index)[lane] = card.attack;
+            Column(kFieldDefense + index)[lane] = card.defense;
+            Column(kFieldUsed + index)[lane] = card.used_this_turn ? 1 : 0;
+        }
+        for (std::size_t slot = 0; slot < player.hand.size(); ++slot) {
+            Column(kHandDefinition + seat * kHandSlots + slot)[lane] = static_cast<I16>(player.hand[slot].definition);
+        }
+        for (std::size_t slot = 0; slot < player.deck.size(); ++slot) {
+            Column(kDeckDefinition + seat * kDeckSlots + slot)[lane] = static_cast<I16>(player.deck[slot].definition);
+        }
+        for (std::size_t slot = 0; slot < player.graveyard.size(); ++slot) {
+            const Card& card = player.graveyard[slot];
+            const std::size_t index = seat * kGraveyardSlots + slot;
+            Column(kGraveyardDefinition + index)[lane] = static_cast<I16>(card.definition);
+            Column(kGraveyardAttack + index)[lane] = card.attack;
+            Column(kGraveyardDefense + index)[lane] = card.defense;
+            Column(kGraveyardUsed + index)[lane] = card.used_this_turn ? 1 : 0;
+        }
+    }
+}
+
+void BattleBatch::Store(std::size_t lane, BattleState& state) const {
+    state.turn_number = Column(kTurn)[lane];
+    state.current_seat = Column(kSeat)[lane];
+    state.is_finished = Column(kFinished)[lane] != 0;
+    state.winner = state.is_finished ? state.players[Column(kWinner)[lane]].player_id : std::string();
+    for (int seat = 0; seat < 2; ++seat) {
+        auto& player = state.players[seat];
+        player.health = Column(kHealth + seat)[lane];
+        player.max_health = Column(kMaxHealth + seat)[lane];
+        player.mana = Column(kMana + seat)[lane];
+        player.max_mana = Column(kMaxMana + seat)[lane];
+        player.is_active = seat == state.current_seat;
+        player.field.clear();
+        for (int slot = 0; slot < Column(kFieldCount + seat)[lane]; ++slot) {
+            const std::size_t index = seat * kFieldSlots + slot;
+            Card card;
+            card.definition = static_cast<std::uint16_t>(Column(kFieldDefinition + index)[lane]);
+            card.attack = Column(kFieldAttack + index)[lane];
+            card.defense = Column(kFieldDefense + index)[lane];
+            card.used_this_turn = Column(kFieldUsed + index)[lane] != 0;
+            player.field.push_back(card);
+        }
+        player.hand.clear();
+        for (int slot = 0; slot < Column(kHandCount + seat)[lane]; ++slot) {
+            player.hand.push_back(catalog_->Instantiate(
+                static_cast<std::uint16_t>(Column(kHandDefinition + seat * kHandSlots + slot)[lane])));
+        }
+        player.deck.clear();
+        for (int slot = 0; slot < Column(kDeckCount + seat)[lane]; ++slot) {
+            player.deck.push_back(catalog_->Instantiate(
+                static_cast<std::uint16_t>(Column(kDeckDefinition + seat * kDeckSlots + slot)[lane])));
+        }
+        player.graveyard.clear();
+        for (int slot = 0; slot < Column(kGraveyardCount + seat)[lane]; ++slot) {
+            const std::size_t index = seat * kGraveyardSlots + slot;
+            Card card;
+            card.definition = static_cast<std::uint16_t>(Column(kGraveyardDefinition + index)[lane]);
+            card.attack = Column(kGraveyardAttack + index)[lane];
+            card.defense = Column(kGraveyardDefense + index)[lane];
+            card.used_this_turn = Column(kGraveyardUsed + index)[lane] != 0;
+            player.graveyard.push_back(card);
+        }
+    }
+}
+
+void BattleBatch::Attack(const I16* active, const I16* attacker_index, const I16* target_index) {
+    const std::size_t n = lanes_;
+    const I16* seat = Column(kSeat);
+    I16* finished = Column(kFinished);
+    I16* winner = Column(kWinner);
+    I16* health0 = Column(kHealth);
+    I16* health1 = Column(kHealth + 1);
+    I16* field_count0 = Column(kFieldCount);
+    I16* field_count1 = Column(kFieldCount + 1);
+
+    I16* act = Scratch(0);             // Lane attacks at all
+    I16* has_target = Scratch(1);      // Attacks a creature, not the hero
+    I16* attacker_attack = Scratch(2);
+    I16* attacker_defense = Scratch(3);
+    I16* target_attack = Scratch(4);
+    I16* target_defense = Scratch(5);
+    I16* removed0 = Scratch(6);        // Field slot of seat 0 that died, or -1
+    I16* removed1 = Scratch(7);
+
+    I16 any = 0;
+    #pragma omp simd reduction(|:any)
+    for (std::size_t i = 0; i < n; ++i) {
+        const bool attacks = (active[i] != 0) & (finished[i] == 0);
+        const I16 opponent_count = Select(seat[i] != 0, field_count0[i], field_count1[i]);
+        act[i] = attacks;
+        has_target[i] = attacks & (target_index[i] >= 0) & (target_index[i] < opponent_count);
+        attacker_attack[i] = attacker_defense[i] = target_attack[i] = target_defense[i] = 0;
+        any = static_cast<I16>(any | attacks);
+    }
+    // Late in a rollout most lanes are done; skip the passes below
+    if (!any) return;
+
+    // Gather both cards: a compare and select per slot instead of indexing
+    for (std::size_t slot = 0; slot < kFieldSlots; ++slot) {
+        const I16* attack0 = Column(kFieldAttack + slot);
+        const I16* attack1 = Column(kFieldAttack + kFieldSlots + slot);
+        const I16* defense0 = Column(kFieldDefense + slot);
+        const I16* defense1 = Column(kFieldDefense + kFieldSlots + slot);
+        const auto s = static_cast<I16>(slot);
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool second = seat[i] != 0;
+            const bool is_attacker = attacker_index[i] == s;
+            const bool is_target = target_index[i] == s;
+            attacker_attack[i] = Select(is_attacker, Select(second, attack1[i], attack0[i]), attacker_attack[i]);
+            attacker_defense[i] = Select(is_attacker, Select(second, defense1[i], defense0[i]), attacker_defense[i]);
+            target_attack[i] = Select(is_target, Select(second, attack0[i], attack1[i]), target_attack[i]);
+            target_defense[i] = Select(is_target, Select(second, defense0[i], defense1[i]), target_defense[i]);
+        }
+    }
+
+    // Combat math
+    #pragma omp simd
+    for (std::size_t i = 0; i < n; ++i) {
+        const bool second = seat[i] != 0;
+        const bool fight = has_target[i] != 0;
+        const bool direct = (act[i] != 0) & !fight;
+        const I16 damage = Select(direct, attacker_attack[i], 0);
+        const auto h0 = static_cast<I16>(health0[i] - Select(second, damage, 0));
+        const auto h1 = static_cast<I16>(health1[i] - Select(second, 0, damage));
+        health0[i] = h0;
+        health1[i] = h1;
+        const bool won = direct & (Select(second, h0, h1) <= 0);
+        finished[i] = static_cast<I16>(finished[i] | won);
+        winner[i] = Select(won, seat[i], winner[i]);
+
+        const auto target_left = static_cast<I16>(target_defense[i] - Select(fight, attacker_attack[i], 0));
+        const auto attacker_left = static_cast<I16>(attacker_defense[i] - Select(fight, target_attack[i], 0));
+        target_defense[i] = target_left;
+        attacker_defense[i] = attacker_left;
+        const I16 attacker_slot = Select(fight & (attacker_left <= 0), attacker_index[i], -1);
+        const I16 target_slot = Select(fight & (target_left <= 0), target_index[i], -1);
+        removed0[i] = Select(second, target_slot, attacker_slot);
+        removed1[i] = Select(second, attacker_slot, target_slot);
+    }
+
+    // Write back the new defenses and mark the attacker used
+    for (std::size_t slot = 0; slot < kFieldSlots; ++slot) {
+        I16* defense0 = Column(kFieldDefense + slot);
+        I16* defense1 = Column(kFieldDefense + kFieldSlots + slot);
+        I16* used0 = Column(kFieldUsed + slot);
+        I16* used1 = Column(kFieldUsed + kFieldSlots + slot);
+        const auto s = static_cast<I16>(slot);
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool second = seat[i] != 0;
+            const bool is_attacker = (act[i] != 0) & (attacker_index[i] == s);
+            const bool is_target = (has_target[i] != 0) & (target_index[i] == s);
+            const bool attacker0 = is_attacker & !second;
+            const bool attacker1 = is_attacker & second;
+            defense0[i] = Select(attacker0, attacker_defense[i], Select(is_target & second, target_defense[i], defense0[i]));
+            defense1[i] = Select(attacker1, attacker_defense[i], Select(is_target & !second, target_defense[i], defense1[i]));
+            used0[i] = static_cast<I16>(used0[i] | attacker0);
+            used1[i] = static_cast<I16>(used1[i] | attacker1);
+        }
+    }
+
+    // Dead creatures go to the graveyard in the order the rules bury them
+    // (target first); deaths are few, so this pass is scalar
+    for (std::size_t i = 0; i < n; ++i) {
+        if ((removed0[i] & removed1[i]) == -1) continue;  // Neither died
+        const int opponent = OpponentSeat(seat[i]);
+        const I16 target_removed = opponent ? removed1[i] : removed0[i];
+        const I16 attacker_removed = opponent ? removed0[i] : removed1[i];
+        if (target_removed >= 0) BuryFieldCard(i, opponent, target_removed);
+        if (attacker_removed >= 0) BuryFieldCard(i, seat[i], attacker_removed);
+    }
+
+    // Close the gaps: from the removed slot on, each slot takes the next one
+    // (i + stride_ is the same lane in the next slot's column)
+    for (int side = 0; side < 2; ++side) {
+        const I16* removed = side ? removed1 : removed0;
+        for (std::size_t slot = 0; slot + 1 < kFieldSlots; ++slot) {
+            const std::size_t index = side * kFieldSlots + slot;
+            I16* definition = Column(kFieldDefinition + index);
+            I16* attack = Column(kFieldAttack + index);
+            I16* defense = Column(kFieldDefense + index);
+            I16* used = Column(kFieldUsed + index);
+            const auto s = static_cast<I16>(slot);
+            #pragma omp simd
+            for (std::size_t i = 0; i < n; ++i) {
+                const bool shift = (removed[i] >= 0) & (s >= removed[i]);
+                definition[i] = Select(shift, definition[i + stride_], definition[i]);
+                attack[i] = Select(shift, attack[i + stride_], attack[i]);
+                defense[i] = Select(shift, defense[i + stride_], defense[i]);
+                used[i] = Select(shift, used[i + stride_], used[i]);
+            }
+        }
+        I16* field_count = side ? field_count1 : field_count0;
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; ++i) field_count[i] = static_cast<I16>(field_count[i] - (removed[i] >= 0));
+    }
+}
+
+void BattleBatch::BuryFieldCard(std::size_t lane, int seat, int slot) {
+    I16& count = Column(kGraveyardCount + seat)[lane];
+    const std::size_t from = seat * kFieldSlots + slot;
+    const std::size_t to = seat * kGraveyardSlots + count;
+    Column(kGraveyardDefinition + to)[lane] = Column(kFieldDefinition + from)[lane];
+    Column(kGraveyardAttack + to)[lane] = Column(kFieldAttack + from)[lane];
+    Column(kGraveyardDefense + to)[lane] = Column(kFieldDefense + from)[lane];
+    Column(kGraveyardUsed + to)[lane] = Column(kFieldUsed + from)[lane];
+    ++count;
+}
+
+void BattleBatch::EndTurn(const I16* active) {
+    const std::size_t n = lanes_;
+    I16* seat = Column(kSeat);
+    I16* turn = Column(kTurn);
+    I16* finished = Column(kFinished);
+    I16* winner = Column(kWinner);
+    I16* act = Scratch(0);
+    I16* drawn = Scratch(1);     // Definition of the card drawn
+    I16* to_hand = Scratch(2);   // Drawn into the hand
+    I16* burned = Scratch(3);    // Drawn into a full hand, so burned
+
+    // Pass the turn; the new player's mana grows with the turn number
+    I16 any = 0;
+    #pragma omp simd reduction(|:any)
+    for (std::size_t i = 0; i < n; ++i) {
+        const bool passes = (active[i] != 0) & (finished[i] == 0);
+        act[i] = passes;
+        seat[i] = static_cast<I16>(seat[i] ^ passes);
+        turn[i] = static_cast<I16>(turn[i] + passes);
+        any = static_cast<I16>(any | passes);
+    }
+    if (!any) return;
+    for (int side = 0; side < 2; ++side) {
+        I16* mana = Column(kMana + side);
+        I16* max_mana = Column(kMaxMana + side);
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool refill = (act[i] != 0) & (seat[i] == side);
+            const I16 new_max = Select(turn[i] < 10, turn[i], 10);
+            max_mana[i] = Select(refill, new_max, max_mana[i]);
+            mana[i] = Select(refill, new_max, mana[i]);
+        }
+        for (std::size_t slot = 0; slot < kFieldSlots; ++slot) {
+            I16* used = Column(kFieldUsed + side * kFieldSlots + slot);
+            #pragma omp simd
+            for (std::size_t i = 0; i < n; ++i) used[i] = Select(act[i] != 0, 0, used[i]);
+        }
+    }
+
+    // Draw: the top of the deck is its last slot. With 30 slots a plain
+    // indexed load per lane beats comparing against every slot.
+    for (std::size_t i = 0; i < n; ++i) {
+        const I16 deck_count = Column(kDeckCount + seat[i])[i];
+        drawn[i] = deck_count > 0 ? Column(kDeckDefinition + seat[i] * kDeckSlots + deck_count - 1)[i] : I16{0};
+    }
+    for (int side = 0; side < 2; ++side) {
+        I16* deck_count = Column(kDeckCount + side);
+        I16* hand_count = Column(kHandCount + side);
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool draws = (act[i] != 0) & (seat[i] == side) & (deck_count[i] > 0);
+            const bool fits = hand_count[i] < static_cast<I16>(kHandSlots);
+            to_hand[i] = draws & fits;
+            burned[i] = draws & !fits;
+            deck_count[i] = static_cast<I16>(deck_count[i] - draws);
+        }
+        for (std::size_t slot = 0; slot < kHandSlots; ++slot) {
+            I16* hand = Column(kHandDefinition + side * kHandSlots + slot);
+            const auto s = static_cast<I16>(slot);
+            #pragma omp simd
+            for (std::size_t i = 0; i < n; ++i) {
+                hand[i] = Select((to_hand[i] != 0) & (hand_count[i] == s), drawn[i], hand[i]);
+            }
+        }
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; ++i) hand_count[i] = static_cast<I16>(hand_count[i] + to_hand[i]);
+        // Burning needs a full hand, which is rare; scalar
+        for (std::size_t i = 0; i < n; ++i) {
+            if (!burned[i]) continue;
+            const Card card = catalog_->Instantiate(static_cast<std::uint16_t>(drawn[i]));
+            I16& count = Column(kGraveyardCount + side)[i];
+            const std::size_t to = side * kGraveyardSlots + count;
+            Column(kGraveyardDefinition + to)[i] = drawn[i];
+            Column(kGraveyardAttack + to)[i] = card.attack;
+            Column(kGraveyardDefense + to)[i] = card.defense;
+            Column(kGraveyardUsed + to)[i] = 0;
+            ++count;
+        }
+    }
+
+    // Both players out of cards: the healthier one wins, the host on a tie
+    const I16* health0 = Column(kHealth);
+    const I16* health1 = Column(kHealth + 1);
+    const I16* hand_count0 = Column(kHandCount);
+    const I16* hand_count1 = Column(kHandCount + 1);
+    const I16* deck_count0 = Column(kDeckCount);
+    const I16* deck_count1 = Column(kDeckCount + 1);
+    #pragma omp simd
+    for (std::size_t i = 0; i < n; ++i) {
+        const bool exhausted =
+            (act[i] != 0) & ((hand_count0[i] | hand_count1[i] | deck_count0[i] | deck_count1[i]) == 0);
+        finished[i] = static_cast<I16>(finished[i] | exhausted);
+        winner[i] = Select(exhausted, health1[i] > health0[i], winner[i]);
+    }
+}
+
+void BattleBatch::FindReadyAttacker(I16* attacker_index) const {
+    const std::size_t n = lanes_;
+    const I16* seat = Column(kSeat);
+    const I16* finished = Column(kFinished);
+    const I16* field_count0 = Column(kFieldCount);
+    const I16* field_count1 = Column(kFieldCount + 1);
+    #pragma omp simd
+    for (std::size_t i = 0; i < n; ++i) attacker_index[i] = -1;
+    // Downwards, so the lowest ready slot wins
+    for (std::size_t slot = kFieldSlots; slot-- > 0;) {
+        const I16* used0 = Column(kFieldUsed + slot);
+        const I16* used1 = Column(kFieldUsed + kFieldSlots + slot);
+        const auto s = static_cast<I16>(slot);
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool second = seat[i] != 0;
+            const I16 count = Select(second, field_count1[i], field_count0[i]);
+            const I16 used = Select(second, used1[i], used0[i]);
+            attacker_index[i] = Select((finished[i] == 0) & (s < count) & (used == 0), s, attacker_index[i]);
+        }
+    }
+}
+
+} // namespace cardbattle
@@ -0,0 +1,167 @@
+#include "../include/battle_mcts.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace cardbattle {
+
+namespace {
+
+struct Node {
+    BattleAction action;  // Move that led here from the parent
+    std::uint32_t first_child = 0;
+    std::uint32_t child_count = 0;
+    bool expanded = false;
+    int mover = kNoSeat;  // Seat that made `action`; rewards are from its side
+    std::uint32_t visits = 0;
+    double reward = 0;
+};
+
+// Deals the cards the searching player cannot see: the opponent's hand and
+// deck are one pool, dealt back in their sizes; the own deck is reshuffled.
+// Future randomness of the rules is unknown as well.
+void Determinize(BattleState& state, int seat, BattleRng& rng) {
+    auto& own = state.players[seat];
+    rng.Shuffle(own.deck.begin(), own.deck.end());
+    auto& opponent = state.players[OpponentSeat(seat)];
+    InlineVector<Card, kMaxHandSize + kMaxDeckSize> pool;
+    for (const Card& card : opponent.hand) pool.push_back(card);
+    for (const Card& card : opponent.deck) pool.push_back(card);
+    rng.Shuffle(pool.begin(), pool.end());
+    const std::size_t hand_size = opponent.hand.size();
+    for (std::size_t i = 0; i < pool.size(); ++i) {
+        if (i < hand_size) {
+            opponent.hand[i] = pool[i];
+        } else {
+            opponent.deck[i - hand_size] = pool[i];
+        }
+    }
+    state.rng.Seed(rng.Next());
+}
+
+// 1 for a win of `seat`, 0 for a loss; unfinished games score on health
+double Score(const BattleState& state, int seat) {
+    if (state.is_finished) return state.winner == state.players[seat].player_id ? 1.0 : 0.0;
+    const int lead = state.players[seat].health - state.players[OpponentSeat(seat)].health;
+    return std::clamp(0.5 + lead / 60.0, 0.05, 0.95);
+}
+
+// Playout policy: play and attack at random, end the turn only when there
+// is nothing else to do. Much stronger than ending turns at random, and
+// still cheap.
+void Playout(BattleState& state, int depth, BattleRng& rng, std::vector<BattleAction>& actions) {
+    for (int step = 0; step < depth && !state.is_finished; ++step) {
+        ListLegalActions(state, actions);
+        const auto choices = static_cast<std::uint32_t>(actions.size() - 1);  // END_TURN is last
+        ApplyAction(state, choices == 0 ? actions.back() : actions[rng.NextBelow(choices)]);
+    }
+}
+
+} // namespace
+
+MctsRootStats RunMctsTree(const BattleState& state, std::uint64_t seed, const MctsSettings& settings,
+                          std::chrono::steady_clock::time_point deadline) {
+    MctsRootStats stats;
+    if (state.is_finished) return stats;
+    const int root_seat = state.current_seat;
+    BattleRng rng(seed);
+    BattleState world = state;
+    Determinize(world, root_seat, rng);
+
+    std::vector<Node> nodes(1);
+    std::vector<BattleAction> actions;
+    std::vector<std::uint32_t> path;
+    BattleState scratch;
+    const double exploration = settings.exploration;
+
+    while (settings.max_iterations == 0 || stats.iterations < settings.max_iterations) {
+        // The first iteration always runs, so a late call still gets a move
+        if (stats.iterations > 0 && std::chrono::steady_clock::now() >= deadline) break;
+        scratch = world;
+        path.assign(1, 0);
+        std::uint32_t current = 0;
+
+        // Selection: UCB1 down to a leaf, unvisited children first
+        while (nodes[current].expanded && nodes[current].child_count > 0) {
+            const Node& node = nodes[current];
+            const double log_visits = std::log(static_cast<double>(node.visits));
+            std::uint32_t best = node.first_child;
+            double best_score = -1;
+            for (std::uint32_t child = node.first_child; child < node.first_child + node.child_count; ++child) {
+                const Node& candidate = nodes[child];
+                if (candidate.visits == 0) {
+                    best = child;
+                    break;
+                }
+                const double score = candidate.reward / candidate.visits +
+                                     exploration * std::sqrt(log_visits / candidate.visits);
+                if (score > best_score) {
+                    best_score = score;
+                    best = child;
+                }
+            }
+            ApplyAction(scratch, nodes[best].action);
+            current = best;
+            path.push_back(current);
+        }
+
+        // Expansion: all moves at once, the first one is tried right away
+        if (!nodes[current].expanded && !scratch.is_finished && nodes.size() < settings.max_nodes) {
+            ListLegalActions(scratch, actions);
+            const auto first_child = static_cast<std::uint32_t>(nodes.size());
+            for (const auto& action : actions) {
+                Node child;
+                child.action = action;
+                child.mover = scratch.current_seat;
+                nodes.push_back(child);
+            }
+            nodes[current].expanded = true;
+            nodes[current].first_child = first_child;
+            nodes[current].child_count = static_cast<std::uint32_t>(actions.size());
+            // Moves are listed in a fixed order; start with a random one
+            const std::uint32_t pick = first_child + rng.NextBelow(static_cast<std::uint32_t>(actions.size()));
+            ApplyAction(scratch, nodes[pick].action);
+            current = pick;
+            path.push_back(current);
+        }
+
+        Playout(scratch, settings.rollout_depth, rng, actions);
+        const double score = Score(scratch, root_seat);
+        for (const std::uint32_t index : path) {
+            Node& node = nodes[index];
+            ++node.visits;
+            node.reward += node.mover == root_seat ? score : 1.0 - score;
+        }
+        ++stats.iterations;
+    }
+
+    const Node& root = nodes[0];
+    for (std::uint32_t child = root.first_child; child < root.first_child + root.child_count; ++child) {
+        stats.actions.push_back(nodes[child].action);
+        stats.visits.push_back(nodes[child].visits);
+        stats.rewards.push_back(nodes[child].reward);
+    }
+    return stats;
+}
+
+BattleAction PickMctsAction(const std::vector<MctsRootStats>& trees) {
+    // Every tree lists the same root moves in the same order; guard anyway
+    const MctsRootStats* first = nullptr;
+    for (const auto& tree : trees) {
+        if (!tree.actions.empty()) {
+            first = &tree;
+            break;
+        }
+    }
+    if (!first) throw std::runtime_error("No move to pick");
+
+    std::vector<std::uint64_t> visits(first->actions.size(), 0);
+    for (const auto& tree : trees) {
+        if (tree.actions.size() != visits.size()) continue;
+        for (std::size_t i = 0; i < visits.size(); ++i) visits[i] += tree.visits[i];
+    }
+    const auto best = std::max_element(visits.begin(), visits.end()) - visits.begin();
+    return first->actions[best];
+}
+
+} // namespace cardbattle
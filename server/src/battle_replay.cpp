@@ -0,0 +1,198 @@
+#include "../include/battle_replay.hpp"
+#include "../include/battle_rules.hpp"
+#include <stdexcept>
+#include <unordered_set>
+
+namespace cardbattle {
+
+namespace {
+
+// Everything the journal says about one battle, in apply order
+struct BattlePlan {
+    bool started = false;  // Its BATTLE_STARTED is in the journal
+    std::uint64_t seed = 0;
+    std::string host_id;
+    std::string guest_id;
+    std::vector<const OwnedJournalRecord*> actions;
+    bool hibernated = false;  // On disk since its last action, not restored
+};
+
+} // namespace
+
+OwnedJournalRecord::OwnedJournalRecord(const JournalRecord& record)
+    : type(record.type),
+      seat(record.seat),
+      arg0(record.arg0),
+      arg1(record.arg1),
+      version(record.version),
+      seed(record.seed),
+      session_id(record.session_id),
+      host_id(record.host_id),
+      guest_id(record.guest_id) {}
+
+ReplayResult ReplayJournal(const std::vector<std::vector<OwnedJournalRecord>>& segments,
+                           std::vector<BattleState> snapshots, std::shared_ptr<const CardCatalog> catalog,
+                           unsigned threads) {
+    ReplayResult result;
+
+    // Group by battle in journal order. Session ids are reused, so a new
+    // start replaces whatever came before it and an end forgets the battle.
+    std::unordered_map<std::string, BattlePlan> plans;
+    std::unordered_set<std::string> ended;
+    for (const auto& segment_records : segments) {
+        result.records += segment_records.size();
+        for (const auto& record : segment_records) {
+            switch (record.type) {
+                case JournalRecordType::BATTLE_STARTED: {
+                    auto& plan = plans[record.session_id];
+                    plan = BattlePlan{true, record.seed, record.host_id, record.guest_id, {}};
+                    ended.erase(record.session_id);
+                    break;
+                }
+                case JournalRecordType::BATTLE_ENDED:
+                    plans.erase(record.session_id);
+                    ended.insert(record.session_id);
+                    break;
+                case JournalRecordType::BATTLE_HIBERNATED:
+                    plans[record.session_id].hibernated = true;
+                    break;
+                default: {
+                    // An action after hibernation means it was rehydrated
+                    auto& plan = plans[record.session_id];
+                    plan.hibernated = false;
+                    plan.actions.push_back(&record);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Pick each battle's base: a snapshot of the same battle (same seed)
+    // wins over replaying from the start
+    struct Work {
+        std::string session_id;
+        const BattlePlan* plan = nullptr;
+        BattleState* snapshot = nullptr;
+        std::optional<BattleState> state;
+        std::string error;
+    };
+    std::vector<Work> work;
+    std::unordered_map<std::string, std::size_t> work_by_session;
+    std::unordered_set<std::string> hibernated;
+    for (auto& [session_id, plan] : plans) {
+        // Left on disk, where the hibernator finds them
+        if (plan.hibernated) {
+            hibernated.insert(session_id);
+            continue;
+        }
+        work_by_session[session_id] = work.size();
+        work.push_back({session_id, &plan, nullptr, std::nullopt, {}});
+    }
+    for (auto& snapshot : snapshots) {
+        if (ended.count(snapshot.session_id) || hibernated.count(snapshot.session_id)) continue;
+        auto it = work_by_session.find(snapshot.session_id);
+        if (it == work_by_session.end()) {
+            work_by_session[snapshot.session_id] = work.size();
+            work.push_back({snapshot.session_id, nullptr, &snapshot, std::nullopt, {}});
+            continue;
+        }
+        auto& item = work[it->second];
+        if (!item.plan->started || item.plan->seed == snapshot.seed) {
+            if (!item.snapshot || item.snapshot->version < snapshot.version) item.snapshot = &snapshot;
+        }
+    }
+
+    // Replay in parallel; battles are independent
+    ParallelFor(work.size(), std::max(threads, 1u), [&](std::size_t i) {
+        auto& item = work[i];
+        try {
+            BattleState state;
+            if (item.snapshot) {
+                state = std::move(*item.snapshot);
+                if (!state.catalog) state.catalog = catalog;
+            } else if (item.plan && item.plan->started) {
+                state = NewBattleState(item.session_id, item.plan->host_id, item.plan->guest_id, item.plan->seed,
+                                       catalog);
+            } else {
+                throw std::runtime_error("start of battle is missing from the journal");
+            }
+            if (item.plan) {
+                for (const auto* action : item.plan->actions) {
+                    if (action->version <= state.version) continue;
+                    ApplyJournaled(state, action->type, action->seat, action->arg0, action->arg1);
+                    state.version = action->version;
+                }
+            }
+            item.state = std::move(state);
+        } catch (const std::exception& e) {
+            item.error = e.what();
+        }
+    });
+
+    for (auto& item : work) {
+        if (item.state) {
+            result.battles.push_back(std::move(*item.state));
+        } else {
+            result.failed.emplace_back(std::move(item.session_id), std::move(item.error));
+        }
+    }
+    return result;
+}
+
+void ApplyJournaled(BattleState& battle_state, JournalRecordType type, int seat, int arg0, int arg1) {
+    switch (type) {
+        case JournalRecordType::PLAY_CARD:
+            ApplyPlayCard(battle_state, seat, arg0);
+            break;
+        case JournalRecordType::ATTACK:
+            ApplyAttack(battle_state, seat, arg0, arg1);
+            break;
+        case JournalRecordType::END_TURN:
+            ApplyEndTurn(battle_state, seat);
+            break;
+        case JournalRecordType::SURRENDER:
+            ApplySurrender(battle_state, seat);
+            break;
+        default:
+            throw std::runtime_error("Unexpected journal record type " + std::to_string(static_cast<int>(type)));
+    }
+}
+
+void JournalSegmentSummary::Add(const JournalRecord& record) {
+    auto& battle = battles[std::string(record.session_id)];
+    switch (record.type) {
+        case JournalRecordType::BATTLE_STARTED:
+            // Whatever came before belongs to an earlier battle
+            battle = Battle{record.version, false};
+            break;
+        case JournalRecordType::BATTLE_ENDED:
+            battle = Battle{0, true};
+            break;
+        default:
+            battle.max_version = std::max(battle.max_version, record.version);
+            battle.ended = false;
+            break;
+    }
+}
+
+bool IsJournalCovered(const JournalSegmentSummary::Battle& battle, std::optional<std::uint64_t> snapshot_version,
+                      bool live) {
+    if (battle.ended) return !snapshot_version;
+    if (snapshot_version) return *snapshot_version >= battle.max_version;
+    return !live;
+}
+
+std::size_t RetirableSegments(
+    const std::vector<std::shared_ptr<const JournalSegmentSummary>>& segments,
+    const std::function<bool(const std::string& session_id, const JournalSegmentSummary::Battle& battle)>& covered) {
+    std::size_t count = 0;
+    for (const auto& segment : segments) {
+        for (const auto& [session_id, battle] : segment->battles) {
+            if (!covered(session_id, battle)) return count;
+        }
+        ++count;
+    }
+    return count;
+}
+
+} // namespace cardbattle
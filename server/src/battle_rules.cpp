@@ -0,0 +1,413 @@
+#include "../include/battle_rules.hpp"
+#include "../include/card_catalog.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace cardbattle {
+
+namespace {
+
+void DrawCards(BattleState& battle, int seat, int count) {
+    auto& deck = battle.players[seat].deck;
+    auto& hand = battle.players[seat].hand;
+
+    for (int i = 0; i < count && !deck.empty(); ++i) {
+        // Drawing into a full hand burns the card
+        if (hand.full()) {
+            battle.players[seat].graveyard.push_back(deck.back());
+        } else {
+            hand.push_back(deck.back());
+        }
+        deck.pop_back();
+    }
+}
+
+void InitializePlayerDeck(BattleState& battle, int seat) {
+    auto& player = battle.players[seat];
+
+    // Convert card IDs to card instances from the catalog
+    for (const auto& card_id : StarterDeckCardIds()) {
+        if (player.deck.full()) break;
+        if (auto index = battle.catalog->Find(card_id)) {
+            player.deck.push_back(battle.catalog->Instantiate(*index));
+        }
+    }
+
+    // Shuffle the deck
+    battle.rng.Shuffle(player.deck.begin(), player.deck.end());
+
+    // Draw initial hand
+    DrawCards(battle, seat, 4);
+}
+
+void RemoveDeadCreatures(PlayerState& player) {
+    for (auto it = player.field.begin(); it != player.field.end();) {
+        if (it->defense <= 0) {
+            player.graveyard.push_back(*it);
+            it = player.field.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ApplyEffect(BattleState& battle_state, int seat, const CardEffect& effect) {
+    const bool targets_own_side = effect.target == EffectTarget::SELF || effect.target == EffectTarget::OWN_FIELD;
+    const bool targets_hero = effect.target == EffectTarget::SELF || effect.target == EffectTarget::OPPONENT;
+    const int target_seat = targets_own_side ? seat : OpponentSeat(seat);
+    auto& target = battle_state.players[target_seat];
+
+    switch (effect.op) {
+        case EffectOp::DAMAGE:
+            if (targets_hero) {
+                target.health -= effect.amount;
+                if (target.health <= 0) {
+                    EndGame(battle_state, OpponentSeat(target_seat));
+                }
+            } else {
+                for (auto& card : target.field) {
+                    card.defense -= effect.amount;
+                }
+                RemoveDeadCreatures(target);
+            }
+            break;
+
+        case EffectOp::HEAL:
+            if (targets_hero) {
+                target.health = std::min(target.max_health, target.health + effect.amount);
+            } else {
+                // Creatures heal up to their printed defense, buffs above it are kept
+                for (auto& card : target.field) {
+                    int base_defense = battle_state.catalog->Get(card.definition).defense;
+                    if (card.defense < base_defense) {
+                        card.defense = static_cast<std::int16_t>(std::min(base_defense, card.defense + effect.amount));
+                    }
+                }
+            }
+            break;
+
+        case EffectOp::BUFF_ATTACK:
+            if (!targets_hero) {
+                for (auto& card : target.field) {
+                    card.attack += effect.amount;
+                }
+            }
+            break;
+
+        case EffectOp::BUFF_DEFENSE:
+            if (!targets_hero) {
+                for (auto& card : target.field) {
+                    card.defense += effect.amount;
+                }
+            }
+            break;
+
+        case EffectOp::DRAW:
+            DrawCards(battle_state, target_seat, effect.amount);
+            break;
+    }
+}
+
+void HandleSpellEffect(BattleState& battle_state, int seat, const CardDefinition& spell) {
+    // What a spell does is data on its definition, run effect by effect
+    for (const CardEffect& effect : spell.effects) {
+        if (battle_state.is_finished) break;
+        ApplyEffect(battle_state, seat, effect);
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const CardCatalog> MakeBuiltinCardCatalog() {
+    std::vector<CardSpec> cards = {
+        {"card_001", "Fire Elemental", "A powerful fire creature", 5, 3, 4, CardType::CREATURE, {}},
+        {"card_002", "Water Spirit", "A mystical water being", 3, 5, 3, CardType::CREATURE, {}},
+        {"card_003", "Lightning Bolt", "Deal 3 damage to target", 0, 0, 2, CardType::SPELL,
+         {{EffectOp::DAMAGE, EffectTarget::OPPONENT, 3}}},
+        {"card_004", "Dragon", "A mighty dragon", 8, 6, 7, CardType::CREATURE, {}},
+        {"card_005", "Healing Potion", "Restore 4 health", 0, 0, 3, CardType::SPELL,
+         {{EffectOp::HEAL, EffectTarget::SELF, 4}}},
+        {"card_006", "Knight", "A noble warrior", 4, 4, 4, CardType::CREATURE, {}},
+        {"card_007", "Magic Shield", "Gain 3 defense", 0, 0, 2, CardType::SPELL,
+         {{EffectOp::HEAL, EffectTarget::SELF, 3}}},  // Defense is added to the hero's health
+        {"card_008", "Goblin", "A small but fierce creature", 2, 1, 1, CardType::CREATURE, {}},
+        {"card_009", "Wizard", "A powerful spellcaster", 3, 2, 5, CardType::CREATURE, {}},
+        {"card_010", "Forest Guardian", "Protector of nature", 6, 7, 6, CardType::CREATURE, {}},
+    };
+    return CardCatalog::FromImage(CardCatalog::Compile(cards), "<built-in>");
+}
+
+const std::vector<std::string>& StarterDeckCardIds() {
+    // Use a simple prespecified deck for all players
+    static const std::vector<std::string> kCardIds = {
+        "card_001", "card_002", "card_003", "card_004", "card_005",
+        "card_006", "card_007", "card_008", "card_009", "card_010"
+    };
+    return kCardIds;
+}
+
+BattleState NewBattleState(const std::string& session_id, const std::string& host_id, const std::string& guest_id,
+                           std::uint64_t seed, std::shared_ptr<const CardCatalog> catalog) {
+    // Deterministic given the arguments; recovery relies on that
+    BattleState battle_state;
+    battle_state.session_id = session_id;
+    battle_state.current_seat = kHostSeat; // Host goes first
+    battle_state.turn_number = 1;
+    battle_state.is_finished = false;
+    battle_state.last_action = "Battle started";
+    battle_state.catalog = std::move(catalog);
+    battle_state.seed = seed;
+    battle_state.rng.Seed(seed);
+
+    // Initialize host player
+    PlayerState host_state;
+    host_state.player_id = host_id;
+    host_state.health = 30;
+    host_state.max_health = 30;
+    host_state.mana = 1; // Start with 1 mana
+    host_state.max_mana = 1;
+    host_state.is_active = true;
+
+    // Initialize guest player
+    PlayerState guest_state;
+    guest_state.player_id = guest_id;
+    guest_state.health = 30;
+    guest_state.max_health = 30;
+    guest_state.mana = 1;
+    guest_state.max_mana = 1;
+    guest_state.is_active = false;
+
+    // Store player states in battle state first
+    battle_state.players[kHostSeat] = host_state;
+    battle_state.players[kGuestSeat] = guest_state;
+
+    // Initialize decks for both players (after storing player states)
+    InitializePlayerDeck(battle_state, kHostSeat);
+    InitializePlayerDeck(battle_state, kGuestSeat);
+    return battle_state;
+}
+
+void ApplyPlayCard(BattleState& battle_state, int seat, int hand_index) {
+    // Check if it's the player's turn (also rejects non-players)
+    if (battle_state.current_seat != seat) {
+        throw std::runtime_error("Not your turn");
+    }
+
+    auto& player_state = battle_state.players[seat];
+    const std::string& player_id = player_state.player_id;
+
+    // Check if hand index is valid
+    if (hand_index < 0 || hand_index >= static_cast<int>(player_state.hand.size())) {
+        throw std::runtime_error("Invalid hand index");
+    }
+
+    Card card_to_play = player_state.hand[hand_index];
+    const CardDefinition definition = battle_state.catalog->Get(card_to_play.definition);
+
+    // Check if player has enough mana
+    if (player_state.mana < definition.mana_cost) {
+        throw std::runtime_error("Not enough mana");
+    }
+
+    // Check if there is room on the field for a creature
+    if (definition.type == CardType::CREATURE && player_state.field.full()) {
+        throw std::runtime_error("Field is full");
+    }
+
+    // Remove card from hand
+    player_state.hand.erase(player_state.hand.begin() + hand_index);
+
+    // Spend mana
+    player_state.mana -= definition.mana_cost;
+
+    // Play the card based on its type
+    if (definition.type == CardType::CREATURE) {
+        // Add creature to field (reset used_this_turn flag for new cards)
+        card_to_play.used_this_turn = false;
+        player_state.field.push_back(card_to_play);
+        battle_state.last_action = player_id + " played " + std::string(definition.name);
+    } else if (definition.type == CardType::SPELL) {
+        // Handle spell effects
+        HandleSpellEffect(battle_state, seat, definition);
+    }
+}
+
+void ApplyAttack(BattleState& battle_state, int attacker_seat, int attacker_index, int target_index) {
+    // Check if it's the attacker's turn (also rejects non-players)
+    if (battle_state.current_seat != attacker_seat) {
+        throw std::runtime_error("Not your turn");
+    }
+
+    auto& attacker_state = battle_state.players[attacker_seat];
+
+    // Check if attacker index is valid
+    if (attacker_index < 0 || attacker_index >= static_cast<int>(attacker_state.field.size())) {
+        throw std::runtime_error("Invalid attacker index");
+    }
+
+    auto& opponent_state = battle_state.players[OpponentSeat(attacker_seat)];
+    const std::string& attacker_id = attacker_state.player_id;
+    const std::string& opponent_id = opponent_state.player_id;
+
+    Card& attacker_card = attacker_state.field[attacker_index];
+
+    // Check if the card has already been used this turn
+    if (attacker_card.used_this_turn) {
+        throw std::runtime_error("Card has already been used this turn");
+    }
+
+    if (target_index >= 0 && target_index < static_cast<int>(opponent_state.field.size())) {
+        // Attack opponent's creature
+        Card& target_card = opponent_state.field[target_index];
+
+        // Apply damage
+        target_card.defense -= attacker_card.attack;
+        attacker_card.defense -= target_card.attack;
+
+        battle_state.last_action = attacker_id + "'s " + std::string(battle_state.catalog->Get(attacker_card.definition).name) + " attacked " +
+                                   opponent_id + "'s " + std::string(battle_state.catalog->Get(target_card.definition).name);
+
+        // Mark the attacker card as used this turn
+        attacker_card.used_this_turn = true;
+
+        // Remove dead creatures (move to the graveyard before erasing the field slot)
+        if (target_card.defense <= 0) {
+            opponent_state.graveyard.push_back(target_card);
+            opponent_state.field.erase(opponent_state.field.begin() + target_index);
+        }
+
+        if (attacker_card.defense <= 0) {
+            attacker_state.graveyard.push_back(attacker_card);
+            attacker_state.field.erase(attacker_state.field.begin() + attacker_index);
+        }
+
+    } else {
+        // Attack opponent directly
+        opponent_state.health -= attacker_card.attack;
+        battle_state.last_action = attacker_id + "'s " + std::string(battle_state.catalog->Get(attacker_card.definition).name) + " attacked " + opponent_id + " directly";
+
+        // Mark the attacker card as used this turn
+        attacker_card.used_this_turn = true;
+
+        // Check for game over
+        if (opponent_state.health <= 0) {
+            EndGame(battle_state, attacker_seat);
+        }
+    }
+}
+
+void ApplyEndTurn(BattleState& battle_state, int seat) {
+
+    // Check if it's the player's turn (also rejects non-players)
+    if (battle_state.current_seat != seat) {
+        throw std::runtime_error("Not your turn");
+    }
+
+    // Switch turns
+    const int next_seat = OpponentSeat(seat);
+    battle_state.current_seat = next_seat;
+    battle_state.turn_number++;
+
+    // Update player states for new turn
+    for (int player_seat = 0; player_seat < 2; ++player_seat) {
+        auto& player_state = battle_state.players[player_seat];
+        player_state.is_active = (player_seat == next_seat);
+
+        // Reset used_this_turn flag for all cards on the field
+        for (auto& card : player_state.field) {
+            card.used_this_turn = false;
+        }
+
+        if (player_state.is_active) {
+            // Increase mana for the active player
+            player_state.max_mana = std::min(10, battle_state.turn_number);
+            player_state.mana = player_state.max_mana;
+
+            // Draw a card
+            DrawCards(battle_state, player_seat, 1);
+        }
+    }
+
+    // Check for deck exhaustion (both players have no cards in deck and hand)
+    bool both_players_exhausted = true;
+    for (const auto& player_state : battle_state.players) {
+        if (!player_state.deck.empty() || !player_state.hand.empty()) {
+            both_players_exhausted = false;
+            break;
+        }
+    }
+
+    if (both_players_exhausted) {
+        // Find the player with more health (the host on a tie)
+        int winner_seat = kHostSeat;
+        if (battle_state.players[kGuestSeat].health > battle_state.players[kHostSeat].health) {
+            winner_seat = kGuestSeat;
+        }
+        int max_health = battle_state.players[winner_seat].health;
+
+        // End the game with the player who has more health as winner
+        EndGame(battle_state, winner_seat);
+        battle_state.last_action = "Game ended by deck exhaustion! " + battle_state.winner + " wins with " + std::to_string(max_health) + " health!";
+    }
+
+    battle_state.last_action = "Turn ended, " + battle_state.CurrentPlayerId() + "'s turn";
+}
+
+void ApplySurrender(BattleState& battle_state, int seat) {
+    if (seat != kHostSeat && seat != kGuestSeat) {
+        throw std::runtime_error("Not a player in this battle");
+    }
+
+    const std::string& player_id = battle_state.players[seat].player_id;
+    const std::string& opponent_id = battle_state.players[OpponentSeat(seat)].player_id;
+
+    // End the game with the opponent as winner
+    EndGame(battle_state, OpponentSeat(seat));
+    battle_state.last_action = "Player " + player_id + " surrendered. " + opponent_id + " wins!";
+}
+
+void EndGame(BattleState& battle_state, int winner_seat) {
+    battle_state.winner = battle_state.players[winner_seat].player_id;
+    battle_state.is_finished = true;
+    battle_state.last_action = "Game over! " + battle_state.winner + " wins!";
+}
+
+void ListLegalActions(const BattleState& battle_state, std::vector<BattleAction>& actions) {
+    actions.clear();
+    if (battle_state.is_finished) return;
+    const int seat = battle_state.current_seat;
+    const auto& player = battle_state.players[seat];
+    const auto& opponent = battle_state.players[OpponentSeat(seat)];
+
+    // The same checks ApplyPlayCard and ApplyAttack make
+    for (int i = 0; i < static_cast<int>(player.hand.size()); ++i) {
+        const CardDefinition definition = battle_state.catalog->Get(player.hand[i].definition);
+        if (player.mana < definition.mana_cost) continue;
+        if (definition.type == CardType::CREATURE && player.field.full()) continue;
+        actions.push_back({BattleAction::Type::PLAY_CARD, i, 0});
+    }
+    for (int i = 0; i < static_cast<int>(player.field.size()); ++i) {
+        if (player.field[i].used_this_turn) continue;
+        for (int target = 0; target < static_cast<int>(opponent.field.size()); ++target) {
+            actions.push_back({BattleAction::Type::ATTACK, i, target});
+        }
+        actions.push_back({BattleAction::Type::ATTACK, i, kNoSeat});
+    }
+    actions.push_back({BattleAction::Type::END_TURN, 0, 0});
+}
+
+void ApplyAction(BattleState& battle_state, const BattleAction& action) {
+    switch (action.type) {
+        case BattleAction::Type::PLAY_CARD:
+            ApplyPlayCard(battle_state, battle_state.current_seat, action.arg0);
+            break;
+        case BattleAction::Type::ATTACK:
+            ApplyAttack(battle_state, battle_state.current_seat, action.arg0, action.arg1);
+            break;
+        case BattleAction::Type::END_TURN:
+            ApplyEndTurn(battle_state, battle_state.current_seat);
+            break;
+    }
+}
+
+} // namespace cardbattle
@@ -0,0 +1,172 @@
+#include "../include/battle_state_codec.hpp"
+#include "../include/byte_io.hpp"
+#include "../include/card_catalog.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace cardbattle {
+
+namespace {
+
+constexpr char kMagic[2] = {'Z', 'B'};
+constexpr std::int64_t kInt16Min = std::numeric_limits<std::int16_t>::min();
+constexpr std::int64_t kInt16Max = std::numeric_limits<std::int16_t>::max();
+
+void WriteU64(ByteWriter& writer, std::uint64_t value) {
+    std::uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i) bytes[i] = static_cast<std::uint8_t>(value >> (8 * i));
+    writer.Bytes(bytes, sizeof(bytes));
+}
+
+std::uint64_t ReadU64(ByteReader& reader) {
+    std::uint8_t bytes[8];
+    reader.Bytes(bytes, sizeof(bytes));
+    std::uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) value |= std::uint64_t{bytes[i]} << (8 * i);
+    return value;
+}
+
+// Position of a definition in the state's table. A battle uses a few dozen
+// distinct cards at most, so a linear scan beats hashing.
+std::size_t TableIndex(const std::vector<std::uint16_t>& definitions, std::uint16_t definition) {
+    return static_cast<std::size_t>(std::find(definitions.begin(), definitions.end(), definition) - definitions.begin());
+}
+
+template <std::size_t Capacity>
+void WriteZone(ByteWriter& writer, const InlineVector<Card, Capacity>& zone, const std::vector<std::uint16_t>& definitions) {
+    writer.Varint(zone.size());
+    for (const auto& card : zone) {
+        // Table index and the used flag share one varint
+        writer.Varint(TableIndex(definitions, card.definition) << 1 | (card.used_this_turn ? 1 : 0));
+        writer.Signed(card.attack);
+        writer.Signed(card.defense);
+    }
+}
+
+template <std::size_t Capacity>
+void ReadZone(ByteReader& reader, InlineVector<Card, Capacity>& zone, const std::vector<std::uint16_t>& definitions) {
+    const auto count = reader.Count(Capacity);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        Card card;
+        const auto entry = reader.Varint();
+        if ((entry >> 1) >= definitions.size()) throw std::runtime_error("Battle state: unknown card");
+        card.definition = definitions[entry >> 1];
+        card.used_this_turn = (entry & 1) != 0;
+        card.attack = static_cast<std::int16_t>(reader.Int(kInt16Min, kInt16Max));
+        card.defense = static_cast<std::int16_t>(reader.Int(kInt16Min, kInt16Max));
+        zone.push_back(card);
+    }
+}
+
+} // namespace
+
+std::string EncodeBattleState(const BattleState& state) {
+    // Card ids used by this state, in first-seen order
+    std::vector<std::uint16_t> definitions;
+    auto collect = [&](const auto& zone) {
+        for (const auto& card : zone) {
+            if (TableIndex(definitions, card.definition) == definitions.size()) definitions.push_back(card.definition);
+        }
+    };
+    for (const auto& player : state.players) {
+        collect(player.hand);
+        collect(player.deck);
+        collect(player.field);
+        collect(player.graveyard);
+    }
+
+    ByteWriter writer;
+    writer.Bytes(kMagic, sizeof(kMagic));
+    writer.U8(kBattleStateCodecVersion);
+
+    writer.String(state.session_id);
+    writer.Varint(state.version);
+    writer.U8(static_cast<std::uint8_t>(state.current_seat));
+    writer.Signed(state.turn_number);
+    writer.String(state.winner);
+    writer.U8(state.is_finished ? 1 : 0);
+    writer.String(state.last_action);
+    WriteU64(writer, state.seed);
+    for (int i = 0; i < 4; ++i) WriteU64(writer, state.rng.State()[i]);
+
+    writer.Varint(definitions.size());
+    for (auto definition : definitions) writer.String(state.catalog->Get(definition).id);
+
+    for (const auto& player : state.players) {
+        writer.String(player.player_id);
+        writer.Signed(player.health);
+        writer.Signed(player.max_health);
+        writer.Signed(player.mana);
+        writer.Signed(player.max_mana);
+        writer.U8(player.is_active ? 1 : 0);
+        WriteZone(writer, player.hand, definitions);
+        WriteZone(writer, player.deck, definitions);
+        WriteZone(writer, player.field, definitions);
+        WriteZone(writer, player.graveyard, definitions);
+    }
+    return writer.Finish();
+}
+
+BattleState DecodeBattleState(std::string_view data, std::shared_ptr<const CardCatalog> catalog) {
+    ByteReader reader(data, "Battle state");
+    char magic[sizeof(kMagic)];
+    reader.Bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Battle state: not an encoded battle state");
+    }
+    const auto format_version = reader.U8();
+    if (format_version != kBattleStateCodecVersion) {
+        throw std::runtime_error("Battle state: unsupported format version " + std::to_string(format_version));
+    }
+
+    constexpr std::int64_t kIntMin = std::numeric_limits<int>::min();
+    constexpr std::int64_t kIntMax = std::numeric_limits<int>::max();
+
+    BattleState state;
+    state.session_id = reader.String();
+    state.version = reader.Varint();
+    state.current_seat = reader.U8();
+    if (state.current_seat != kHostSeat && state.current_seat != kGuestSeat) {
+        throw std::runtime_error("Battle state: invalid current seat");
+    }
+    state.turn_number = static_cast<int>(reader.Int(kIntMin, kIntMax));
+    state.winner = reader.String();
+    state.is_finished = reader.U8() != 0;
+    state.last_action = reader.String();
+    state.seed = ReadU64(reader);
+    std::uint64_t rng_state[4];
+    for (auto& word : rng_state) word = ReadU64(reader);
+    state.rng.SetState(rng_state);
+
+    const auto definition_count = reader.Count(std::numeric_limits<std::uint16_t>::max());
+    std::vector<std::uint16_t> definitions;
+    definitions.reserve(definition_count);
+    for (std::uint64_t i = 0; i < definition_count; ++i) {
+        auto id = reader.String();
+        auto index = catalog->Find(id);
+        if (!index) throw std::runtime_error("Battle state: card not in catalog: " + std::string(id));
+        definitions.push_back(*index);
+    }
+
+    for (auto& player : state.players) {
+        player.player_id = reader.String();
+        player.health = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.max_health = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.mana = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.max_mana = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.is_active = reader.U8() != 0;
+        ReadZone(reader, player.hand, definitions);
+        ReadZone(reader, player.deck, definitions);
+        ReadZone(reader, player.field, definitions);
+        ReadZone(reader, player.graveyard, definitions);
+    }
+    if (!reader.AtEnd()) throw std::runtime_error("Battle state: trailing bytes");
+
+    state.catalog = std::move(catalog);
+    return state;
+}
+
+} // namespace cardbattle
@@ -0,0 +1,377 @@
+#include "../include/battle_wire.hpp"
+#include "../include/byte_io.hpp"
+#include "../include/card_catalog.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace cardbattle {
+
+namespace {
+
+constexpr const char* kWhat = "Battle wire";
+constexpr std::int64_t kIntMin = std::numeric_limits<int>::min();
+constexpr std::int64_t kIntMax = std::numeric_limits<int>::max();
+
+// Bits of the delta's turn mask, then of each changed player's field mask;
+// fields follow in bit order
+enum TurnField : std::uint8_t {
+    kCurrentTurn = 1 << 0,
+    kTurnNumber = 1 << 1,
+    kIsFinished = 1 << 2,
+    kWinner = 1 << 3,
+    kLastAction = 1 << 4,
+};
+
+enum PlayerField : std::uint16_t {
+    kHealth = 1 << 0,
+    kMaxHealth = 1 << 1,
+    kMana = 1 << 2,
+    kMaxMana = 1 << 3,
+    kIsActive = 1 << 4,
+    kHand = 1 << 5,
+    kField = 1 << 6,
+    kDeck = 1 << 7,
+    kGraveyard = 1 << 8,
+};
+
+// Bits of JOIN_SESSION's flags byte
+enum JoinFlag : std::uint8_t {
+    kJoinDeltaUpdates = 1 << 0,
+    kJoinDeflate = 1 << 1,
+};
+
+// Only what clients see of a card
+bool SameCard(const Card& a, const Card& b) {
+    return a.definition == b.definition && a.attack == b.attack && a.defense == b.defense;
+}
+
+// Distinct definitions of the cards a message carries, in first-seen order.
+// A message has a few dozen at most, so a linear scan beats hashing.
+class CardTable {
+public:
+    std::size_t Index(std::uint16_t definition) {
+        const auto it = std::find(definitions_.begin(), definitions_.end(), definition);
+        if (it != definitions_.end()) return static_cast<std::size_t>(it - definitions_.begin());
+        definitions_.push_back(definition);
+        return definitions_.size() - 1;
+    }
+
+    void Write(ByteWriter& writer, const CardCatalog& catalog) const {
+        writer.Varint(definitions_.size());
+        for (const auto definition : definitions_) {
+            const CardDefinition card = catalog.Get(definition);
+            writer.String(card.id);
+            writer.String(card.name);
+            writer.Signed(card.mana_cost);
+            writer.Signed(static_cast<int>(card.type));
+        }
+    }
+
+private:
+    std::vector<std::uint16_t> definitions_;
+};
+
+void WriteCard(ByteWriter& writer, CardTable& table, const Card& card) {
+    writer.Varint(table.Index(card.definition));
+    writer.Signed(card.attack);
+    writer.Signed(card.defense);
+}
+
+template <typename Zone>
+void WriteZone(ByteWriter& writer, CardTable& table, const Zone& zone) {
+    writer.Varint(zone.size());
+    for (const auto& card : zone) WriteCard(writer, table, card);
+}
+
+// New size, then the cards that differ from `before` at the same index
+template <typename Zone>
+void WriteZoneDelta(ByteWriter& writer, CardTable& table, const Zone& before, const Zone& after) {
+    writer.Varint(after.size());
+    std::size_t changed = 0;
+    for (std::size_t i = 0; i < after.size(); ++i) {
+        if (i >= before.size() || !SameCard(before[i], after[i])) ++changed;
+    }
+    writer.Varint(changed);
+    for (std::size_t i = 0; i < after.size(); ++i) {
+        if (i < before.size() && SameCard(before[i], after[i])) continue;
+        writer.Varint(i);
+        WriteCard(writer, table, after[i]);
+    }
+}
+
+template <typename Zone>
+bool ZoneChanged(const Zone& before, const Zone& after) {
+    if (before.size() != after.size()) return true;
+    for (std::size_t i = 0; i < after.size(); ++i) {
+        if (!SameCard(before[i], after[i])) return true;
+    }
+    return false;
+}
+
+// The table goes first so a client can resolve cards as it reads them, but
+// it is only known once the body is written
+std::string Assemble(ByteWriter& header, const CardTable& table, const CardCatalog& catalog, ByteWriter& body) {
+    table.Write(header, catalog);
+    const std::string body_bytes = body.Finish();
+    header.Bytes(body_bytes.data(), body_bytes.size());
+    return header.Finish();
+}
+
+std::vector<WireCard> ReadCardTable(ByteReader& reader) {
+    std::vector<WireCard> table(reader.Count(std::numeric_limits<std::uint16_t>::max()));
+    for (auto& card : table) {
+        card.id = reader.String();
+        card.name = reader.String();
+        card.mana_cost = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        card.type = static_cast<int>(reader.Int(kIntMin, kIntMax));
+    }
+    return table;
+}
+
+WireCard ReadCard(ByteReader& reader, const std::vector<WireCard>& table) {
+    const auto index = reader.Varint();
+    if (index >= table.size()) reader.Fail("unknown card");
+    WireCard card = table[index];
+    card.attack = static_cast<int>(reader.Int(kIntMin, kIntMax));
+    card.defense = static_cast<int>(reader.Int(kIntMin, kIntMax));
+    return card;
+}
+
+void ReadZone(ByteReader& reader, const std::vector<WireCard>& table, std::vector<WireCard>& zone,
+              std::size_t capacity) {
+    zone.resize(reader.Count(capacity));
+    for (auto& card : zone) card = ReadCard(reader, table);
+}
+
+void ReadZoneDelta(ByteReader& reader, const std::vector<WireCard>& table, std::vector<WireCard>& zone,
+                   std::size_t capacity) {
+    const auto size = reader.Count(capacity);
+    const auto grown = zone.size();
+    zone.resize(size);
+    const auto changed = reader.Count(size);
+    std::uint64_t sent = 0;  // Zones hold fewer than 64 cards
+    for (std::uint64_t i = 0; i < changed; ++i) {
+        const auto index = reader.Count(size - 1);
+        zone[index] = ReadCard(reader, table);
+        sent |= std::uint64_t{1} << index;
+    }
+    // Every new slot must have been sent
+    for (auto i = grown; i < size; ++i) {
+        if (!(sent & (std::uint64_t{1} << i))) reader.Fail("zone grew without its cards");
+    }
+}
+
+void ExpectType(ByteReader& reader, WireMessageType type) {
+    if (reader.U8() != static_cast<std::uint8_t>(type)) reader.Fail("unexpected message type");
+}
+
+} // namespace
+
+std::string EncodeWireState(const BattleState& state) {
+    const CardCatalog& catalog = *state.catalog;
+    CardTable table;
+    ByteWriter body;
+    for (const auto& player : state.players) {
+        body.String(player.player_id);
+        body.Signed(player.health);
+        body.Signed(player.max_health);
+        body.Signed(player.mana);
+        body.Signed(player.max_mana);
+        body.U8(player.is_active ? 1 : 0);
+        WriteZone(body, table, player.hand);
+        WriteZone(body, table, player.field);
+        body.Varint(player.deck.size());
+        WriteZone(body, table, player.graveyard);
+    }
+
+    ByteWriter header(128);
+    header.U8(static_cast<std::uint8_t>(WireMessageType::STATE));
+    header.Varint(state.version);
+    header.String(state.session_id);
+    header.String(state.CurrentPlayerId());
+    header.Signed(state.turn_number);
+    header.U8(state.is_finished ? 1 : 0);
+    header.String(state.winner);
+    header.String(state.last_action);
+    return Assemble(header, table, catalog, body);
+}
+
+std::string EncodeWireDelta(const BattleState& before, const BattleState& after) {
+    const CardCatalog& catalog = *after.catalog;
+    CardTable table;
+    ByteWriter body(128);
+
+    std::uint8_t turn_mask = 0;
+    if (before.current_seat != after.current_seat) turn_mask |= kCurrentTurn;
+    if (before.turn_number != after.turn_number) turn_mask |= kTurnNumber;
+    if (before.is_finished != after.is_finished) turn_mask |= kIsFinished;
+    if (before.winner != after.winner) turn_mask |= kWinner;
+    if (before.last_action != after.last_action) turn_mask |= kLastAction;
+
+    std::uint16_t player_masks[2] = {0, 0};
+    for (int seat = 0; seat < 2; ++seat) {
+        const PlayerState& old_player = before.players[seat];
+        const PlayerState& player = after.players[seat];
+        std::uint16_t& mask = player_masks[seat];
+        if (old_player.health != player.health) mask |= kHealth;
+        if (old_player.max_health != player.max_health) mask |= kMaxHealth;
+        if (old_player.mana != player.mana) mask |= kMana;
+        if (old_player.max_mana != player.max_mana) mask |= kMaxMana;
+        if (old_player.is_active != player.is_active) mask |= kIsActive;
+        if (ZoneChanged(old_player.hand, player.hand)) mask |= kHand;
+        if (ZoneChanged(old_player.field, player.field)) mask |= kField;
+        if (old_player.deck.size() != player.deck.size()) mask |= kDeck;
+        if (ZoneChanged(old_player.graveyard, player.graveyard)) mask |= kGraveyard;
+    }
+
+    body.U8(static_cast<std::uint8_t>((player_masks[0] ? 1 : 0) | (player_masks[1] ? 2 : 0)));
+    for (int seat = 0; seat < 2; ++seat) {
+        const std::uint16_t mask = player_masks[seat];
+        if (!mask) continue;
+        const PlayerState& old_player = before.players[seat];
+        const PlayerState& player = after.players[seat];
+        body.Varint(mask);
+        if (mask & kHealth) body.Signed(player.health);
+        if (mask & kMaxHealth) body.Signed(player.max_health);
+        if (mask & kMana) body.Signed(player.mana);
+        if (mask & kMaxMana) body.Signed(player.max_mana);
+        if (mask & kIsActive) body.U8(player.is_active ? 1 : 0);
+        if (mask & kHand) WriteZoneDelta(body, table, old_player.hand, player.hand);
+        if (mask & kField) WriteZoneDelta(body, table, old_player.field, player.field);
+        if (mask & kDeck) body.Varint(player.deck.size());
+        if (mask & kGraveyard) WriteZoneDelta(body, table, old_player.graveyard, player.graveyard);
+    }
+
+    ByteWriter header(128);
+    header.U8(static_cast<std::uint8_t>(WireMessageType::DELTA));
+    header.Varint(before.version);
+    header.Varint(after.version);
+    header.U8(turn_mask);
+    if (turn_mask & kCurrentTurn) header.String(after.CurrentPlayerId());
+    if (turn_mask & kTurnNumber) header.Signed(after.turn_number);
+    if (turn_mask & kIsFinished) header.U8(after.is_finished ? 1 : 0);
+    if (turn_mask & kWinner) header.String(after.winner);
+    if (turn_mask & kLastAction) header.String(after.last_action);
+    return Assemble(header, table, catalog, body);
+}
+
+WireBattleState DecodeWireState(std::string_view data) {
+    ByteReader reader(data, kWhat);
+    ExpectType(reader, WireMessageType::STATE);
+    WireBattleState state;
+    state.version = reader.Varint();
+    state.session_id = reader.String();
+    state.current_turn = reader.String();
+    state.turn_number = static_cast<int>(reader.Int(kIntMin, kIntMax));
+    state.is_finished = reader.U8() != 0;
+    state.winner = reader.String();
+    state.last_action = reader.String();
+    const auto table = ReadCardTable(reader);
+    for (auto& player : state.players) {
+        player.player_id = reader.String();
+        player.health = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.max_health = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.mana = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.max_mana = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        player.is_active = reader.U8() != 0;
+        ReadZone(reader, table, player.hand, kMaxHandSize);
+        ReadZone(reader, table, player.field, kMaxFieldSize);
+        player.deck_count = static_cast<int>(reader.Count(kMaxDeckSize));
+        ReadZone(reader, table, player.graveyard, kMaxGraveyardSize);
+    }
+    if (!reader.AtEnd()) reader.Fail("trailing bytes");
+    return state;
+}
+
+void ApplyWireDelta(WireBattleState& state, std::string_view data) {
+    ByteReader reader(data, kWhat);
+    ExpectType(reader, WireMessageType::DELTA);
+    if (reader.Varint() != state.version) throw std::runtime_error("Battle wire: delta is not for this version");
+    // Applied to a copy, so a bad delta leaves the state as it was
+    WireBattleState next = state;
+    next.version = reader.Varint();
+    const auto turn_mask = reader.U8();
+    if (turn_mask & kCurrentTurn) next.current_turn = reader.String();
+    if (turn_mask & kTurnNumber) next.turn_number = static_cast<int>(reader.Int(kIntMin, kIntMax));
+    if (turn_mask & kIsFinished) next.is_finished = reader.U8() != 0;
+    if (turn_mask & kWinner) next.winner = reader.String();
+    if (turn_mask & kLastAction) next.last_action = reader.String();
+    const auto table = ReadCardTable(reader);
+    const auto seats = reader.U8();
+    for (int seat = 0; seat < 2; ++seat) {
+        if (!(seats & (1 << seat))) continue;
+        WirePlayer& player = next.players[seat];
+        const auto mask = reader.Varint();
+        if (mask & kHealth) player.health = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        if (mask & kMaxHealth) player.max_health = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        if (mask & kMana) player.mana = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        if (mask & kMaxMana) player.max_mana = static_cast<int>(reader.Int(kIntMin, kIntMax));
+        if (mask & kIsActive) player.is_active = reader.U8() != 0;
+        if (mask & kHand) ReadZoneDelta(reader, table, player.hand, kMaxHandSize);
+        if (mask & kField) ReadZoneDelta(reader, table, player.field, kMaxFieldSize);
+        if (mask & kDeck) player.deck_count = static_cast<int>(reader.Count(kMaxDeckSize));
+        if (mask & kGraveyard) ReadZoneDelta(reader, table, player.graveyard, kMaxGraveyardSize);
+    }
+    if (!reader.AtEnd()) reader.Fail("trailing bytes");
+    state = std::move(next);
+}
+
+std::string EncodeClientAction(const ClientAction& action) {
+    ByteWriter writer(64);
+    writer.U8(static_cast<std::uint8_t>(WireMessageType::ACTION));
+    writer.U8(static_cast<std::uint8_t>(action.type));
+    switch (action.type) {
+        case ClientAction::Type::JOIN_SESSION:
+            writer.String(action.session_id);
+            writer.String(action.user_id);
+            writer.U8((action.delta_updates ? kJoinDeltaUpdates : 0) | (action.deflate ? kJoinDeflate : 0));
+            break;
+        case ClientAction::Type::PLAY_CARD:
+            writer.Signed(action.hand_index);
+            break;
+        case ClientAction::Type::ATTACK:
+            writer.Signed(action.attacker_index);
+            writer.Signed(action.target_index);
+            break;
+        default:
+            break;
+    }
+    return writer.Finish();
+}
+
+ClientAction DecodeClientAction(std::string_view data) {
+    ByteReader reader(data, kWhat);
+    ExpectType(reader, WireMessageType::ACTION);
+    ClientAction action;
+    action.type = static_cast<ClientAction::Type>(reader.U8());
+    switch (action.type) {
+        case ClientAction::Type::JOIN_SESSION: {
+            action.session_id = reader.String();
+            action.user_id = reader.String();
+            const std::uint8_t flags = reader.U8();
+            if (flags & ~(kJoinDeltaUpdates | kJoinDeflate)) reader.Fail("unknown join flags");
+            action.delta_updates = flags & kJoinDeltaUpdates;
+            action.deflate = flags & kJoinDeflate;
+            break;
+        }
+        case ClientAction::Type::PLAY_CARD:
+            action.hand_index = static_cast<int>(reader.Int(kIntMin, kIntMax));
+            break;
+        case ClientAction::Type::ATTACK:
+            action.attacker_index = static_cast<int>(reader.Int(kIntMin, kIntMax));
+            action.target_index = static_cast<int>(reader.Int(kIntMin, kIntMax));
+            break;
+        case ClientAction::Type::END_TURN:
+        case ClientAction::Type::SURRENDER:
+        case ClientAction::Type::GET_BATTLE_STATE:
+        case ClientAction::Type::RESYNC:
+            break;
+        default:
+            reader.Fail("unknown action");
+    }
+    if (!reader.AtEnd()) reader.Fail("trailing bytes");
+    return action;
+}
+
+} // namespace cardbattle
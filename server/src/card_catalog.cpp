@@ -0,0 +1,391 @@
+#include "../include/card_catalog.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cardbattle {
+
+namespace {
+
+// Image layout: Header, then card_count Records, then index_slots uint32
+// index slots, then the string table. All integers are native-endian; the
+// byte-order field rejects images built on a machine with the other order.
+constexpr char kMagic[8] = {'Z', 'Z', 'C', 'B', 'C', 'A', 'T', '\0'};
+constexpr std::uint32_t kFormatVersion = 1;
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+constexpr std::uint32_t kEmptySlot = std::numeric_limits<std::uint32_t>::max();
+
+struct Header {
+    char magic[8];
+    std::uint32_t format_version;
+    std::uint32_t byte_order;
+    std::uint32_t card_count;
+    std::uint32_t index_slots;  // Power of two, at least twice card_count
+    std::uint32_t records_offset;
+    std::uint32_t index_offset;
+    std::uint32_t strings_offset;
+    std::uint32_t strings_size;
+};
+static_assert(sizeof(Header) == 40);
+
+// FNV-1a, stable across builds so the on-disk index stays valid
+std::uint64_t HashId(std::string_view id) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : id) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::uint32_t IndexSlotsFor(std::size_t card_count) {
+    std::uint32_t slots = 8;
+    while (slots < card_count * 2) slots *= 2;
+    return slots;
+}
+
+std::vector<std::string> Split(const std::string& text, char delimiter) {
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream stream(text);
+    while (std::getline(stream, part, delimiter)) parts.push_back(part);
+    if (!text.empty() && text.back() == delimiter) parts.emplace_back();
+    return parts;
+}
+
+std::string Trim(const std::string& text) {
+    auto begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    auto end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+int ParseInt(const std::string& text, int min, int max, const std::string& where) {
+    std::size_t consumed = 0;
+    int value = 0;
+    try {
+        value = std::stoi(text, &consumed);
+    } catch (const std::exception&) {
+        consumed = 0;
+    }
+    if (consumed == 0 || consumed != text.size() || value < min || value > max) {
+        throw std::runtime_error(where + ": invalid number '" + text + "'");
+    }
+    return value;
+}
+
+EffectOp ParseEffectOp(const std::string& text, const std::string& where) {
+    if (text == "damage") return EffectOp::DAMAGE;
+    if (text == "heal") return EffectOp::HEAL;
+    if (text == "buff_attack") return EffectOp::BUFF_ATTACK;
+    if (text == "buff_defense") return EffectOp::BUFF_DEFENSE;
+    if (text == "draw") return EffectOp::DRAW;
+    throw std::runtime_error(where + ": unknown effect '" + text + "'");
+}
+
+EffectTarget ParseEffectTarget(const std::string& text, const std::string& where) {
+    if (text == "self") return EffectTarget::SELF;
+    if (text == "opponent") return EffectTarget::OPPONENT;
+    if (text == "own_field") return EffectTarget::OWN_FIELD;
+    if (text == "opponent_field") return EffectTarget::OPPONENT_FIELD;
+    throw std::runtime_error(where + ": unknown effect target '" + text + "'");
+}
+
+} // namespace
+
+struct CardCatalog::Record {
+    std::uint32_t id_offset;  // Offsets into the string table
+    std::uint32_t name_offset;
+    std::uint32_t description_offset;
+    std::uint16_t id_length;
+    std::uint16_t name_length;
+    std::uint16_t description_length;
+    std::int16_t attack;
+    std::int16_t defense;
+    std::int16_t mana_cost;
+    std::uint8_t type;
+    std::uint8_t effect_count;
+    CardEffect effects[kMaxCardEffects];
+};
+static_assert(sizeof(CardEffect) == 4);
+
+std::vector<CardSpec> CardCatalog::ParseText(std::istream& input, const std::string& source_name) {
+    std::vector<CardSpec> cards;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(input, line)) {
+        ++line_number;
+        std::string trimmed = Trim(line);
+        if (trimmed.empty() || trimmed[0] == '#') continue;
+
+        const std::string where = source_name + ":" + std::to_string(line_number);
+        auto fields = Split(trimmed, '|');
+        if (fields.size() != 8) {
+            throw std::runtime_error(where + ": expected 8 '|'-separated fields, got " + std::to_string(fields.size()));
+        }
+        for (auto& field : fields) field = Trim(field);
+
+        CardSpec card;
+        card.id = fields[0];
+        card.name = fields[1];
+        card.description = fields[2];
+        if (card.id.empty()) throw std::runtime_error(where + ": empty card id");
+        card.attack = ParseInt(fields[3], 0, std::numeric_limits<std::int16_t>::max(), where);
+        card.defense = ParseInt(fields[4], 0, std::numeric_limits<std::int16_t>::max(), where);
+        card.mana_cost = ParseInt(fields[5], 0, std::numeric_limits<std::int16_t>::max(), where);
+        if (fields[6] == "creature") {
+            card.type = CardType::CREATURE;
+        } else if (fields[6] == "spell") {
+            card.type = CardType::SPELL;
+        } else {
+            throw std::runtime_error(where + ": unknown card type '" + fields[6] + "'");
+        }
+
+        if (!fields[7].empty()) {
+            for (const auto& effect_text : Split(fields[7], ',')) {
+                auto parts = Split(Trim(effect_text), ':');
+                if (parts.size() != 3) {
+                    throw std::runtime_error(where + ": effect must be op:target:amount, got '" + effect_text + "'");
+                }
+                if (card.effects.full()) {
+                    throw std::runtime_error(where + ": too many effects (max " + std::to_string(kMaxCardEffects) + ")");
+                }
+                CardEffect effect;
+                effect.op = ParseEffectOp(parts[0], where);
+                effect.target = ParseEffectTarget(parts[1], where);
+                effect.amount = static_cast<std::int16_t>(
+                    ParseInt(parts[2], 0, std::numeric_limits<std::int16_t>::max(), where));
+                card.effects.push_back(effect);
+            }
+        }
+        cards.push_back(std::move(card));
+    }
+    return cards;
+}
+
+std::string CardCatalog::Compile(const std::vector<CardSpec>& cards) {
+    if (cards.size() > std::numeric_limits<std::uint16_t>::max()) {
+        throw std::runtime_error("Card catalog is full");
+    }
+
+    const auto card_count = static_cast<std::uint32_t>(cards.size());
+    const std::uint32_t index_slots = IndexSlotsFor(cards.size());
+    std::vector<std::uint32_t> index(index_slots, kEmptySlot);
+    std::vector<Record> records(card_count);
+    std::string strings;
+
+    auto add_string = [&strings](const std::string& text, std::uint32_t& offset, std::uint16_t& length) {
+        if (text.size() > std::numeric_limits<std::uint16_t>::max()) {
+            throw std::runtime_error("Card text too long: " + text.substr(0, 32) + "...");
+        }
+        offset = static_cast<std::uint32_t>(strings.size());
+        length = static_cast<std::uint16_t>(text.size());
+        strings += text;
+    };
+
+    for (std::uint32_t i = 0; i < card_count; ++i) {
+        const auto& card = cards[i];
+        auto slot = HashId(card.id) & (index_slots - 1);
+        while (index[slot] != kEmptySlot) {
+            if (cards[index[slot]].id == card.id) {
+                throw std::runtime_error("Duplicate card id: " + card.id);
+            }
+            slot = (slot + 1) & (index_slots - 1);
+        }
+        index[slot] = i;
+
+        Record& record = records[i];
+        std::memset(&record, 0, sizeof(record));
+        add_string(card.id, record.id_offset, record.id_length);
+        add_string(card.name, record.name_offset, record.name_length);
+        add_string(card.description, record.description_offset, record.description_length);
+        record.attack = static_cast<std::int16_t>(card.attack);
+        record.defense = static_cast<std::int16_t>(card.defense);
+        record.mana_cost = static_cast<std::int16_t>(card.mana_cost);
+        record.type = static_cast<std::uint8_t>(card.type);
+        record.effect_count = static_cast<std::uint8_t>(card.effects.size());
+        for (std::size_t e = 0; e < card.effects.size(); ++e) record.effects[e] = card.effects[e];
+    }
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.format_version = kFormatVersion;
+    header.byte_order = kByteOrderMark;
+    header.card_count = card_count;
+    header.index_slots = index_slots;
+    header.records_offset = sizeof(Header);
+    header.index_offset = header.records_offset + card_count * sizeof(Record);
+    header.strings_offset = header.index_offset + index_slots * sizeof(std::uint32_t);
+    header.strings_size = static_cast<std::uint32_t>(strings.size());
+
+    std::string image;
+    image.reserve(header.strings_offset + strings.size());
+    image.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    image.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+    image.append(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(std::uint32_t));
+    image += strings;
+    return image;
+}
+
+std::shared_ptr<const CardCatalog> CardCatalog::Load(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open card catalog " + path + ": " + std::strerror(errno));
+    }
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat card catalog " + path + ": " + std::strerror(errno));
+    }
+    const auto size = static_cast<std::size_t>(file_stat.st_size);
+    if (size < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("Card catalog " + path + " is truncated");
+    }
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map card catalog " + path + ": " + std::strerror(errno));
+    }
+
+    std::shared_ptr<CardCatalog> catalog(new CardCatalog());
+    catalog->source_name_ = path;
+    catalog->mapping_ = mapping;
+    catalog->data_ = static_cast<const char*>(mapping);
+    catalog->size_ = size;
+    catalog->Validate();
+    return catalog;
+}
+
+std::shared_ptr<const CardCatalog> CardCatalog::FromImage(std::string image, std::string source_name) {
+    std::shared_ptr<CardCatalog> catalog(new CardCatalog());
+    catalog->source_name_ = std::move(source_name);
+    catalog->owned_image_ = std::move(image);
+    catalog->data_ = catalog->owned_image_.data();
+    catalog->size_ = catalog->owned_image_.size();
+    catalog->Validate();
+    return catalog;
+}
+
+CardCatalog::~CardCatalog() {
+    if (mapping_) ::munmap(mapping_, size_);
+}
+
+// Checks every offset once so lookups can trust the image afterwards
+void CardCatalog::Validate() {
+    static_assert(sizeof(Record) == 44, "Record layout is part of the file format");
+    const std::string where = "Card catalog " + source_name_;
+    if (size_ < sizeof(Header)) throw std::runtime_error(where + " is truncated");
+
+    Header header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error(where + " is not a compiled card catalog");
+    }
+    if (header.format_version != kFormatVersion) {
+        throw std::runtime_error(where + " has unsupported format version " + std::to_string(header.format_version));
+    }
+    if (header.byte_order != kByteOrderMark) {
+        throw std::runtime_error(where + " was compiled for a different byte order");
+    }
+    if (header.card_count > std::numeric_limits<std::uint16_t>::max() ||
+        header.index_slots < header.card_count * 2 || (header.index_slots & (header.index_slots - 1)) != 0) {
+        throw std::runtime_error(where + " has a malformed header");
+    }
+    const std::uint64_t records_end =
+        std::uint64_t{header.records_offset} + std::uint64_t{header.card_count} * sizeof(Record);
+    const std::uint64_t index_end =
+        std::uint64_t{header.index_offset} + std::uint64_t{header.index_slots} * sizeof(std::uint32_t);
+    const std::uint64_t strings_end = std::uint64_t{header.strings_offset} + header.strings_size;
+    if (header.records_offset % alignof(Record) != 0 || header.index_offset % alignof(std::uint32_t) != 0 ||
+        records_end > header.index_offset || index_end > header.strings_offset || strings_end > size_) {
+        throw std::runtime_error(where + " has sections out of bounds");
+    }
+
+    card_count_ = header.card_count;
+    index_slots_ = header.index_slots;
+    records_ = reinterpret_cast<const Record*>(data_ + header.records_offset);
+    index_ = reinterpret_cast<const std::uint32_t*>(data_ + header.index_offset);
+    strings_ = data_ + header.strings_offset;
+    strings_size_ = header.strings_size;
+
+    for (std::uint32_t i = 0; i < card_count_; ++i) {
+        const Record& record = records_[i];
+        auto in_strings = [this](std::uint32_t offset, std::uint16_t length) {
+            return std::uint64_t{offset} + length <= strings_size_;
+        };
+        if (!in_strings(record.id_offset, record.id_length) || !in_strings(record.name_offset, record.name_length) ||
+            !in_strings(record.description_offset, record.description_length) ||
+            record.type > static_cast<std::uint8_t>(CardType::SPELL) || record.effect_count > kMaxCardEffects) {
+            throw std::runtime_error(where + " has a malformed card record " + std::to_string(i));
+        }
+        // The rules assume known ops and targets; an unknown one would
+        // silently act as something else or not at all
+        for (std::uint8_t e = 0; e < record.effect_count; ++e) {
+            const CardEffect& effect = record.effects[e];
+            if (static_cast<std::uint8_t>(effect.op) > static_cast<std::uint8_t>(EffectOp::DRAW) ||
+                static_cast<std::uint8_t>(effect.target) > static_cast<std::uint8_t>(EffectTarget::OPPONENT_FIELD)) {
+                throw std::runtime_error(where + " has a malformed effect in card record " + std::to_string(i));
+            }
+        }
+    }
+    for (std::uint32_t slot = 0; slot < index_slots_; ++slot) {
+        if (index_[slot] != kEmptySlot && index_[slot] >= card_count_) {
+            throw std::runtime_error(where + " has a malformed id index");
+        }
+    }
+}
+
+const CardCatalog::Record& CardCatalog::GetRecord(std::uint16_t index) const {
+    if (index >= card_count_) {
+        throw std::runtime_error("Card index out of range: " + std::to_string(index));
+    }
+    return records_[index];
+}
+
+std::string_view CardCatalog::GetString(std::uint32_t offset, std::uint16_t length) const {
+    return std::string_view(strings_ + offset, length);
+}
+
+CardDefinition CardCatalog::Get(std::uint16_t index) const {
+    const Record& record = GetRecord(index);
+    CardDefinition definition;
+    definition.id = GetString(record.id_offset, record.id_length);
+    definition.name = GetString(record.name_offset, record.name_length);
+    definition.description = GetString(record.description_offset, record.description_length);
+    definition.attack = record.attack;
+    definition.defense = record.defense;
+    definition.mana_cost = record.mana_cost;
+    definition.type = static_cast<CardType>(record.type);
+    for (std::uint8_t e = 0; e < record.effect_count; ++e) definition.effects.push_back(record.effects[e]);
+    return definition;
+}
+
+std::optional<std::uint16_t> CardCatalog::Find(std::string_view id) const {
+    auto slot = HashId(id) & (index_slots_ - 1);
+    while (index_[slot] != kEmptySlot) {
+        const Record& record = records_[index_[slot]];
+        if (GetString(record.id_offset, record.id_length) == id) {
+            return static_cast<std::uint16_t>(index_[slot]);
+        }
+        slot = (slot + 1) & (index_slots_ - 1);
+    }
+    return std::nullopt;
+}
+
+Card CardCatalog::Instantiate(std::uint16_t index) const {
+    const Record& record = GetRecord(index);
+    Card card;
+    card.definition = index;
+    card.attack = record.attack;
+    card.defense = record.defense;
+    return card;
+}
+
+} // namespace cardbattle
@@ -0,0 +1,105 @@
+#include "../include/frame_deflate.hpp"
+#include "../include/battle_wire.hpp"
+#include <stdexcept>
+#include <zlib.h>
+
+namespace cardbattle {
+
+namespace {
+
+// Raw deflate (no zlib header), the largest window
+constexpr int kWindowBits = -15;
+constexpr std::size_t kChunk = 4096;
+// What Z_SYNC_FLUSH ends a message with; stripped on the wire
+constexpr char kFlushTail[] = {'\x00', '\x00', '\xff', '\xff'};
+
+} // namespace
+
+struct FrameDeflater::Stream {
+    z_stream z{};
+};
+
+FrameDeflater::FrameDeflater(int level, bool context_takeover)
+    : stream_(std::make_unique<Stream>()), context_takeover_(context_takeover) {
+    if (deflateInit2(&stream_->z, level, Z_DEFLATED, kWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("Frame deflate: cannot initialize zlib");
+    }
+}
+
+FrameDeflater::~FrameDeflater() {
+    deflateEnd(&stream_->z);
+}
+
+std::string FrameDeflater::Deflate(std::string_view message) {
+    z_stream& z = stream_->z;
+    if (!context_takeover_) deflateReset(&z);
+    std::string frame(1 + deflateBound(&z, message.size()) + 16, '\0');
+    frame[0] = static_cast<char>(WireMessageType::DEFLATED);
+    std::size_t size = 1;
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.data()));
+    z.avail_in = static_cast<uInt>(message.size());
+    // A sync flush emits everything and ends on a byte boundary. The bound
+    // leaves out what context takeover holds back, so it may take more room.
+    while (true) {
+        z.next_out = reinterpret_cast<Bytef*>(frame.data() + size);
+        z.avail_out = static_cast<uInt>(frame.size() - size);
+        if (deflate(&z, Z_SYNC_FLUSH) == Z_STREAM_ERROR) throw std::runtime_error("Frame deflate: zlib error");
+        size = frame.size() - z.avail_out;
+        if (z.avail_out != 0) break;
+        frame.resize(frame.size() + kChunk);
+    }
+    if (size == 1) {
+        // Nothing new to flush (an empty message with context takeover):
+        // an empty stored block, as RFC 7692 sends it
+        frame[size++] = '\0';
+    } else {
+        size -= sizeof(kFlushTail);
+    }
+    frame.resize(size);
+    return frame;
+}
+
+struct FrameInflater::Stream {
+    z_stream z{};
+};
+
+FrameInflater::FrameInflater(bool context_takeover)
+    : stream_(std::make_unique<Stream>()), context_takeover_(context_takeover) {
+    if (inflateInit2(&stream_->z, kWindowBits) != Z_OK) {
+        throw std::runtime_error("Frame inflate: cannot initialize zlib");
+    }
+}
+
+FrameInflater::~FrameInflater() {
+    inflateEnd(&stream_->z);
+}
+
+std::string FrameInflater::Inflate(std::string_view frame) {
+    if (frame.empty() || frame[0] != static_cast<char>(WireMessageType::DEFLATED)) {
+        throw std::runtime_error("Frame inflate: not a deflated frame");
+    }
+    z_stream& z = stream_->z;
+    if (!context_takeover_) inflateReset(&z);
+    std::string input(frame.substr(1));
+    input.append(kFlushTail, sizeof(kFlushTail));
+    z.next_in = reinterpret_cast<Bytef*>(input.data());
+    z.avail_in = static_cast<uInt>(input.size());
+    std::string message;
+    char out[kChunk];
+    int result = Z_OK;
+    do {
+        z.next_out = reinterpret_cast<Bytef*>(out);
+        z.avail_out = sizeof(out);
+        result = inflate(&z, Z_SYNC_FLUSH);
+        if (result != Z_OK && result != Z_BUF_ERROR && result != Z_STREAM_END) {
+            throw std::runtime_error("Frame inflate: malformed frame");
+        }
+        message.append(out, sizeof(out) - z.avail_out);
+    } while (z.avail_out == 0 && result != Z_STREAM_END);
+    // A final block ends the stream; the next frame starts a new one
+    if (result == Z_STREAM_END) inflateReset(&z);
+    if (z.avail_in != 0) throw std::runtime_error("Frame inflate: malformed frame");
+    return message;
+}
+
+} // namespace cardbattle
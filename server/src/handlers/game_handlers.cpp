@@ -24,6 +24,7 @@ std::string CreateSessionHandler::HandleRequestThrow(const userver::server::http
             throw std::runtime_error("Invalid or missing authorization token");
         }
         std::string player1_id = auth_header.substr(7); // Remove "Bearer " prefix
+        if (IsBotPlayer(player1_id)) throw std::runtime_error("Invalid player id");
         
         std::string session_id = session_manager->CreateSession(player1_id);
         userver::formats::json::ValueBuilder response;
@@ -51,6 +52,7 @@ std::string JoinSessionHandler::HandleRequestThrow(const userver::server::http::
             throw std::runtime_error("Invalid or missing authorization token");
         }
         std::string player2_id = auth_header.substr(7); // Remove "Bearer " prefix
+        if (IsBotPlayer(player2_id)) throw std::runtime_error("Invalid player id");
         
         auto body = userver::formats::json::FromString(request.RequestBody());
         std::string session_id = body["session_id"].As<std::string>();
@@ -129,4 +131,36 @@ std::string LeaveSessionHandler::HandleRequestThrow(const userver::server::http:
     }
 }
 
+std::string AddBotHandler::HandleRequestThrow(const userver::server::http::HttpRequest& request, userver::server::request::RequestContext&) const {
+    auto& response = request.GetHttpResponse();
+    response.SetHeader(std::string("Access-Control-Allow-Origin"), "*");
+    response.SetHeader(std::string("Access-Control-Allow-Headers"), "Content-Type, Authorization");
+    response.SetHeader(std::string("Access-Control-Allow-Methods"), "POST, GET, OPTIONS");
+    try {
+        std::string auth_header = request.GetHeader("Authorization");
+        if (auth_header.empty() || auth_header.substr(0, 7) != "Bearer ") {
+            throw std::runtime_error("Invalid or missing authorization token");
+        }
+        std::string host_id = auth_header.substr(7); // Remove "Bearer " prefix
+
+        auto body = userver::formats::json::FromString(request.RequestBody());
+        std::string session_id = body["session_id"].As<std::string>();
+
+        std::string bot_id = session_manager->AddBot(session_id, host_id);
+
+        userver::formats::json::ValueBuilder response;
+        response["success"] = true;
+        response["message"] = "Bot joined session";
+        response["session_status"] = "ready";
+        response["session_id"] = session_id;
+        response["guest_id"] = bot_id;
+        return userver::formats::json::ToString(response.ExtractValue());
+    } catch (const std::exception& e) {
+        userver::formats::json::ValueBuilder response;
+        response["success"] = false;
+        response["error"] = e.what();
+        return userver::formats::json::ToString(response.ExtractValue());
+    }
+}
+
 } // namespace cardbattle 
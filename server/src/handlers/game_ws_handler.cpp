@@ -1,13 +1,27 @@
 #include "../include/handlers/game_ws_handler.hpp"
+#include "../include/handlers/session_subscribers.hpp"
 #include "../include/managers/battle_manager.hpp"
 #include "../include/managers/session_manager.hpp"
 #include "../include/managers/user_manager.hpp"
 #include "../include/types.hpp"
+#include "../include/battle_wire.hpp"
+#include "../include/frame_deflate.hpp"
+#include <userver/components/component_config.hpp>
+#include <userver/components/component_context.hpp>
+#include <userver/formats/common/type.hpp>
 #include <userver/formats/json.hpp>
 #include <userver/formats/json/value_builder.hpp>
 #include <userver/logging/log.hpp>
+#include <userver/engine/mutex.hpp>
+#include <userver/engine/shared_mutex.hpp>
+#include <userver/yaml_config/merge_schemas.hpp>
 #include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
+#include <vector>
 
 namespace cardbattle {
 
@@ -18,16 +32,223 @@ static UserManager* user_manager = nullptr;
 // Global handler instance
 BattleWebSocketHandler* g_battle_ws_handler = nullptr;
 
+using WebSocketConnection = userver::server::websocket::WebSocketConnection;
+
 // Static connection map for broadcasting
-static std::unordered_map<userver::server::websocket::WebSocketConnection*, BattleWebSocketHandler::ConnectionContext> g_connection_contexts;
+static std::unordered_map<WebSocketConnection*, BattleWebSocketHandler::ConnectionContext> g_connection_contexts;
+// session_id -> connections joined to it, so broadcasts don't scan every socket
+static SessionSubscriberIndex<WebSocketConnection> g_session_subscribers;
+// Guards both maps above. Broadcasts only copy their recipients out under
+// it and send after letting go, so a slow socket or a deflate never holds
+// up joins, leaves or other sessions' broadcasts.
+static userver::engine::SharedMutex g_connections_mutex;
+
+// Format indices from BattleManager::AddStateFormat
+static std::size_t g_json_format = 0;
+static std::size_t g_binary_format = 0;
+
+// The handler's "compression" config
+struct CompressionSettings {
+    bool enabled = false;
+    int level = 6;
+    std::size_t min_size = 512;
+    bool context_takeover = true;
+};
+static CompressionSettings g_compression;
+
+struct BattleWebSocketHandler::SendChannel {
+    // Held across deflating and sending, so frames reach the client in the
+    // order they were deflated, and by Handle() as it lets go of the socket
+    userver::engine::Mutex mutex;
+    WebSocketConnection* websocket = nullptr;  // Null once the connection closed
+    std::unique_ptr<FrameDeflater> deflater;   // With context takeover only
+};
+
+// A subscriber as a broadcast copied it out, to send to without the
+// connections lock
+struct Recipient {
+    std::shared_ptr<BattleWebSocketHandler::SendChannel> channel;
+    std::string user_id;
+    bool binary_wire = false;
+    bool delta_updates = false;
+    bool deflate = false;
+
+    std::size_t Format() const { return binary_wire ? g_binary_format : g_json_format; }
+};
+
+static Recipient RecipientOf(const BattleWebSocketHandler::ConnectionContext& ctx) {
+    return {ctx.channel, ctx.user_id, ctx.binary_wire, ctx.delta_updates, ctx.deflate};
+}
+
+static std::vector<Recipient> RecipientsOf(const std::string& session_id) {
+    std::vector<Recipient> recipients;
+    std::shared_lock lock(g_connections_mutex);
+    g_session_subscribers.ForEach(session_id, [&](WebSocketConnection* conn) {
+        recipients.push_back(RecipientOf(g_connection_contexts.at(conn)));
+    });
+    return recipients;
+}
+
+// A state on its way out. Without context takeover its deflated frame is
+// the same for every client, so a broadcast makes it once.
+struct OutgoingState {
+    std::shared_ptr<const std::string> payload;
+    std::string deflated;  // Made on first use
+};
+
+// States go out in the connection's format; errors are always JSON text.
+// A connection that closed meanwhile is skipped.
+static void SendState(const Recipient& to, OutgoingState& state) {
+    const std::string& payload = *state.payload;
+    const bool deflate = to.deflate && payload.size() >= g_compression.min_size;
+    auto& channel = *to.channel;
+    std::lock_guard lock(channel.mutex);
+    if (!channel.websocket) return;
+    if (deflate && channel.deflater) {
+        channel.websocket->SendBinary(channel.deflater->Deflate(payload));
+    } else if (deflate) {
+        if (state.deflated.empty()) state.deflated = FrameDeflater(g_compression.level, false).Deflate(payload);
+        channel.websocket->SendBinary(state.deflated);
+    } else if (to.binary_wire) {
+        channel.websocket->SendBinary(payload);
+    } else {
+        channel.websocket->SendText(payload);
+    }
+}
+
+static void SendState(const Recipient& to, std::shared_ptr<const std::string> payload) {
+    OutgoingState state{std::move(payload), {}};
+    SendState(to, state);
+}
+
+// A JSON reply to the client's own message, e.g. an error. Through the
+// channel like states, so it cannot land inside a broadcast.
+static void SendReply(BattleWebSocketHandler::SendChannel& channel, const std::string& reply) {
+    std::lock_guard lock(channel.mutex);
+    if (channel.websocket) channel.websocket->SendText(reply);
+}
+
+// A JSON text frame as the action a binary frame would carry. Anything
+// unrecognized is ClientAction::Type::UNKNOWN.
+static ClientAction ParseJsonAction(const std::string& data) {
+    auto json = userver::formats::json::FromString(data);
+    const std::string action = json["action"].As<std::string>();
+    ClientAction parsed;
+    if (action == "join_session") {
+        parsed.type = ClientAction::Type::JOIN_SESSION;
+        parsed.session_id = json["session_id"].As<std::string>();
+        parsed.user_id = json["user_id"].As<std::string>();
+        parsed.delta_updates = json["updates"].As<std::string>("full") == "delta";
+        parsed.deflate = json["compression"].As<std::string>("none") == "deflate";
+    } else if (action == "play_card") {
+        parsed.type = ClientAction::Type::PLAY_CARD;
+        parsed.hand_index = json["hand_index"].As<int>();
+    } else if (action == "attack") {
+        parsed.type = ClientAction::Type::ATTACK;
+        parsed.attacker_index = json["attacker_hand_index"].As<int>();
+        parsed.target_index = json["target_hand_index"].As<int>();
+    } else if (action == "end_turn") {
+        parsed.type = ClientAction::Type::END_TURN;
+    } else if (action == "surrender") {
+        parsed.type = ClientAction::Type::SURRENDER;
+    } else if (action == "get_battle_state") {
+        parsed.type = ClientAction::Type::GET_BATTLE_STATE;
+    } else if (action == "resync") {
+        parsed.type = ClientAction::Type::RESYNC;
+    } else {
+        LOG_ERROR() << "Unknown action: " << action;
+    }
+    return parsed;
+}
+
+// Whether a Sec-WebSocket-Protocol header lists `protocol`
+static bool OffersSubprotocol(std::string_view header, std::string_view protocol) {
+    while (!header.empty()) {
+        const auto comma = header.find(',');
+        std::string_view offered = header.substr(0, comma);
+        header = comma == std::string_view::npos ? std::string_view() : header.substr(comma + 1);
+        while (!offered.empty() && offered.front() == ' ') offered.remove_prefix(1);
+        while (!offered.empty() && offered.back() == ' ') offered.remove_suffix(1);
+        if (offered == protocol) return true;
+    }
+    return false;
+}
+
+BattleWebSocketHandler::BattleWebSocketHandler(const userver::components::ComponentConfig& config,
+                                               const userver::components::ComponentContext& context)
+    : WebsocketHandlerBase(config, context) {
+    const auto compression = config["compression"];
+    g_compression.enabled = compression["enabled"].As<bool>(g_compression.enabled);
+    g_compression.level = compression["level"].As<int>(g_compression.level);
+    g_compression.min_size = compression["min-size"].As<std::size_t>(g_compression.min_size);
+    g_compression.context_takeover = compression["context-takeover"].As<bool>(g_compression.context_takeover);
+    if (g_compression.level < 1 || g_compression.level > 9) {
+        throw std::runtime_error("compression.level must be between 1 and 9");
+    }
+}
+
+userver::yaml_config::Schema BattleWebSocketHandler::GetStaticConfigSchema() {
+    return userver::yaml_config::MergeSchemas<userver::server::websocket::WebsocketHandlerBase>(R"(
+type: object
+description: battle WebSocket handler
+additionalProperties: false
+properties:
+    compression:
+        type: object
+        description: deflate for battle states, for clients that ask for it on join_session
+        additionalProperties: false
+        properties:
+            enabled:
+                type: boolean
+                description: whether clients may turn compression on
+                defaultDescription: false
+            level:
+                type: integer
+                description: zlib level, 1 (fastest) to 9 (smallest)
+                defaultDescription: 6
+            min-size:
+                type: integer
+                description: states smaller than this many bytes are sent as they are
+                defaultDescription: 512
+            context-takeover:
+                type: boolean
+                description: >
+                    keep each connection's compression window between states, so repeated
+                    cards and keys cost little; costs a deflater per connection and one
+                    compression per recipient instead of one per broadcast
+                defaultDescription: true
+)");
+}
+
+bool BattleWebSocketHandler::HandleHandshake(const userver::server::http::HttpRequest& request,
+                                             userver::server::http::HttpResponse& response,
+                                             userver::server::request::RequestContext& context) const {
+    if (OffersSubprotocol(request.GetHeader("Sec-WebSocket-Protocol"), kBinaryWireProtocol)) {
+        response.SetHeader(std::string("Sec-WebSocket-Protocol"), std::string(kBinaryWireProtocol));
+        context.SetData("binary_wire", true);
+    }
+    return true;
+}
 
 void BattleWebSocketHandler::Handle(userver::server::websocket::WebSocketConnection& websocket, 
                                    userver::server::request::RequestContext& context) const {
     LOG_INFO() << "Handle() START for websocket: " << &websocket;
+    auto* conn = &websocket;
+    const bool* binary_wire = context.GetDataOptional<bool>("binary_wire");
     // Get connection context
-    auto& ctx = g_connection_contexts[const_cast<userver::server::websocket::WebSocketConnection*>(&websocket)];
+    BattleWebSocketHandler::ConnectionContext* ctx_ptr = nullptr;
+    auto channel = std::make_shared<SendChannel>();
+    channel->websocket = conn;
+    {
+        std::unique_lock lock(g_connections_mutex);
+        ctx_ptr = &g_connection_contexts[conn];
+        ctx_ptr->binary_wire = binary_wire && *binary_wire;
+        ctx_ptr->channel = channel;
+    }
+    auto& ctx = *ctx_ptr;
     try {
-        LOG_INFO() << "WebSocket connection opened for websocket: " << &websocket;
+        LOG_INFO() << "WebSocket connection opened for websocket: " << &websocket
+                   << (ctx.binary_wire ? " (binary protocol)" : "");
         
         // Handle incoming messages
         userver::server::websocket::Message message;
@@ -38,56 +259,83 @@ void BattleWebSocketHandler::Handle(userver::server::websocket::WebSocketConnect
                 LOG_INFO() << "WebSocket Recv loop exited for websocket: " << &websocket << " with exception: " << e.what();
                 break;
             }
-            LOG_INFO() << "Received message on websocket: " << &websocket << ", data: " << message.data;
-            if (!message.is_text || message.data.empty()) {
+            if (message.is_text) {
+                LOG_INFO() << "Received message on websocket: " << &websocket << ", data: " << message.data;
+            } else {
+                LOG_INFO() << "Received binary message on websocket: " << &websocket << ", size: " << message.data.size();
+            }
+            // Binary frames only mean something on the binary protocol
+            if ((!message.is_text && !ctx.binary_wire) || message.data.empty()) {
                 continue;
             }
             try {
-                auto json = userver::formats::json::FromString(message.data);
-                std::string action = json["action"].As<std::string>();
-                LOG_INFO() << "Processing action: " << action << " for websocket: " << &websocket;
+                const ClientAction action =
+                    message.is_text ? ParseJsonAction(message.data) : DecodeClientAction(message.data);
+                LOG_INFO() << "Processing action: " << static_cast<int>(action.type) << " for websocket: " << &websocket;
                     
-                if (action == "join_session") {
-                    std::string session_id = json["session_id"].As<std::string>();
-                    std::string user_id = json["user_id"].As<std::string>();
+                if (action.type == ClientAction::Type::JOIN_SESSION) {
+                    const std::string& session_id = action.session_id;
+                    const std::string& user_id = action.user_id;
+                    // Bot seats are played by BattleBotComponent alone
+                    if (IsBotPlayer(user_id)) {
+                        SendReply(*channel, "{\"success\":false,\"error\":\"Invalid user id\"}");
+                        LOG_ERROR() << "Join attempted as bot player " << user_id;
+                        continue;
+                    }
                     
-                    ctx.user_id = user_id;
-                    ctx.session_id = session_id;
-                    ctx.session_joined = true;
+                    // Before broadcasts can see the connection asking for
+                    // deflate: with context takeover every deflated frame must
+                    // come from the one deflater
+                    if (action.deflate && g_compression.enabled && g_compression.context_takeover) {
+                        std::lock_guard lock(channel->mutex);
+                        if (!channel->deflater) {
+                            channel->deflater = std::make_unique<FrameDeflater>(g_compression.level, true);
+                        }
+                    }
+                    {
+                        std::unique_lock lock(g_connections_mutex);
+                        ctx.user_id = user_id;
+                        ctx.session_id = session_id;
+                        ctx.session_joined = true;
+                        ctx.delta_updates = action.delta_updates;
+                        ctx.deflate = action.deflate && g_compression.enabled;
+                        g_session_subscribers.Subscribe(conn, session_id);
+                    }
                     
                     // Check session readiness before starting battle
                     auto session = session_manager->GetSession(session_id);
+                    // Game actions address the player by seat from now on
+                    ctx.seat = BattleManager::SeatInSession(session, user_id);
                     if (session.guest_id.empty() || session.status != "ready") {
-                        websocket.SendText("{\"success\":false,\"error\":\"Cannot start battle: both players must join the session first.\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"Cannot start battle: both players must join the session first.\"}");
                         LOG_ERROR() << "Attempted to start battle before both players joined.";
                         continue;
                     }
                     
                     // If the battle has already started, just send the current battle state to this client
                     try {
-                        BattleState battle_state = battle_manager->GetBattleState(session_id);
-                        std::string battle_json = BattleStateToJson(battle_state);
-                        websocket.SendText(battle_json);
+                        const auto self = RecipientOf(ctx);
+                        SendState(self, battle_manager->GetBattlePayload(session_id, self.Format()));
                         LOG_INFO() << "Sent current battle state to client " << user_id << " in session " << session_id;
                         continue;
                     } catch (const std::exception&) {
                         // If no battle state, proceed to start the battle as before
                     }
                     
-                    // Only start the battle if BOTH host and guest are present in g_connection_contexts with session_joined=true
-                    bool host_joined = false, guest_joined = false;
-                    for (const auto& pair : g_connection_contexts) {
-                        const auto& c = pair.second;
-                        if (c.session_id == session_id && c.session_joined) {
+                    // Only start the battle if BOTH host and guest have joined this session over WebSocket;
+                    // a bot guest has no connection and is always there
+                    bool host_joined = false, guest_joined = IsBotPlayer(session.guest_id);
+                    {
+                        std::shared_lock lock(g_connections_mutex);
+                        g_session_subscribers.ForEach(session_id, [&](WebSocketConnection* subscriber) {
+                            const auto& c = g_connection_contexts.at(subscriber);
                             if (c.user_id == session.host_id) host_joined = true;
                             if (c.user_id == session.guest_id) guest_joined = true;
-                        }
+                        });
                     }
                     if (host_joined && guest_joined) {
                         // Start battle if not already started
-                        try {
-                            battle_manager->GetBattleState(session_id);
-                        } catch (const std::exception&) {
+                        if (!battle_manager->HasBattle(session_id)) {
                             battle_manager->StartBattle(session_id);
                         }
                         // Broadcast battle state to all clients in the session (host and guest)
@@ -97,106 +345,95 @@ void BattleWebSocketHandler::Handle(userver::server::websocket::WebSocketConnect
                         LOG_INFO() << "Waiting for both host and guest to join WebSocket for session " << session_id;
                     }
                     
-                } else if (action == "play_card") {
+                } else if (action.type == ClientAction::Type::PLAY_CARD) {
                     if (!ctx.session_joined) {
-                        websocket.SendText("{\"success\":false,\"error\":\"Not joined to session\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"Not joined to session\"}");
                         LOG_ERROR() << "Play card attempted before joining session";
                         continue;
                     }
                     
                     try {
-                        int hand_index = json["hand_index"].As<int>();
-                        battle_manager->PlayCard(ctx.session_id, ctx.user_id, hand_index);
-                        
-                        // Broadcast updated battle state to all clients
-                        BroadcastBattleState(ctx.session_id);
+                        battle_manager->PlayCard(ctx.session_id, ctx.seat, action.hand_index);
+                        // The battle manager broadcasts the updated state from the battle's actor
                     } catch (const std::runtime_error& e) {
                         // Handle game logic errors (like "Not enough mana")
-                        websocket.SendText("{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
                         LOG_ERROR() << "Game logic error in play_card: " << e.what() << " for user: " << ctx.user_id;
                         continue; // Continue processing messages, don't close connection
                     }
                     
-                } else if (action == "attack") {
+                } else if (action.type == ClientAction::Type::ATTACK) {
                     if (!ctx.session_joined) {
-                        websocket.SendText("{\"success\":false,\"error\":\"Not joined to session\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"Not joined to session\"}");
                         LOG_ERROR() << "Attack attempted before joining session";
                         continue;
                     }
                     
                     try {
-                        int attacker_hand_index = json["attacker_hand_index"].As<int>();
-                        int target_hand_index = json["target_hand_index"].As<int>();
-                        
-                        battle_manager->Attack(ctx.session_id, ctx.user_id, attacker_hand_index, target_hand_index);
-                        
-                        // Broadcast updated battle state to all clients
-                        BroadcastBattleState(ctx.session_id);
+                        battle_manager->Attack(ctx.session_id, ctx.seat, action.attacker_index, action.target_index);
+                        // The battle manager broadcasts the updated state from the battle's actor
                     } catch (const std::runtime_error& e) {
                         // Handle game logic errors
-                        websocket.SendText("{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
                         LOG_ERROR() << "Game logic error in attack: " << e.what() << " for user: " << ctx.user_id;
                         continue; // Continue processing messages, don't close connection
                     }
                     
-                } else if (action == "end_turn") {
+                } else if (action.type == ClientAction::Type::END_TURN) {
                     if (!ctx.session_joined) {
-                        websocket.SendText("{\"success\":false,\"error\":\"Not joined to session\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"Not joined to session\"}");
                         LOG_ERROR() << "End turn attempted before joining session";
                         continue;
                     }
                     
                     try {
-                        battle_manager->EndTurn(ctx.session_id, ctx.user_id);
-                        
-                        // Broadcast updated battle state to all clients
-                        BroadcastBattleState(ctx.session_id);
+                        battle_manager->EndTurn(ctx.session_id, ctx.seat);
+                        // The battle manager broadcasts the updated state from the battle's actor
                     } catch (const std::runtime_error& e) {
                         // Handle game logic errors
-                        websocket.SendText("{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
                         LOG_ERROR() << "Game logic error in end_turn: " << e.what() << " for user: " << ctx.user_id;
                         continue; // Continue processing messages, don't close connection
                     }
                     
-                } else if (action == "surrender") {
+                } else if (action.type == ClientAction::Type::SURRENDER) {
                     if (!ctx.session_joined) {
-                        websocket.SendText("{\"success\":false,\"error\":\"Not joined to session\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"Not joined to session\"}");
                         LOG_ERROR() << "Surrender attempted before joining session";
                         continue;
                     }
                     
                     try {
                         // Call the surrender method
-                        battle_manager->Surrender(ctx.session_id, ctx.user_id);
-                        
-                        // Broadcast updated battle state to all clients
-                        BroadcastBattleState(ctx.session_id);
+                        battle_manager->Surrender(ctx.session_id, ctx.seat);
+                        // The battle manager broadcasts the updated state from the battle's actor
                     } catch (const std::runtime_error& e) {
                         // Handle game logic errors
-                        websocket.SendText("{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}");
                         LOG_ERROR() << "Game logic error in surrender: " << e.what() << " for user: " << ctx.user_id;
                         continue; // Continue processing messages, don't close connection
                     }
                     
-                } else if (action == "get_battle_state") {
+                } else if (action.type == ClientAction::Type::GET_BATTLE_STATE ||
+                           action.type == ClientAction::Type::RESYNC) {
+                    // "resync": a delta client that missed a version starts over from the full state
                     if (!ctx.session_joined) {
-                        websocket.SendText("{\"success\":false,\"error\":\"Not joined to session\"}");
+                        SendReply(*channel, "{\"success\":false,\"error\":\"Not joined to session\"}");
                         LOG_ERROR() << "Get battle state attempted before joining session";
                         continue;
                     }
                     
                     // Send current battle state to this client
-                    BattleState battle_state = battle_manager->GetBattleState(ctx.session_id);
-                    std::string battle_json = BattleStateToJson(battle_state);
-                    websocket.SendText(battle_json);
+                    const auto self = RecipientOf(ctx);
+                    SendState(self, battle_manager->GetBattlePayload(ctx.session_id, self.Format()));
                     
                 } else {
-                    websocket.SendText("{\"success\":false,\"error\":\"Unknown action\"}");
-                    LOG_ERROR() << "Unknown action: " << action;
+                    SendReply(*channel, "{\"success\":false,\"error\":\"Unknown action\"}");
                 }
                     
             } catch (const std::exception& e) {
-                websocket.SendText("{\"success\":false,\"error\":\"Invalid JSON: " + std::string(e.what()) + "\"}");
+                SendReply(*channel, std::string("{\"success\":false,\"error\":\"") +
+                                        (message.is_text ? "Invalid JSON: " : "Invalid message: ") + e.what() + "\"}");
                 LOG_ERROR() << "WebSocket JSON error: " << e.what() << " on websocket: " << &websocket;
                 break; // Break the loop on error
             }
@@ -210,15 +447,24 @@ void BattleWebSocketHandler::Handle(userver::server::websocket::WebSocketConnect
     std::string closed_session_id = ctx.session_id;
     std::string closed_user_id = ctx.user_id;
     LOG_INFO() << "Erasing connection context and closing websocket: " << &websocket;
-    g_connection_contexts.erase(const_cast<userver::server::websocket::WebSocketConnection*>(&websocket));
+    {
+        std::unique_lock lock(g_connections_mutex);
+        g_session_subscribers.Unsubscribe(conn);
+        g_connection_contexts.erase(conn);
+    }
+    // Broadcasts that copied the channel out earlier may still be sending;
+    // wait for them, and keep later ones off the socket about to go away
+    {
+        std::lock_guard lock(channel->mutex);
+        channel->websocket = nullptr;
+    }
     // If the context had a session, mark player left and broadcast
     if (!closed_session_id.empty()) {
         try {
-            BattleState battle_state = battle_manager->GetBattleState(closed_session_id);
-            battle_state.last_action = "Player left: " + closed_user_id;
-            // Save and broadcast
-            battle_manager->SaveBattleState(closed_session_id, battle_state);
-            BroadcastBattleState(closed_session_id);
+            // Updating broadcasts the state to the remaining clients
+            battle_manager->UpdateBattleState(closed_session_id, [&closed_user_id](BattleState& battle_state) {
+                battle_state.last_action = "Player left: " + closed_user_id;
+            });
         } catch (const std::exception&) {
             // Battle may not exist, ignore
         }
@@ -233,59 +479,99 @@ void BattleWebSocketHandler::BroadcastSessionUpdate(const std::string& session_i
 
 void BattleWebSocketHandler::BroadcastBattleState(const std::string& session_id) {
     try {
-        // Get current battle state
-        BattleState battle_state = battle_manager->GetBattleState(session_id);
-        std::string battle_json = BattleStateToJson(battle_state);
         LOG_INFO() << "Broadcasting battle state for session: " << session_id;
-        // Collect keys to remove after iteration
-        std::vector<userver::server::websocket::WebSocketConnection*> to_remove;
-        std::vector<userver::server::websocket::WebSocketConnection*> keys;
-        for (const auto& pair : g_connection_contexts) {
-            keys.push_back(pair.first);
+        // Only the sockets subscribed to this session are touched. Broken
+        // connections are unregistered by their own Handle() once Recv fails;
+        // one that joins after this gets the state on join.
+        const auto recipients = RecipientsOf(session_id);
+        // Serialized at most once per state version, however often it is read
+        std::array<OutgoingState, BattleActor::kMaxFormats> states;
+        for (const auto& recipient : recipients) {
+            auto& state = states[recipient.Format()];
+            if (!state.payload) state.payload = battle_manager->GetBattlePayload(session_id, recipient.Format());
         }
-        for (auto* conn : keys) {
-            const auto& ctx = g_connection_contexts[conn];
-            if (ctx.session_id == session_id && ctx.session_joined) {
-                try {
-                    conn->SendText(battle_json);
-                    LOG_INFO() << "Broadcasted battle state to client " << ctx.user_id << " in session " << session_id;
-                } catch (const std::exception& e) {
-                    LOG_ERROR() << "Failed to send battle state to client " << ctx.user_id << ": " << e.what();
-                    to_remove.push_back(conn);
-                }
+        for (const auto& recipient : recipients) {
+            try {
+                SendState(recipient, states[recipient.Format()]);
+                LOG_INFO() << "Broadcasted battle state to client " << recipient.user_id << " in session "
+                           << session_id;
+            } catch (const std::exception& e) {
+                LOG_ERROR() << "Failed to send battle state to client " << recipient.user_id << ": " << e.what();
             }
         }
-        for (auto* conn : to_remove) {
-            g_connection_contexts.erase(conn);
-            LOG_INFO() << "Removed closed/broken websocket connection: " << conn;
-        }
         LOG_INFO() << "Broadcasted battle state to all clients in session: " << session_id;
     } catch (const std::exception& e) {
         LOG_ERROR() << "Error broadcasting battle state for session " << session_id << ": " << e.what();
     }
 }
 
+// Each client gets the state in its format and mode: full, or the delta
+// when one is known for this version. Each is serialized (and deflated,
+// without context takeover) only if some client needs it.
+static void BroadcastStateUpdate(const BattleManager::StateUpdate& update) {
+    const std::string& session_id = update.State().session_id;
+    struct Serialized {
+        OutgoingState full;
+        OutgoingState delta;
+        bool delta_tried = false;
+    };
+    std::array<Serialized, BattleActor::kMaxFormats> formats;
+    for (const auto& recipient : RecipientsOf(session_id)) {
+        try {
+            const std::size_t format = recipient.Format();
+            auto& serialized = formats[format];
+            if (recipient.delta_updates && !serialized.delta_tried) {
+                serialized.delta.payload = update.Delta(format);
+                serialized.delta_tried = true;
+            }
+            if (recipient.delta_updates && serialized.delta.payload) {
+                SendState(recipient, serialized.delta);
+                continue;
+            }
+            if (!serialized.full.payload) serialized.full.payload = update.Payload(format);
+            SendState(recipient, serialized.full);
+        } catch (const std::exception& e) {
+            LOG_ERROR() << "Failed to send battle state to client " << recipient.user_id << ": " << e.what();
+        }
+    }
+    LOG_INFO() << "Broadcasted battle state version " << update.State().version << " in session " << session_id;
+}
+
 void BattleWebSocketHandler::RefreshAllClients(const std::string& session_id) {
     // Left unimplemented
     LOG_INFO() << "Refreshing all clients for session: " << session_id;
 }
 
+static userver::formats::json::Value CardToJson(const Card& card, const CardCatalog& catalog) {
+    const CardDefinition definition = catalog.Get(card.definition);
+    userver::formats::json::ValueBuilder card_builder;
+    card_builder["id"] = std::string(definition.id);
+    card_builder["name"] = std::string(definition.name);
+    card_builder["attack"] = static_cast<int>(card.attack);
+    card_builder["defense"] = static_cast<int>(card.defense);
+    card_builder["mana_cost"] = definition.mana_cost;
+    card_builder["type"] = static_cast<int>(definition.type);
+    return card_builder.ExtractValue();
+}
+
 std::string BattleWebSocketHandler::BattleStateToJson(const BattleState& state) {
     LOG_INFO() << "BattleStateToJson called for session " << state.session_id;
-    for (const auto& pair : state.players) {
-        const std::string& player_id = pair.first;
-        const PlayerState& player = pair.second;
-        LOG_INFO() << "  Serializing player " << player_id << ": hand size=" << player.hand.size() 
+    for (const auto& player : state.players) {
+        LOG_INFO() << "  Serializing player " << player.player_id << ": hand size=" << player.hand.size() 
                    << ", deck size=" << player.deck.size() 
                    << ", field size=" << player.field.size() 
                    << ", graveyard size=" << player.graveyard.size();
     }
     
+    // Cards only carry a definition index into the battle's pinned catalog
+    const CardCatalog& catalog = *state.catalog;
+    
     userver::formats::json::ValueBuilder builder;
     
     builder["success"] = true;
     builder["session_id"] = state.session_id;
-    builder["current_turn"] = state.current_turn;
+    builder["version"] = state.version;
+    builder["current_turn"] = state.CurrentPlayerId();
     builder["turn_number"] = state.turn_number;
     builder["is_finished"] = state.is_finished;
     builder["winner"] = state.winner;
@@ -294,9 +580,8 @@ std::string BattleWebSocketHandler::BattleStateToJson(const BattleState& state)
     // Serialize players
     userver::formats::json::ValueBuilder players_builder;
     
-    for (const auto& pair : state.players) {
-        const std::string& player_id = pair.first;
-        const PlayerState& player = pair.second;
+    for (const auto& player : state.players) {
+        const std::string& player_id = player.player_id;
         
         // Map player IDs to test-friendly names
         std::string player_key = GetPlayerKey(player_id, state);
@@ -311,14 +596,7 @@ std::string BattleWebSocketHandler::BattleStateToJson(const BattleState& state)
         // Serialize hand (always array, never null)
         userver::formats::json::ValueBuilder hand_builder;
         for (const auto& card : player.hand) {
-            userver::formats::json::ValueBuilder card_builder;
-            card_builder["id"] = card.id;
-            card_builder["name"] = card.name;
-            card_builder["attack"] = card.attack;
-            card_builder["defense"] = card.defense;
-            card_builder["mana_cost"] = card.mana_cost;
-            card_builder["type"] = static_cast<int>(card.type);
-            hand_builder.PushBack(card_builder.ExtractValue());
+            hand_builder.PushBack(CardToJson(card, catalog));
         }
         // Always set as array, even if empty
         player_builder["hand"] = hand_builder.ExtractValue();
@@ -326,14 +604,7 @@ std::string BattleWebSocketHandler::BattleStateToJson(const BattleState& state)
         // Serialize field (always array, never null)
         userver::formats::json::ValueBuilder field_builder;
         for (const auto& card : player.field) {
-            userver::formats::json::ValueBuilder card_builder;
-            card_builder["id"] = card.id;
-            card_builder["name"] = card.name;
-            card_builder["attack"] = card.attack;
-            card_builder["defense"] = card.defense;
-            card_builder["mana_cost"] = card.mana_cost;
-            card_builder["type"] = static_cast<int>(card.type);
-            field_builder.PushBack(card_builder.ExtractValue());
+            field_builder.PushBack(CardToJson(card, catalog));
         }
         // Always set as array, even if empty
         player_builder["field"] = field_builder.ExtractValue();
@@ -346,14 +617,7 @@ std::string BattleWebSocketHandler::BattleStateToJson(const BattleState& state)
         // Serialize graveyard (always array, never null)
         userver::formats::json::ValueBuilder graveyard_builder;
         for (const auto& card : player.graveyard) {
-            userver::formats::json::ValueBuilder card_builder;
-            card_builder["id"] = card.id;
-            card_builder["name"] = card.name;
-            card_builder["attack"] = card.attack;
-            card_builder["defense"] = card.defense;
-            card_builder["mana_cost"] = card.mana_cost;
-            card_builder["type"] = static_cast<int>(card.type);
-            graveyard_builder.PushBack(card_builder.ExtractValue());
+            graveyard_builder.PushBack(CardToJson(card, catalog));
         }
         // Always set as array, even if empty
         player_builder["graveyard"] = graveyard_builder.ExtractValue();
@@ -368,6 +632,79 @@ std::string BattleWebSocketHandler::BattleStateToJson(const BattleState& state)
     return result;
 }
 
+// Only what clients see of a card
+static bool SameCard(const Card& a, const Card& b) {
+    return a.definition == b.definition && a.attack == b.attack && a.defense == b.defense;
+}
+
+// Adds the zone to `player_builder` if it changed: its new size and the
+// cards that differ from the old zone at the same index
+template <typename Zone>
+static bool AddZoneDelta(userver::formats::json::ValueBuilder& player_builder, const char* name,
+                         const Zone& before, const Zone& after, const CardCatalog& catalog) {
+    userver::formats::json::ValueBuilder cards_builder(userver::formats::common::Type::kObject);
+    bool changed = before.size() != after.size();
+    for (std::size_t i = 0; i < after.size(); ++i) {
+        if (i < before.size() && SameCard(before[i], after[i])) continue;
+        cards_builder[std::to_string(i)] = CardToJson(after[i], catalog);
+        changed = true;
+    }
+    if (!changed) return false;
+    userver::formats::json::ValueBuilder zone_builder;
+    zone_builder["size"] = static_cast<int>(after.size());
+    zone_builder["cards"] = cards_builder.ExtractValue();
+    player_builder[name] = zone_builder.ExtractValue();
+    return true;
+}
+
+std::string BattleWebSocketHandler::BattleStateDeltaToJson(const BattleState& before, const BattleState& after) {
+    const CardCatalog& catalog = *after.catalog;
+    userver::formats::json::ValueBuilder builder;
+    builder["success"] = true;
+    builder["type"] = "delta";
+    builder["session_id"] = after.session_id;
+    builder["base_version"] = before.version;
+    builder["version"] = after.version;
+    if (before.current_seat != after.current_seat) builder["current_turn"] = after.CurrentPlayerId();
+    if (before.turn_number != after.turn_number) builder["turn_number"] = after.turn_number;
+    if (before.is_finished != after.is_finished) builder["is_finished"] = after.is_finished;
+    if (before.winner != after.winner) builder["winner"] = after.winner;
+    if (before.last_action != after.last_action) builder["last_action"] = after.last_action;
+
+    userver::formats::json::ValueBuilder players_builder(userver::formats::common::Type::kObject);
+    bool players_changed = false;
+    for (int seat = 0; seat < 2; ++seat) {
+        const PlayerState& old_player = before.players[seat];
+        const PlayerState& player = after.players[seat];
+        userver::formats::json::ValueBuilder player_builder(userver::formats::common::Type::kObject);
+        bool changed = false;
+        const auto add_if_changed = [&](const char* name, auto old_value, auto value) {
+            if (old_value == value) return;
+            player_builder[name] = value;
+            changed = true;
+        };
+        add_if_changed("health", old_player.health, player.health);
+        add_if_changed("max_health", old_player.max_health, player.max_health);
+        add_if_changed("mana", old_player.mana, player.mana);
+        add_if_changed("max_mana", old_player.max_mana, player.max_mana);
+        add_if_changed("is_active", old_player.is_active, player.is_active);
+        changed |= AddZoneDelta(player_builder, "hand", old_player.hand, player.hand, catalog);
+        changed |= AddZoneDelta(player_builder, "field", old_player.field, player.field, catalog);
+        changed |= AddZoneDelta(player_builder, "graveyard", old_player.graveyard, player.graveyard, catalog);
+        if (old_player.deck.size() != player.deck.size()) {
+            userver::formats::json::ValueBuilder deck_builder;
+            deck_builder["count"] = static_cast<int>(player.deck.size());
+            player_builder["deck"] = deck_builder.ExtractValue();
+            changed = true;
+        }
+        if (!changed) continue;
+        players_builder[GetPlayerKey(player.player_id, after)] = player_builder.ExtractValue();
+        players_changed = true;
+    }
+    if (players_changed) builder["players"] = players_builder.ExtractValue();
+    return userver::formats::json::ToString(builder.ExtractValue());
+}
+
 std::string BattleWebSocketHandler::GetPlayerKey(const std::string& player_id, const BattleState& state) {
     // Needed for tests
     return player_id;
@@ -377,6 +714,18 @@ void InitWebSocketHandler(BattleManager* battle_mgr, GameSessionManager* session
     battle_manager = battle_mgr;
     session_manager = session_mgr;
     user_manager = user_mgr;
+    // Every accepted game action is pushed to the battle's clients in order
+    // One serialization per state version (and one delta) in each format,
+    // shared by every client of that format
+    g_json_format = battle_manager->AddStateFormat(
+        {&BattleWebSocketHandler::BattleStateToJson, &BattleWebSocketHandler::BattleStateDeltaToJson});
+    g_binary_format = battle_manager->AddStateFormat({&EncodeWireState, &EncodeWireDelta});
+    battle_manager->AddStateListener(&BroadcastStateUpdate);
+    // A battle someone is still connected to is not abandoned
+    battle_manager->SetPresenceProbe([](const std::string& session_id) {
+        std::shared_lock lock(g_connections_mutex);
+        return g_session_subscribers.SubscriberCount(session_id) > 0;
+    });
     LOG_INFO() << "WebSocket handler managers initialized";
 }
 
@@ -15,6 +15,8 @@
 #include "../include/managers/user_manager.hpp"
 #include "../include/managers/session_manager.hpp"
 #include "../include/managers/battle_manager.hpp"
+#include "../include/managers/battle_maintenance.hpp"
+#include "../include/managers/battle_bot.hpp"
 #include "../include/handlers/health_handler.hpp"
 #include "../include/handlers/auth_handlers.hpp"
 #include "../include/handlers/game_handlers.hpp"
@@ -67,6 +69,8 @@ int main(int argc, char* argv[]) {
     cardbattle::InitWebSocketHandler(battle_manager.get(), session_manager.get(), user_manager.get());
 
     const auto component_list = userver::components::MinimalServerComponentList()
+        .Append<cardbattle::BattleMaintenanceComponent>()
+        .Append<cardbattle::BattleBotComponent>()
         .Append<cardbattle::HealthCheckHandler>()
         .Append<cardbattle::RegisterHandler>()
         .Append<cardbattle::LoginHandler>()
@@ -75,6 +79,7 @@ int main(int argc, char* argv[]) {
         .Append<cardbattle::JoinSessionHandler>()
         .Append<cardbattle::LeaveSessionHandler>()
         .Append<cardbattle::GetSessionsHandler>()
+        .Append<cardbattle::AddBotHandler>()
         .Append<cardbattle::BattleWebSocketHandler>();
 
     return userver::utils::DaemonMain(argc, argv, component_list);
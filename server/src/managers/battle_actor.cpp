@@ -0,0 +1,113 @@
+#include "../include/managers/battle_actor.hpp"
+#include <exception>
+#include <utility>
+#include <userver/engine/task/cancel.hpp>
+
+namespace cardbattle {
+
+BattleActor::BattleActor(BattleState state)
+    : state_(std::move(state)),
+      snapshot_(std::make_shared<const BattleState>(state_)),
+      delta_to_(snapshot_) {}
+
+void BattleActor::Execute(const Command& command) {
+    // The envelope lives on this stack and the command may capture it by
+    // reference, so we must not be cancelled out of the wait below
+    userver::engine::TaskCancellationBlocker cancellation_blocker;
+    
+    Envelope envelope{&command};
+    auto future = envelope.promise.get_future();
+    Post(&envelope);
+    
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        Drain();
+    }
+    future.get();
+}
+
+std::shared_ptr<const BattleState> BattleActor::Snapshot() {
+    std::shared_ptr<const BattleState> snapshot;
+    Execute([this, &snapshot](BattleState&) { snapshot = SnapshotInCommand(); });
+    return snapshot;
+}
+
+std::shared_ptr<const BattleState> BattleActor::SnapshotInCommand() {
+    if (!snapshot_ || snapshot_->version != state_.version) {
+        snapshot_ = std::make_shared<const BattleState>(state_);
+    }
+    return snapshot_;
+}
+
+std::shared_ptr<const std::string> BattleActor::Payload(std::size_t format, const Serializer& serialize) {
+    std::shared_ptr<const std::string> payload;
+    Execute([this, format, &serialize, &payload](BattleState&) { payload = PayloadInCommand(format, serialize); });
+    return payload;
+}
+
+std::shared_ptr<const std::string> BattleActor::PayloadInCommand(std::size_t format, const Serializer& serialize) {
+    auto& cache = formats_.at(format);
+    if (!cache.payload || cache.payload_version != state_.version) {
+        cache.payload = std::make_shared<const std::string>(serialize(state_));
+        cache.payload_version = state_.version;
+    }
+    return cache.payload;
+}
+
+std::shared_ptr<const std::string> BattleActor::DeltaInCommand(std::size_t format, const DeltaSerializer& serialize) {
+    auto& cache = formats_.at(format);
+    if (delta_to_->version != state_.version) {
+        delta_from_ = delta_to_->version + 1 == state_.version ? std::move(delta_to_) : nullptr;
+        // Shared with readers of the snapshot, so remembering costs no extra copy
+        delta_to_ = SnapshotInCommand();
+        for (auto& stale : formats_) stale.delta.reset();
+    }
+    if (!cache.delta && delta_from_) {
+        cache.delta = std::make_shared<const std::string>(serialize(*delta_from_, state_));
+    }
+    return cache.delta;
+}
+
+void BattleActor::Post(Envelope* envelope) {
+    Envelope* head = inbox_.load(std::memory_order_relaxed);
+    do {
+        envelope->next = head;
+    } while (!inbox_.compare_exchange_weak(head, envelope, std::memory_order_release, std::memory_order_relaxed));
+}
+
+BattleActor::Envelope* BattleActor::TakeInbox() {
+    // Reverse the LIFO stack into arrival order
+    Envelope* stack = inbox_.exchange(nullptr, std::memory_order_acquire);
+    Envelope* ordered = nullptr;
+    while (stack) {
+        Envelope* next = stack->next;
+        stack->next = ordered;
+        ordered = stack;
+        stack = next;
+    }
+    return ordered;
+}
+
+void BattleActor::Drain() {
+    while (true) {
+        // A counted command is always pushed before it is counted, so while
+        // pending_ is non-zero there is something to take
+        if (!local_) local_ = TakeInbox();
+        
+        Envelope* envelope = local_;
+        local_ = envelope->next;
+        
+        try {
+            (*envelope->command)(state_);
+            envelope->promise.set_value();
+        } catch (...) {
+            envelope->promise.set_exception(std::current_exception());
+        }
+        // The envelope's owner may be gone from here on
+        
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            return;
+        }
+    }
+}
+
+} // namespace cardbattle
@@ -0,0 +1,181 @@
+#include "../include/managers/battle_bot.hpp"
+#include "../include/managers/battle_maintenance.hpp"
+#include "../include/managers/battle_manager.hpp"
+#include "../include/managers/session_manager.hpp"
+#include "../include/battle_mcts.hpp"
+#include "../include/battle_rng.hpp"
+#include <atomic>
+#include <random>
+#include <userver/components/statistics_storage.hpp>
+#include <userver/concurrent/background_task_storage.hpp>
+#include <userver/engine/async.hpp>
+#include <userver/logging/log.hpp>
+#include <userver/yaml_config/merge_schemas.hpp>
+
+namespace cardbattle {
+
+extern BattleManager* battle_manager;
+
+class BattleBotComponent::Bot final {
+public:
+    Bot(BattleManager& battle_manager, userver::engine::TaskProcessor& search_task_processor,
+        std::chrono::milliseconds move_time_budget, std::size_t search_trees, const MctsSettings& settings)
+        : battle_manager_(battle_manager),
+          search_task_processor_(search_task_processor),
+          move_time_budget_(move_time_budget),
+          search_trees_(search_trees),
+          settings_(settings),
+          next_seed_((std::uint64_t{std::random_device{}()} << 32) | std::random_device{}()) {}
+
+    // Runs inside the battle's actor: only looks and hands the move off
+    void OnState(const BattleState& battle_state) {
+        if (stopped_.load() || battle_state.is_finished) return;
+        if (!IsBotPlayer(battle_state.players[battle_state.current_seat].player_id)) return;
+        tasks_.AsyncDetach("battle-bot-move", [this, battle_state] { Move(battle_state); });
+    }
+
+    // No moves are started or made after this returns
+    void Stop() {
+        stopped_ = true;
+        tasks_.CancelAndWait();
+    }
+
+    std::uint64_t Moves() const { return moves_.load(std::memory_order_relaxed); }
+    std::uint64_t StaleMoves() const { return stale_moves_.load(std::memory_order_relaxed); }
+    std::uint64_t FailedMoves() const { return failed_moves_.load(std::memory_order_relaxed); }
+    std::uint64_t Iterations() const { return iterations_.load(std::memory_order_relaxed); }
+
+private:
+    void Move(const BattleState& battle_state) {
+        // Root parallelism: independent trees, each on its own deal of the
+        // hidden cards, searched at the same time until the same deadline
+        const auto deadline = std::chrono::steady_clock::now() + move_time_budget_;
+        std::vector<userver::engine::TaskWithResult<MctsRootStats>> searches;
+        searches.reserve(search_trees_);
+        for (std::size_t i = 0; i < search_trees_; ++i) {
+            searches.push_back(userver::engine::AsyncNoSpan(
+                search_task_processor_, [this, &battle_state, seed = NextSeed(), deadline] {
+                    return RunMctsTree(battle_state, seed, settings_, deadline);
+                }));
+        }
+        std::vector<MctsRootStats> trees;
+        trees.reserve(searches.size());
+        for (auto& search : searches) trees.push_back(search.Get());
+        for (const auto& tree : trees) iterations_.fetch_add(tree.iterations, std::memory_order_relaxed);
+
+        const BattleAction action = PickMctsAction(trees);
+        const auto current = battle_manager_.PeekBattleState(battle_state.session_id);
+        if (stopped_.load() || !current || current->version != battle_state.version) {
+            stale_moves_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // The rules check the move again in the actor, so a state change
+        // since the check above only makes the move fail
+        const int seat = battle_state.current_seat;
+        try {
+            switch (action.type) {
+                case BattleAction::Type::PLAY_CARD:
+                    battle_manager_.PlayCard(battle_state.session_id, seat, action.arg0);
+                    break;
+                case BattleAction::Type::ATTACK:
+                    battle_manager_.Attack(battle_state.session_id, seat, action.arg0, action.arg1);
+                    break;
+                case BattleAction::Type::END_TURN:
+                    battle_manager_.EndTurn(battle_state.session_id, seat);
+                    break;
+            }
+            moves_.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception& e) {
+            failed_moves_.fetch_add(1, std::memory_order_relaxed);
+            LOG_WARNING() << "Bot move failed in battle " << battle_state.session_id << ": " << e.what();
+        }
+    }
+
+    std::uint64_t NextSeed() {
+        std::uint64_t counter = next_seed_.fetch_add(1, std::memory_order_relaxed);
+        return BattleRng::SplitMix64(counter);
+    }
+
+    BattleManager& battle_manager_;
+    userver::engine::TaskProcessor& search_task_processor_;
+    const std::chrono::milliseconds move_time_budget_;
+    const std::size_t search_trees_;
+    const MctsSettings settings_;
+    std::atomic<std::uint64_t> next_seed_;
+    std::atomic<bool> stopped_{false};
+    std::atomic<std::uint64_t> moves_{0};
+    std::atomic<std::uint64_t> stale_moves_{0};
+    std::atomic<std::uint64_t> failed_moves_{0};
+    std::atomic<std::uint64_t> iterations_{0};
+    // Move tasks run on the task processor of the battle's actor
+    userver::concurrent::BackgroundTaskStorage tasks_;
+};
+
+BattleBotComponent::BattleBotComponent(const userver::components::ComponentConfig& config,
+                                       const userver::components::ComponentContext& context)
+    : ComponentBase(config, context) {
+    MctsSettings settings;
+    settings.rollout_depth = config["rollout-depth"].As<int>(settings.rollout_depth);
+    settings.exploration = config["exploration"].As<double>(settings.exploration);
+    const auto search_trees = config["search-trees"].As<std::size_t>(2);
+    if (search_trees == 0) throw std::runtime_error("search-trees must be positive");
+    // Sets the turn clock, which ends the bot's turn when a move is lost
+    context.FindComponent<BattleMaintenanceComponent>();
+    if (battle_manager->TurnTimeout().count() <= 0) {
+        throw std::runtime_error("battle-bot needs a turn-timeout in battle-maintenance, or a lost move stalls the battle");
+    }
+    bot_ = std::make_shared<Bot>(
+        *battle_manager, context.GetTaskProcessor(config["task-processor"].As<std::string>()),
+        config["move-time-budget"].As<std::chrono::milliseconds>(std::chrono::seconds{1}), search_trees, settings);
+
+    // BattleManager keeps its listeners, so it only gets a weak reference
+    battle_manager->AddStateListener([weak_bot = std::weak_ptr<Bot>(bot_)](const BattleManager::StateUpdate& update) {
+        if (const auto bot = weak_bot.lock()) bot->OnState(update.State());
+    });
+
+    auto& statistics_storage = context.FindComponent<userver::components::StatisticsStorage>().GetStorage();
+    statistics_holder_ = statistics_storage.RegisterWriter(
+        "cardbattle-bot", [this](userver::utils::statistics::Writer& writer) { WriteStatistics(writer); });
+}
+
+BattleBotComponent::~BattleBotComponent() {
+    statistics_holder_.Unregister();
+    bot_->Stop();
+}
+
+void BattleBotComponent::WriteStatistics(userver::utils::statistics::Writer& writer) const {
+    writer["moves"] = bot_->Moves();
+    writer["stale-moves"] = bot_->StaleMoves();
+    writer["failed-moves"] = bot_->FailedMoves();
+    writer["search-iterations"] = bot_->Iterations();
+}
+
+userver::yaml_config::Schema BattleBotComponent::GetStaticConfigSchema() {
+    return userver::yaml_config::MergeSchemas<userver::components::ComponentBase>(R"(
+type: object
+description: MCTS player for the bot seats of battles
+additionalProperties: false
+properties:
+    task-processor:
+        type: string
+        description: task processor the searches run on; give it its own cores
+    move-time-budget:
+        type: string
+        description: how long the bot searches before each move
+        defaultDescription: 1s
+    search-trees:
+        type: integer
+        description: trees searched in parallel per move, best one per worker of task-processor
+        defaultDescription: 2
+    rollout-depth:
+        type: integer
+        description: random moves per playout before a position is scored on health
+        defaultDescription: 40
+    exploration:
+        type: number
+        description: UCB1 exploration constant
+        defaultDescription: 1.0
+)");
+}
+
+} // namespace cardbattle
@@ -0,0 +1,140 @@
+#include "../include/managers/battle_hibernator.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+#include <userver/engine/async.hpp>
+
+namespace cardbattle {
+
+namespace {
+
+constexpr std::string_view kSuffix = ".battle";
+
+// Session ids become file names; anything else could escape the directory
+bool IsValidSessionId(const std::string& session_id) {
+    if (session_id.empty() || session_id.size() > 128) return false;
+    for (char c : session_id) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') return false;
+    }
+    return true;
+}
+
+void WriteAll(int fd, const std::string& data, const std::string& path) {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = ::write(fd, data.data() + written, data.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to write " + path + ": " + std::strerror(errno));
+        }
+        written += static_cast<std::size_t>(result);
+    }
+}
+
+} // namespace
+
+BattleHibernator::BattleHibernator(std::string directory, userver::engine::TaskProcessor& fs_task_processor)
+    : directory_(std::move(directory)), fs_task_processor_(fs_task_processor) {
+    std::filesystem::create_directories(directory_);
+}
+
+void BattleHibernator::Store(const std::string& session_id, const std::string& data) {
+    const auto path = PathFor(session_id);
+    userver::engine::AsyncNoSpan(fs_task_processor_, [&] {
+        const auto temporary_path = path + ".tmp";
+        int fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to create " + temporary_path + ": " + std::strerror(errno));
+        }
+        try {
+            WriteAll(fd, data, temporary_path);
+            if (::fsync(fd) != 0) {
+                throw std::runtime_error("Failed to sync " + temporary_path + ": " + std::strerror(errno));
+            }
+        } catch (...) {
+            ::close(fd);
+            ::unlink(temporary_path.c_str());
+            throw;
+        }
+        ::close(fd);
+        if (::rename(temporary_path.c_str(), path.c_str()) != 0) {
+            int error = errno;
+            ::unlink(temporary_path.c_str());
+            throw std::runtime_error("Failed to rename " + temporary_path + ": " + std::strerror(error));
+        }
+    }).Get();
+}
+
+std::optional<std::string> BattleHibernator::Load(const std::string& session_id) {
+    const auto path = PathFor(session_id);
+    return userver::engine::AsyncNoSpan(fs_task_processor_, [&]() -> std::optional<std::string> {
+               int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+               if (fd < 0) {
+                   if (errno == ENOENT) return std::nullopt;
+                   throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+               }
+               std::string data;
+               char buffer[4096];
+               while (true) {
+                   ssize_t result = ::read(fd, buffer, sizeof(buffer));
+                   if (result < 0) {
+                       if (errno == EINTR) continue;
+                       int error = errno;
+                       ::close(fd);
+                       throw std::runtime_error("Failed to read " + path + ": " + std::strerror(error));
+                   }
+                   if (result == 0) break;
+                   data.append(buffer, static_cast<std::size_t>(result));
+               }
+               ::close(fd);
+               return data;
+           }).Get();
+}
+
+void BattleHibernator::Remove(const std::string& session_id) {
+    const auto path = PathFor(session_id);
+    userver::engine::AsyncNoSpan(fs_task_processor_, [&] { ::unlink(path.c_str()); }).Get();
+}
+
+std::vector<std::string> BattleHibernator::List() {
+    return ListFiles(std::nullopt);
+}
+
+std::vector<std::string> BattleHibernator::ListOlderThan(std::chrono::seconds max_age) {
+    return ListFiles(max_age);
+}
+
+std::string BattleHibernator::PathFor(const std::string& session_id) const {
+    if (!IsValidSessionId(session_id)) {
+        throw std::runtime_error("Invalid session id for hibernation: " + session_id);
+    }
+    return (std::filesystem::path(directory_) / (session_id + std::string(kSuffix))).string();
+}
+
+std::vector<std::string> BattleHibernator::ListFiles(std::optional<std::chrono::seconds> max_age) {
+    return userver::engine::AsyncNoSpan(fs_task_processor_, [&] {
+               std::vector<std::string> session_ids;
+               const auto now = std::filesystem::file_time_type::clock::now();
+               std::error_code error;
+               for (const auto& entry : std::filesystem::directory_iterator(directory_, error)) {
+                   const auto name = entry.path().filename().string();
+                   if (name.size() <= kSuffix.size() ||
+                       name.compare(name.size() - kSuffix.size(), kSuffix.size(), kSuffix) != 0) {
+                       continue;  // Including leftover .tmp files
+                   }
+                   if (max_age) {
+                       std::error_code time_error;
+                       const auto modified = entry.last_write_time(time_error);
+                       if (time_error || now - modified < *max_age) continue;
+                   }
+                   session_ids.push_back(name.substr(0, name.size() - kSuffix.size()));
+               }
+               return session_ids;
+           }).Get();
+}
+
+} // namespace cardbattle
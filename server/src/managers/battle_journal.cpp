@@ -0,0 +1,394 @@
+#include "../include/managers/battle_journal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <userver/logging/log.hpp>
+
+namespace cardbattle {
+
+namespace {
+
+constexpr char kSegmentMagic[8] = {'Z', 'Z', 'C', 'B', 'J', 'R', 'N', '1'};
+constexpr std::string_view kSegmentPrefix = "journal-";
+constexpr std::string_view kSegmentSuffix = ".log";
+
+struct SegmentHeader {
+    char magic[8];
+    std::uint64_t index;
+};
+static_assert(sizeof(SegmentHeader) == 16);
+
+// Fixed part of a record; the three strings follow, then padding to 8 bytes.
+// size == 0 marks the unused end of a segment.
+struct RecordHeader {
+    std::uint32_t size;      // Whole record including this header and padding
+    std::uint32_t checksum;  // FNV-1a over everything after this field
+    std::uint8_t type;
+    std::int8_t seat;
+    std::int16_t arg0;
+    std::int16_t arg1;
+    std::uint16_t session_id_length;
+    std::uint64_t version;
+    std::uint64_t seed;
+    std::uint16_t host_id_length;
+    std::uint16_t guest_id_length;
+    std::uint32_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 40);
+
+constexpr std::size_t kChecksumStart = offsetof(RecordHeader, type);
+
+std::uint32_t Checksum(const char* data, std::size_t size) {
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+std::size_t RecordSize(const JournalRecord& record) {
+    std::size_t size = sizeof(RecordHeader) + record.session_id.size() + record.host_id.size() + record.guest_id.size();
+    return (size + 7) & ~std::size_t{7};
+}
+
+std::string SegmentPath(const std::string& directory, std::uint64_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "journal-%06llu.log", static_cast<unsigned long long>(index));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+std::uint64_t SegmentIndexFromName(const std::string& name) {
+    if (name.size() <= kSegmentPrefix.size() + kSegmentSuffix.size() || name.rfind(kSegmentPrefix, 0) != 0 ||
+        name.compare(name.size() - kSegmentSuffix.size(), kSegmentSuffix.size(), kSegmentSuffix) != 0) {
+        return 0;
+    }
+    auto digits = name.substr(kSegmentPrefix.size(), name.size() - kSegmentPrefix.size() - kSegmentSuffix.size());
+    if (digits.find_first_not_of("0123456789") != std::string::npos) return 0;
+    return std::stoull(digits);
+}
+
+} // namespace
+
+struct BattleJournal::Segment {
+    std::uint64_t index = 0;
+    std::string path;
+    char* data = nullptr;
+    std::size_t size = 0;
+    std::size_t written = sizeof(SegmentHeader);  // Guarded by the journal mutex
+    std::size_t flushed = 0;                       // Guarded by the flush mutex
+    std::shared_ptr<JournalSegmentSummary> summary;  // Guarded by the journal mutex
+
+    ~Segment() {
+        if (data) {
+            ::msync(data, size, MS_SYNC);
+            ::munmap(data, size);
+        }
+    }
+};
+
+BattleJournal::BattleJournal(std::string directory, std::size_t segment_size,
+                             std::vector<std::shared_ptr<const JournalSegmentSummary>> earlier_segments)
+    : directory_(std::move(directory)), segment_size_(segment_size), sealed_(std::move(earlier_segments)) {
+    if (segment_size_ < 4096) {
+        throw std::runtime_error("Journal segment size must be at least 4096 bytes");
+    }
+    std::filesystem::create_directories(directory_);
+
+    // Never append to segments from an earlier run; recovery reads them as is
+    auto existing = ListSegments(directory_);
+    if (!existing.empty()) {
+        next_segment_index_ = SegmentIndexFromName(std::filesystem::path(existing.back()).filename().string()) + 1;
+    }
+    // Deleting newer segments while an unknown older one stays could bring
+    // an ended battle back
+    retirable_ = existing.size() == sealed_.size() &&
+                 std::equal(existing.begin(), existing.end(), sealed_.begin(),
+                            [](const std::string& path, const auto& summary) { return path == summary->path; });
+    if (!retirable_) {
+        LOG_WARNING() << "Journal segments in " << directory_ << " were not all recovered; none will be retired";
+        sealed_.clear();
+    }
+    segments_.push_back(OpenSegment(next_segment_index_++));
+    PrepareSegment();
+    LOG_INFO() << "Battle journal opened at " << segments_.back()->path;
+}
+
+BattleJournal::~BattleJournal() = default;  // Segments msync on unmap
+
+std::shared_ptr<BattleJournal::Segment> BattleJournal::OpenSegment(std::uint64_t index) {
+    auto segment = std::make_shared<Segment>();
+    segment->index = index;
+    segment->path = SegmentPath(directory_, index);
+
+    int fd = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create journal segment " + segment->path + ": " + std::strerror(errno));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(segment_size_)) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to size journal segment " + segment->path + ": " + std::strerror(error));
+    }
+    void* data = ::mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Failed to map journal segment " + segment->path + ": " + std::strerror(errno));
+    }
+    segment->data = static_cast<char*>(data);
+    segment->size = segment_size_;
+    segment->summary = std::make_shared<JournalSegmentSummary>();
+    segment->summary->path = segment->path;
+
+    SegmentHeader header;
+    std::memcpy(header.magic, kSegmentMagic, sizeof(kSegmentMagic));
+    header.index = index;
+    std::memcpy(segment->data, &header, sizeof(header));
+    return segment;
+}
+
+void BattleJournal::PrepareSegment() {
+    std::uint64_t index = 0;
+    {
+        std::lock_guard lock(mutex_);
+        if (spare_) return;
+        index = next_segment_index_++;
+    }
+    auto segment = OpenSegment(index);
+    {
+        std::lock_guard lock(mutex_);
+        // Unless a concurrent call got one in first, or a rollover already
+        // went past this index
+        if (!spare_ && index > segments_.back()->index) {
+            spare_ = std::move(segment);
+            return;
+        }
+    }
+    const auto path = segment->path;
+    segment.reset();
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+void BattleJournal::Append(const JournalRecord& record) {
+    const std::size_t size = RecordSize(record);
+    if (size > segment_size_ - sizeof(SegmentHeader) ||
+        record.session_id.size() > std::numeric_limits<std::uint16_t>::max() ||
+        record.host_id.size() > std::numeric_limits<std::uint16_t>::max() ||
+        record.guest_id.size() > std::numeric_limits<std::uint16_t>::max()) {
+        throw std::runtime_error("Journal record too large");
+    }
+    // Never truncated: a replayed action must be the one that was applied
+    constexpr int kArgMin = std::numeric_limits<std::int16_t>::min();
+    constexpr int kArgMax = std::numeric_limits<std::int16_t>::max();
+    if (record.arg0 < kArgMin || record.arg0 > kArgMax || record.arg1 < kArgMin || record.arg1 > kArgMax) {
+        throw std::runtime_error("Journal record argument out of range");
+    }
+
+    RecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.size = static_cast<std::uint32_t>(size);
+    header.type = static_cast<std::uint8_t>(record.type);
+    header.seat = static_cast<std::int8_t>(record.seat);
+    header.arg0 = static_cast<std::int16_t>(record.arg0);
+    header.arg1 = static_cast<std::int16_t>(record.arg1);
+    header.session_id_length = static_cast<std::uint16_t>(record.session_id.size());
+    header.version = record.version;
+    header.seed = record.seed;
+    header.host_id_length = static_cast<std::uint16_t>(record.host_id.size());
+    header.guest_id_length = static_cast<std::uint16_t>(record.guest_id.size());
+
+    std::unique_lock lock(mutex_);
+    while (segments_.back()->written + size > segments_.back()->size) {
+        // The zeroed tail of the old segment reads as its end
+        if (spare_) {
+            segments_.push_back(std::move(spare_));
+            break;
+        }
+        // Rolled over again before a flush opened the next one
+        lock.unlock();
+        PrepareSegment();
+        lock.lock();
+    }
+    Segment* segment = segments_.back().get();
+
+    char* out = segment->data + segment->written;
+    std::memcpy(out, &header, sizeof(header));
+    char* strings = out + sizeof(header);
+    std::memcpy(strings, record.session_id.data(), record.session_id.size());
+    strings += record.session_id.size();
+    std::memcpy(strings, record.host_id.data(), record.host_id.size());
+    strings += record.host_id.size();
+    std::memcpy(strings, record.guest_id.data(), record.guest_id.size());
+    header.checksum = Checksum(out + kChecksumStart, size - kChecksumStart);
+    std::memcpy(out + offsetof(RecordHeader, checksum), &header.checksum, sizeof(header.checksum));
+    segment->written += size;
+    segment->summary->Add(record);
+    appended_records_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BattleJournal::Flush() {
+    struct Range {
+        std::shared_ptr<Segment> segment;
+        std::size_t begin;
+        std::size_t end;
+    };
+    // Retire() flushes too; `flushed` has one writer at a time
+    std::lock_guard flush_lock(flush_mutex_);
+    std::vector<Range> ranges;
+    {
+        std::lock_guard lock(mutex_);
+        for (auto& segment : segments_) {
+            if (segment->written > segment->flushed) {
+                ranges.push_back({segment, segment->flushed, segment->written});
+            }
+        }
+    }
+
+    // msync outside the lock so appends continue during the write-back
+    static const std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    for (auto& range : ranges) {
+        std::size_t begin = range.begin / page_size * page_size;
+        if (::msync(range.segment->data + begin, range.end - begin, MS_SYNC) != 0) {
+            LOG_ERROR() << "Journal flush failed for " << range.segment->path << ": " << std::strerror(errno);
+            continue;
+        }
+        range.segment->flushed = range.end;
+    }
+
+    // Segments that were rolled over and are fully flushed can be unmapped;
+    // only the front ones, so sealed_ stays in order
+    std::unique_lock lock(mutex_);
+    auto done = segments_.begin();
+    while (done != segments_.end() - 1 && (*done)->flushed == (*done)->written) {
+        sealed_.push_back(std::move((*done)->summary));
+        ++done;
+    }
+    segments_.erase(segments_.begin(), done);
+    lock.unlock();
+
+    // Ready for the next rollover, so Append does not open files
+    try {
+        PrepareSegment();
+    } catch (const std::exception& e) {
+        LOG_ERROR() << "Failed to open the next journal segment: " << e.what();
+    }
+}
+
+std::size_t BattleJournal::Retire(
+    const std::function<bool(const std::string& session_id, const JournalSegmentSummary::Battle& battle)>& covered,
+    const std::function<void(const JournalSegmentSummary& segment)>& on_retire) {
+    std::lock_guard retire_lock(retire_mutex_);
+    std::vector<std::shared_ptr<const JournalSegmentSummary>> sealed;
+    {
+        std::lock_guard lock(mutex_);
+        if (!retirable_) return 0;
+        sealed = sealed_;
+    }
+    // Checked without the journal lock: the callbacks look at the battles,
+    // whose locks are taken before this one when appending
+    const auto count = RetirableSegments(sealed, covered);
+    if (count == 0) return 0;
+    for (std::size_t i = 0; i < count; ++i) on_retire(*sealed[i]);
+    // What on_retire appended must be durable before the records it replaces go
+    Flush();
+
+    std::size_t retired = 0;
+    for (; retired < count; ++retired) {
+        std::error_code error;
+        if (!std::filesystem::remove(sealed[retired]->path, error) && error) {
+            // Stop here: deleting newer segments past a kept one is not safe
+            LOG_ERROR() << "Failed to delete journal segment " << sealed[retired]->path << ": " << error.message();
+            break;
+        }
+    }
+    {
+        std::lock_guard lock(mutex_);
+        sealed_.erase(sealed_.begin(), sealed_.begin() + static_cast<std::ptrdiff_t>(retired));
+    }
+    retired_segments_.fetch_add(retired, std::memory_order_relaxed);
+    if (retired > 0) LOG_INFO() << "Retired " << retired << " journal segments";
+    return retired;
+}
+
+std::vector<std::string> BattleJournal::ListSegments(const std::string& directory) {
+    std::vector<std::pair<std::uint64_t, std::string>> found;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        auto index = SegmentIndexFromName(entry.path().filename().string());
+        if (index > 0) found.emplace_back(index, entry.path().string());
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<std::string> paths;
+    for (auto& [index, path] : found) paths.push_back(std::move(path));
+    return paths;
+}
+
+bool BattleJournal::ReadSegment(const std::string& path, const std::function<void(const JournalRecord&)>& on_record) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open journal segment " + path + ": " + std::strerror(errno));
+    }
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) < sizeof(SegmentHeader)) {
+        ::close(fd);
+        return false;
+    }
+    const auto size = static_cast<std::size_t>(file_stat.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map journal segment " + path + ": " + std::strerror(errno));
+    }
+    const char* data = static_cast<const char*>(mapping);
+
+    struct Unmap {
+        void* mapping;
+        std::size_t size;
+        ~Unmap() { ::munmap(mapping, size); }
+    } unmap{mapping, size};
+
+    if (std::memcmp(data, kSegmentMagic, sizeof(kSegmentMagic)) != 0) return false;
+
+    std::size_t offset = sizeof(SegmentHeader);
+    while (offset + sizeof(RecordHeader) <= size) {
+        RecordHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        if (header.size == 0) return true;  // Unused tail
+        if (header.size < sizeof(RecordHeader) || header.size % 8 != 0 || offset + header.size > size ||
+            sizeof(RecordHeader) + header.session_id_length + header.host_id_length + header.guest_id_length >
+                header.size ||
+            Checksum(data + offset + kChecksumStart, header.size - kChecksumStart) != header.checksum) {
+            return false;
+        }
+
+        JournalRecord record;
+        record.type = static_cast<JournalRecordType>(header.type);
+        record.seat = header.seat;
+        record.arg0 = header.arg0;
+        record.arg1 = header.arg1;
+        record.version = header.version;
+        record.seed = header.seed;
+        const char* strings = data + offset + sizeof(RecordHeader);
+        record.session_id = std::string_view(strings, header.session_id_length);
+        strings += header.session_id_length;
+        record.host_id = std::string_view(strings, header.host_id_length);
+        strings += header.host_id_length;
+        record.guest_id = std::string_view(strings, header.guest_id_length);
+        on_record(record);
+        offset += header.size;
+    }
+    return true;
+}
+
+} // namespace cardbattle
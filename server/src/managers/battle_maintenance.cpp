@@ -0,0 +1,288 @@
+#include "../include/managers/battle_maintenance.hpp"
+#include "../include/managers/battle_manager.hpp"
+#include "../include/managers/battle_journal.hpp"
+#include "../include/managers/battle_hibernator.hpp"
+#include "../include/managers/battle_snapshot_writer.hpp"
+#include "../include/battle_state_codec.hpp"
+#include "../sqlite_db.hpp"
+#include <thread>
+#include <userver/components/statistics_storage.hpp>
+#include <userver/engine/async.hpp>
+#include <userver/logging/log.hpp>
+#include <userver/utils/statistics/writer.hpp>
+#include <userver/yaml_config/merge_schemas.hpp>
+
+namespace cardbattle {
+
+extern BattleManager* battle_manager;
+
+BattleMaintenanceComponent::BattleMaintenanceComponent(const userver::components::ComponentConfig& config,
+                                                       const userver::components::ComponentContext& context)
+    : ComponentBase(config, context),
+      battle_manager_(*battle_manager),
+      fs_task_processor_(context.GetTaskProcessor(config["fs-task-processor"].As<std::string>())) {
+
+    // A broken catalog at startup is a deployment error; a missing one means
+    // the built-in cards until the file shows up
+    battle_manager_.SetCardCatalogPath(config["card-catalog-path"].As<std::string>("cards.bin"));
+    if (!battle_manager_.ReloadCardCatalog()) {
+        LOG_WARNING() << "Card catalog file not found, serving built-in cards";
+    }
+
+    userver::utils::PeriodicTask::Settings reload_settings(
+        config["card-catalog-reload-interval"].As<std::chrono::milliseconds>(std::chrono::seconds{5}));
+    reload_settings.task_processor = &fs_task_processor_;
+    catalog_reload_task_.Start("card-catalog-reload", reload_settings, [this] { ReloadCardCatalog(); });
+
+    BattleManager::EvictionSettings eviction_settings;
+    eviction_settings.finished_grace =
+        config["finished-battle-grace"].As<std::chrono::milliseconds>(eviction_settings.finished_grace);
+    eviction_settings.idle_timeout =
+        config["idle-battle-timeout"].As<std::chrono::milliseconds>(eviction_settings.idle_timeout);
+    eviction_settings.hibernate_after =
+        config["hibernate-after"].As<std::chrono::milliseconds>(eviction_settings.hibernate_after);
+    battle_manager_.SetEvictionSettings(eviction_settings);
+    // Before recovery, which starts the clocks of restored battles
+    battle_manager_.SetTurnTimeout(
+        config["turn-timeout"].As<std::chrono::milliseconds>(BattleManager::kDefaultTurnTimeout));
+
+    const auto journal_dir = config["journal-dir"].As<std::string>("");
+    const auto database_path = config["database-path"].As<std::string>("");
+    // What the last run left behind, for retiring its journal segments
+    std::vector<std::shared_ptr<const JournalSegmentSummary>> segment_summaries;
+    std::unordered_map<std::string, std::uint64_t> persisted;
+    if (!journal_dir.empty() || !database_path.empty()) {
+        // Rebuild the battles of the previous run, from their last snapshots
+        // plus the journal, before new actions are recorded; the replay
+        // threads block, so keep them off main
+        unsigned threads = config["recovery-threads"].As<unsigned>(0);
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        recovery_stats_ = userver::engine::AsyncNoSpan(fs_task_processor_, [&] {
+                              auto snapshots = database_path.empty() ? std::vector<BattleState>{}
+                                                                     : LoadSnapshots(database_path);
+                              for (const auto& snapshot : snapshots) {
+                                  persisted.emplace(snapshot.session_id, snapshot.version);
+                              }
+                              return battle_manager_.RecoverBattles(journal_dir, std::move(snapshots), threads,
+                                                                    &segment_summaries);
+                          }).Get();
+    }
+
+    if (!journal_dir.empty()) {
+        journal_ = std::make_shared<BattleJournal>(
+            journal_dir, config["journal-segment-size"].As<std::size_t>(64 * 1024 * 1024),
+            std::move(segment_summaries));
+        battle_manager_.SetJournal(journal_);
+
+        userver::utils::PeriodicTask::Settings flush_settings(
+            config["journal-flush-interval"].As<std::chrono::milliseconds>(std::chrono::milliseconds{100}));
+        flush_settings.task_processor = &fs_task_processor_;
+        journal_flush_task_.Start("battle-journal-flush", flush_settings, [this] { FlushJournal(); });
+    } else {
+        LOG_WARNING() << "No journal-dir configured, battles are not journaled";
+    }
+
+    if (!database_path.empty()) {
+        snapshot_writer_ = std::make_shared<BattleSnapshotWriter>(
+            battle_manager_, std::make_unique<SQLiteDB>(database_path), std::move(persisted));
+        battle_manager_.SetSnapshotWriter(snapshot_writer_);
+
+        userver::utils::PeriodicTask::Settings snapshot_settings(
+            config["snapshot-flush-interval"].As<std::chrono::milliseconds>(std::chrono::seconds{1}));
+        snapshot_settings.task_processor = &fs_task_processor_;
+        snapshot_flush_task_.Start("battle-snapshot-flush", snapshot_settings, [this] { FlushSnapshots(); });
+    }
+
+    // After recovery, which restores battles the hibernator may also hold
+    const auto hibernation_dir = config["hibernation-dir"].As<std::string>("");
+    if (!hibernation_dir.empty()) {
+        battle_manager_.SetHibernator(std::make_shared<BattleHibernator>(hibernation_dir, fs_task_processor_));
+        const auto retention =
+            config["hibernation-retention"].As<std::chrono::seconds>(std::chrono::hours{24 * 7});
+        hibernation_expiry_task_.Start("battle-hibernation-expiry",
+                                       userver::utils::PeriodicTask::Settings(std::chrono::hours{1}),
+                                       [this, retention] { battle_manager_.ExpireHibernated(retention); });
+    }
+
+    // Once the battles are published and the hibernated ones indexed, the
+    // last run's segments may no longer be needed
+    if (journal_) {
+        userver::engine::AsyncNoSpan(fs_task_processor_, [this] { RetireJournalSegments(); }).Get();
+    }
+
+    // Matches the wheel tick; eviction is cheap and stays on main
+    eviction_task_.Start("battle-eviction", userver::utils::PeriodicTask::Settings(std::chrono::seconds{1}),
+                         [this] { battle_manager_.RunEvictions(); });
+    turn_timer_task_.Start("battle-turn-timers",
+                           userver::utils::PeriodicTask::Settings(BattleManager::kTurnTimerTick),
+                           [this] { battle_manager_.RunTurnTimers(); });
+
+    auto& statistics_storage = context.FindComponent<userver::components::StatisticsStorage>().GetStorage();
+    statistics_holder_ = statistics_storage.RegisterWriter(
+        "cardbattle", [this](userver::utils::statistics::Writer& writer) { WriteStatistics(writer); });
+}
+
+BattleMaintenanceComponent::~BattleMaintenanceComponent() {
+    statistics_holder_.Unregister();
+    catalog_reload_task_.Stop();
+    eviction_task_.Stop();
+    turn_timer_task_.Stop();
+    hibernation_expiry_task_.Stop();
+    journal_flush_task_.Stop();
+    snapshot_flush_task_.Stop();
+    // BattleManager keeps the journal and writer for late actions; flush
+    // what we have, off the main task processor
+    userver::engine::AsyncNoSpan(fs_task_processor_, [this] {
+        if (journal_) journal_->Flush();
+        if (snapshot_writer_) FlushSnapshots();
+    }).Get();
+}
+
+void BattleMaintenanceComponent::ReloadCardCatalog() {
+    try {
+        battle_manager_.ReloadCardCatalog();
+    } catch (const std::exception& e) {
+        LOG_ERROR() << "Card catalog reload failed, keeping the current catalog: " << e.what();
+    }
+}
+
+std::vector<BattleState> BattleMaintenanceComponent::LoadSnapshots(const std::string& database_path) {
+    std::vector<BattleState> snapshots;
+    SQLiteDB db(database_path);
+    std::vector<std::vector<std::string>> rows;
+    // Archived battles are finished and stay out of memory
+    if (!db.Query("SELECT b.id, b.state FROM battles b LEFT JOIN sessions s ON s.id = b.session_id "
+                  "WHERE s.status IS NULL OR s.status != 'finished'",
+                  rows)) {
+        // A fresh database has no battles table yet
+        LOG_WARNING() << "Could not read battle snapshots: " << db.GetLastError();
+        return snapshots;
+    }
+    const auto catalog = battle_manager_.GetCardCatalog();
+    for (const auto& row : rows) {
+        try {
+            snapshots.push_back(DecodeBattleState(row[1], catalog));
+        } catch (const std::exception& e) {
+            // Rows from an older format or a catalog that lost cards; the
+            // journal may still restore the battle
+            LOG_WARNING() << "Skipping battle snapshot " << row[0] << ": " << e.what();
+        }
+    }
+    return snapshots;
+}
+
+void BattleMaintenanceComponent::FlushJournal() {
+    journal_->Flush();
+    // Without snapshots only ended battles free segments; nothing else
+    // gives a reason to check
+    if (!snapshot_writer_) RetireJournalSegments();
+}
+
+void BattleMaintenanceComponent::FlushSnapshots() {
+    snapshot_writer_->Flush();
+    if (journal_) RetireJournalSegments();
+}
+
+void BattleMaintenanceComponent::RetireJournalSegments() {
+    try {
+        battle_manager_.RetireJournalSegments();
+    } catch (const std::exception& e) {
+        LOG_ERROR() << "Journal segment retirement failed: " << e.what();
+    }
+}
+
+void BattleMaintenanceComponent::WriteStatistics(userver::utils::statistics::Writer& writer) const {
+    auto battles = writer["battles"];
+    battles["resident"] = battle_manager_.ResidentBattles();
+    battles["evicted-finished"] = battle_manager_.EvictedFinished();
+    battles["evicted-idle"] = battle_manager_.EvictedIdle();
+    battles["hibernated"] = battle_manager_.HibernatedBattles();
+    battles["hibernations"] = battle_manager_.Hibernations();
+    battles["rehydrations"] = battle_manager_.Rehydrations();
+    battles["turn-timers"] = battle_manager_.PendingTurnTimers();
+    battles["turn-timeouts"] = battle_manager_.TurnTimeouts();
+    auto recovery = writer["recovery"];
+    recovery["duration-ms"] = recovery_stats_.duration.count();
+    recovery["battles"] = recovery_stats_.battles;
+    recovery["failed"] = recovery_stats_.failed;
+    recovery["journal-records"] = recovery_stats_.records;
+    if (journal_) {
+        auto journal = writer["journal"];
+        journal["appended-records"] = journal_->AppendedRecords();
+        journal["retired-segments"] = journal_->RetiredSegments();
+    }
+    if (snapshot_writer_) {
+        auto snapshots = writer["snapshots"];
+        snapshots["dirty"] = snapshot_writer_->DirtyCount();
+        snapshots["written"] = snapshot_writer_->WrittenCount();
+        snapshots["archived"] = snapshot_writer_->ArchivedCount();
+        snapshots["failed-flushes"] = snapshot_writer_->FailedFlushes();
+    }
+}
+
+userver::yaml_config::Schema BattleMaintenanceComponent::GetStaticConfigSchema() {
+    return userver::yaml_config::MergeSchemas<userver::components::ComponentBase>(R"(
+type: object
+description: Background upkeep for in-memory battles
+additionalProperties: false
+properties:
+    fs-task-processor:
+        type: string
+        description: task processor for file work
+    card-catalog-path:
+        type: string
+        description: compiled card catalog (cards.bin) to serve and watch for changes
+        defaultDescription: cards.bin
+    card-catalog-reload-interval:
+        type: string
+        description: how often to check the card catalog file for changes
+        defaultDescription: 5s
+    finished-battle-grace:
+        type: string
+        description: how long a finished battle stays in memory before it is archived
+        defaultDescription: 1m
+    idle-battle-timeout:
+        type: string
+        description: how long a running battle with no connected players and no actions stays in memory
+        defaultDescription: 10m
+    turn-timeout:
+        type: string
+        description: how long a player may take over a turn before it is ended for them, 0s for no turn clock (not with battle-bot)
+        defaultDescription: 90s
+    hibernate-after:
+        type: string
+        description: with hibernation-dir, how long a running battle may go untouched before it is moved to disk
+        defaultDescription: 2m
+    hibernation-dir:
+        type: string
+        description: directory for hibernated battles; idle battles stay in memory if unset
+    hibernation-retention:
+        type: string
+        description: how long a hibernated battle is kept before it is ended
+        defaultDescription: 168h
+    journal-dir:
+        type: string
+        description: directory for battle journal segments; journaling is off if unset
+    journal-segment-size:
+        type: integer
+        description: size of one journal segment file in bytes
+        defaultDescription: 67108864
+    journal-flush-interval:
+        type: string
+        description: how often appended journal records are flushed to disk
+        defaultDescription: 100ms
+    database-path:
+        type: string
+        description: SQLite database for battle snapshots; snapshots are off if unset
+    snapshot-flush-interval:
+        type: string
+        description: how often changed battles are written to the database
+        defaultDescription: 1s
+    recovery-threads:
+        type: integer
+        description: threads used to replay the journal at startup, 0 for one per core
+        defaultDescription: 0
+)");
+}
+
+} // namespace cardbattle
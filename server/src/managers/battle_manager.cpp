@@ -1,4 +1,6 @@
 #include "../include/managers/battle_manager.hpp"
+#include "../include/battle_rules.hpp"
+#include "../include/battle_state_codec.hpp"
 #include "../include/utils.hpp"
 #include "../sqlite_db.hpp"
 #include "../include/types.hpp"
@@ -8,8 +10,9 @@
 #include <string>
 #include <stdexcept>
 #include <chrono>
-#include <userver/formats/json.hpp>
-#include <userver/formats/json/value_builder.hpp>
+#include <functional>
+#include <mutex>
+#include <sys/stat.h>
 #include <userver/logging/log.hpp>
 
 namespace cardbattle {
@@ -17,12 +20,28 @@ namespace cardbattle {
 // Global managers (in a real app, these would be dependency injected)
 extern GameSessionManager* session_manager;
 
-BattleManager::BattleManager() {
-    // Initialize with some default cards
-    InitializeDefaultCards();
+BattleManager::BattleManager()
+    // Fallback until a compiled catalog is loaded
+    : card_catalog_(MakeBuiltinCardCatalog()),
+      // Level 0 covers a minute, the top level days
+      eviction_wheel_(std::chrono::seconds{1}, 64, 3),
+      finished_grace_ms_(EvictionSettings{}.finished_grace.count()),
+      idle_timeout_ms_(EvictionSettings{}.idle_timeout.count()),
+      hibernate_after_ms_(EvictionSettings{}.hibernate_after.count()),
+      // Level 0 covers 6.4s, level 1 about 7 minutes
+      turn_wheel_(kTurnTimerTick, 64, 4),
+      turn_timeout_ms_(std::chrono::milliseconds{kDefaultTurnTimeout}.count()) {
+    // The only read of the entropy source; battle seeds are derived from it
+    std::random_device rd;
+    next_seed_ = (std::uint64_t{rd()} << 32) | rd();
+    LOG_INFO() << "Initialized default cards, count: " << GetCardCatalog()->Size();
 }
 
 std::string BattleManager::StartBattle(const std::string& session_id) {
+    return StartBattle(session_id, NewBattleSeed());
+}
+
+std::string BattleManager::StartBattle(const std::string& session_id, std::uint64_t seed) {
     try {
         auto session = session_manager->GetSession(session_id);
         // Ensure both players are present
@@ -30,53 +49,43 @@ std::string BattleManager::StartBattle(const std::string& session_id) {
             throw std::runtime_error("Cannot start battle: both host and guest must be present in the session");
         }
         
-        // Create battle state
-        BattleState battle_state;
-        battle_state.session_id = session_id;
-        battle_state.current_turn = session.host_id; // Host goes first
-        battle_state.turn_number = 1;
-        battle_state.is_finished = false;
-        battle_state.last_action = "Battle started";
-        
-        // Initialize host player
-        PlayerState host_state;
-        host_state.player_id = session.host_id;
-        host_state.health = 30;
-        host_state.max_health = 30;
-        host_state.mana = 1; // Start with 1 mana
-        host_state.max_mana = 1;
-        host_state.is_active = true;
-        
-        // Initialize guest player
-        PlayerState guest_state;
-        guest_state.player_id = session.guest_id;
-        guest_state.health = 30;
-        guest_state.max_health = 30;
-        guest_state.mana = 1;
-        guest_state.max_mana = 1;
-        guest_state.is_active = false;
-        
-        // Store player states in battle state first
-        battle_state.players[session.host_id] = host_state;
-        battle_state.players[session.guest_id] = guest_state;
-        
-        // Initialize decks for both players (after storing player states)
-        InitializePlayerDeck(battle_state, session.host_id);
-        InitializePlayerDeck(battle_state, session.guest_id);
+        BattleState battle_state = NewBattleState(session_id, session.host_id, session.guest_id, seed, GetCardCatalog());
         
         LOG_INFO() << "Before saving battle state for session " << session_id << ":";
-        for (const auto& pair : battle_state.players) {
-            const std::string& player_id = pair.first;
-            const PlayerState& player = pair.second;
-            LOG_INFO() << "  Player " << player_id << ": hand size=" << player.hand.size() 
+        for (const auto& player : battle_state.players) {
+            LOG_INFO() << "  Player " << player.player_id << ": hand size=" << player.hand.size() 
                        << ", deck size=" << player.deck.size() 
                        << ", field size=" << player.field.size() 
                        << ", graveyard size=" << player.graveyard.size();
         }
         
-        active_battles_[session_id] = battle_state;
+        auto battle = std::make_shared<ResidentBattle>(std::move(battle_state));
+        const auto now_ms = NowMs();
+        battle->last_access_ms = now_ms;
+        
+        auto& shard = GetShard(session_id);
+        {
+            std::lock_guard lock(shard.mutex);
+            // Both players can race to start the battle; the first one wins
+            if (!shard.battles.try_emplace(session_id, std::move(battle)).second) {
+                LOG_INFO() << "Battle already started for session: " << session_id;
+                return session_id;
+            }
+            resident_battles_.fetch_add(1, std::memory_order_relaxed);
+            ScheduleEviction(session_id, now_ms + IdleDelayMs());
+            StartTurnClock(session_id, *shard.battles.at(session_id));
+            // Under the shard lock, so no action on this battle can be
+            // journaled before its start
+            JournalRecord record{JournalRecordType::BATTLE_STARTED};
+            record.session_id = session_id;
+            record.seed = seed;
+            record.host_id = session.host_id;
+            record.guest_id = session.guest_id;
+            AppendToJournal(record);
+        }
+        if (snapshot_writer_) snapshot_writer_->MarkDirty(session_id);
         
-        LOG_INFO() << "Battle started for session: " << session_id;
+        LOG_INFO() << "Battle started for session: " << session_id << ", seed: " << seed;
         
         return session_id;
     } catch (const std::exception& e) {
@@ -85,218 +94,43 @@ std::string BattleManager::StartBattle(const std::string& session_id) {
     }
 }
 
-void BattleManager::PlayCard(const std::string& session_id, const std::string& player_id, int hand_index) {
-    auto& battle_state = active_battles_[session_id];
-    auto& player_state = battle_state.players[player_id];
-    
-    // Check if it's the player's turn
-    if (battle_state.current_turn != player_id) {
-        throw std::runtime_error("Not your turn");
-    }
-    
-    // Check if hand index is valid
-    if (hand_index < 0 || hand_index >= static_cast<int>(player_state.hand.size())) {
-        throw std::runtime_error("Invalid hand index");
-    }
-    
-    Card card_to_play = player_state.hand[hand_index];
-    
-    // Check if player has enough mana
-    if (player_state.mana < card_to_play.mana_cost) {
-        throw std::runtime_error("Not enough mana");
-    }
-    
-    // Remove card from hand
-    player_state.hand.erase(player_state.hand.begin() + hand_index);
-    
-    // Spend mana
-    player_state.mana -= card_to_play.mana_cost;
-    
-    // Play the card based on its type
-    if (card_to_play.type == CardType::CREATURE) {
-        // Add creature to field (reset used_this_turn flag for new cards)
-        card_to_play.used_this_turn = false;
-        player_state.field.push_back(card_to_play);
-        battle_state.last_action = player_id + " played " + card_to_play.name;
-    } else if (card_to_play.type == CardType::SPELL) {
-        // Handle spell effects
-        HandleSpellEffect(battle_state, player_id, card_to_play);
-    }
-    
-    LOG_INFO() << "Card played: " << card_to_play.name << " by " << player_id;
-    
-    // Save updated state
-    SaveBattleState(session_id, battle_state);
+void BattleManager::PlayCard(const std::string& session_id, int seat, int hand_index) {
+    JournalRecord record{JournalRecordType::PLAY_CARD, seat, hand_index};
+    RunAction(session_id, [&](BattleState& battle_state) {
+        ApplyPlayCard(battle_state, seat, hand_index);
+        LOG_INFO() << "Card played by " << battle_state.players[seat].player_id;
+    }, &record);
 }
 
-void BattleManager::Attack(const std::string& session_id, const std::string& attacker_id, int attacker_index, int target_index) {
-    auto& battle_state = active_battles_[session_id];
-    auto& attacker_state = battle_state.players[attacker_id];
-    
-    // Check if it's the attacker's turn
-    if (battle_state.current_turn != attacker_id) {
-        throw std::runtime_error("Not your turn");
-    }
-    
-    // Check if attacker index is valid
-    if (attacker_index < 0 || attacker_index >= static_cast<int>(attacker_state.field.size())) {
-        throw std::runtime_error("Invalid attacker index");
-    }
-    
-    // Find the opponent
-    std::string opponent_id;
-    for (const auto& pair : battle_state.players) {
-        if (pair.first != attacker_id) {
-            opponent_id = pair.first;
-            break;
-        }
-    }
-    
-    auto& opponent_state = battle_state.players[opponent_id];
-    
-    Card& attacker_card = attacker_state.field[attacker_index];
-    
-    // Check if the card has already been used this turn
-    if (attacker_card.used_this_turn) {
-        throw std::runtime_error("Card has already been used this turn");
-    }
-    
-    if (target_index >= 0 && target_index < static_cast<int>(opponent_state.field.size())) {
-        // Attack opponent's creature
-        Card& target_card = opponent_state.field[target_index];
-        
-        // Apply damage
-        target_card.defense -= attacker_card.attack;
-        attacker_card.defense -= target_card.attack;
-        
-        battle_state.last_action = attacker_id + "'s " + attacker_card.name + " attacked " + opponent_id + "'s " + target_card.name;
-        
-        // Mark the attacker card as used this turn
-        attacker_card.used_this_turn = true;
-        
-        // Remove dead creatures
-        if (target_card.defense <= 0) {
-            opponent_state.field.erase(opponent_state.field.begin() + target_index);
-            opponent_state.graveyard.push_back(target_card);
-        }
-        
-        if (attacker_card.defense <= 0) {
-            attacker_state.field.erase(attacker_state.field.begin() + attacker_index);
-            attacker_state.graveyard.push_back(attacker_card);
-        }
-        
-    } else {
-        // Attack opponent directly
-        opponent_state.health -= attacker_card.attack;
-        battle_state.last_action = attacker_id + "'s " + attacker_card.name + " attacked " + opponent_id + " directly";
-        
-        // Mark the attacker card as used this turn
-        attacker_card.used_this_turn = true;
-        
-        // Check for game over
-        if (opponent_state.health <= 0) {
-            EndGame(battle_state, attacker_id);
+void BattleManager::Attack(const std::string& session_id, int attacker_seat, int attacker_index, int target_index) {
+    JournalRecord record{JournalRecordType::ATTACK, attacker_seat, attacker_index, target_index};
+    RunAction(session_id, [&](BattleState& battle_state) {
+        // Any target off the opponent's field hits the hero. Journal it as
+        // kNoSeat: the record keeps 16-bit arguments, and a truncated
+        // client index could name a creature on replay.
+        if (attacker_seat == 0 || attacker_seat == 1) {
+            const auto& opponent_field = battle_state.players[OpponentSeat(attacker_seat)].field;
+            if (target_index < 0 || target_index >= static_cast<int>(opponent_field.size())) record.arg1 = kNoSeat;
         }
-    }
-    
-    LOG_INFO() << "Attack executed: " << battle_state.last_action;
-    
-    // Save updated state
-    SaveBattleState(session_id, battle_state);
+        ApplyAttack(battle_state, attacker_seat, attacker_index, record.arg1);
+        LOG_INFO() << "Attack executed: " << battle_state.last_action;
+    }, &record);
 }
 
-void BattleManager::EndTurn(const std::string& session_id, const std::string& player_id) {
-    auto& battle_state = active_battles_[session_id];
-    
-    // Check if it's the player's turn
-    if (battle_state.current_turn != player_id) {
-        throw std::runtime_error("Not your turn");
-    }
-    
-    // Find the next player
-    std::string next_player_id;
-    for (const auto& pair : battle_state.players) {
-        if (pair.first != player_id) {
-            next_player_id = pair.first;
-            break;
-        }
-    }
-    
-    // Switch turns
-    battle_state.current_turn = next_player_id;
-    battle_state.turn_number++;
-    
-    // Update player states for new turn
-    for (auto& pair : battle_state.players) {
-        auto& player_state = pair.second;
-        player_state.is_active = (pair.first == next_player_id);
-        
-        // Reset used_this_turn flag for all cards on the field
-        for (auto& card : player_state.field) {
-            card.used_this_turn = false;
-        }
-        
-        if (player_state.is_active) {
-            // Increase mana for the active player
-            player_state.max_mana = std::min(10, battle_state.turn_number);
-            player_state.mana = player_state.max_mana;
-            
-            // Draw a card
-            if (!player_state.deck.empty()) {
-                player_state.hand.push_back(player_state.deck.back());
-                player_state.deck.pop_back();
-            }
-        }
-    }
-    
-    // Check for deck exhaustion (both players have no cards in deck and hand)
-    bool both_players_exhausted = true;
-    for (const auto& pair : battle_state.players) {
-        const auto& player_state = pair.second;
-        if (!player_state.deck.empty() || !player_state.hand.empty()) {
-            both_players_exhausted = false;
-            break;
-        }
-    }
-    
-    if (both_players_exhausted) {
-        // Find the player with more health
-        std::string winner_id;
-        int max_health = -1;
-        
-        for (const auto& pair : battle_state.players) {
-            const auto& player_state = pair.second;
-            if (player_state.health > max_health) {
-                max_health = player_state.health;
-                winner_id = pair.first;
-            }
-        }
-        
-        // End the game with the player who has more health as winner
-        EndGame(battle_state, winner_id);
-        battle_state.last_action = "Game ended by deck exhaustion! " + winner_id + " wins with " + std::to_string(max_health) + " health!";
-    }
-    
-    battle_state.last_action = "Turn ended, " + next_player_id + "'s turn";
-    
-    LOG_INFO() << "Turn ended: " << battle_state.last_action;
-    
-    // Save updated state
-    SaveBattleState(session_id, battle_state);
+void BattleManager::EndTurn(const std::string& session_id, int seat) {
+    JournalRecord record{JournalRecordType::END_TURN, seat};
+    RunAction(session_id, [&](BattleState& battle_state) {
+        ApplyEndTurn(battle_state, seat);
+        LOG_INFO() << "Turn ended: " << battle_state.last_action;
+    }, &record);
 }
 
-BattleState BattleManager::GetBattleState(const std::string& session_id) {
-    auto it = active_battles_.find(session_id);
-    if (it == active_battles_.end()) {
-        throw std::runtime_error("Battle not found for session: " + session_id);
-    }
+std::shared_ptr<const BattleState> BattleManager::GetBattleState(const std::string& session_id) {
+    auto state = FindBattle(session_id)->actor.Snapshot();
     
-    const BattleState& state = it->second;
-    LOG_INFO() << "GetBattleState for session " << session_id << ":";
-    for (const auto& pair : state.players) {
-        const std::string& player_id = pair.first;
-        const PlayerState& player = pair.second;
-        LOG_INFO() << "  Player " << player_id << ": hand size=" << player.hand.size() 
+    LOG_INFO() << "GetBattleState for session " << session_id << " (version " << state->version << "):";
+    for (const auto& player : state->players) {
+        LOG_INFO() << "  Player " << player.player_id << ": hand size=" << player.hand.size() 
                    << ", deck size=" << player.deck.size() 
                    << ", field size=" << player.field.size() 
                    << ", graveyard size=" << player.graveyard.size();
@@ -305,6 +139,35 @@ BattleState BattleManager::GetBattleState(const std::string& session_id) {
     return state;
 }
 
+std::shared_ptr<const BattleState> BattleManager::PeekBattleState(const std::string& session_id) {
+    std::shared_ptr<ResidentBattle> battle;
+    {
+        auto& shard = GetShard(session_id);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.battles.find(session_id);
+        if (it == shard.battles.end()) return nullptr;
+        battle = it->second;
+    }
+    return battle->actor.Snapshot();
+}
+
+std::shared_ptr<const std::string> BattleManager::GetBattlePayload(const std::string& session_id,
+                                                                   std::size_t format) {
+    return FindBattle(session_id)->actor.Payload(format, state_formats_.at(format).full);
+}
+
+bool BattleManager::HasBattle(const std::string& session_id) {
+    auto& shard = GetShard(session_id);
+    std::lock_guard lock(shard.mutex);
+    return shard.battles.count(session_id) > 0 || shard.hibernated.count(session_id) > 0;
+}
+
+bool BattleManager::IsHibernated(const std::string& session_id) {
+    auto& shard = GetShard(session_id);
+    std::lock_guard lock(shard.mutex);
+    return shard.hibernated.count(session_id) > 0;
+}
+
 std::string BattleManager::GenerateId() {
     static const char* chars = "0123456789abcdef";
     std::string id;
@@ -315,284 +178,617 @@ std::string BattleManager::GenerateId() {
     return id;
 }
 
-void BattleManager::InitializePlayerDeck(BattleState& battle, const std::string& player_id) {
-    // Use a simple prespecified deck for all players
-    std::vector<std::string> deck_card_ids = {
-        "card_001", "card_002", "card_003", "card_004", "card_005",
-        "card_006", "card_007", "card_008", "card_009", "card_010"
-    };
+void BattleManager::Surrender(const std::string& session_id, int seat) {
+    JournalRecord record{JournalRecordType::SURRENDER, seat};
+    RunAction(session_id, [&](BattleState& battle_state) {
+        ApplySurrender(battle_state, seat);
+        LOG_INFO() << battle_state.last_action;
+    }, &record);
+}
+
+int BattleManager::SeatInSession(const GameSession& session, const std::string& user_id) {
+    // StartBattle seats the host first
+    if (!user_id.empty() && user_id == session.host_id) return kHostSeat;
+    if (!user_id.empty() && user_id == session.guest_id) return kGuestSeat;
+    return kNoSeat;
+}
+
+std::vector<Card> BattleManager::LoadDeckCards(const std::vector<std::string>& card_ids) {
+    std::vector<Card> cards;
+    auto catalog = GetCardCatalog();
     
-    // Convert card IDs to actual cards using default_cards_
-    for (const auto& card_id : deck_card_ids) {
-        auto card_it = std::find_if(default_cards_.begin(), default_cards_.end(),
-                                   [&card_id](const Card& card) { return card.id == card_id; });
-        if (card_it != default_cards_.end()) {
-            battle.players[player_id].deck.push_back(*card_it);
+    for (const auto& card_id : card_ids) {
+        if (auto index = catalog->Find(card_id)) {
+            cards.push_back(catalog->Instantiate(*index));
         } else {
-            LOG_ERROR() << "Card not found in default_cards_: " << card_id;
+            // Cards can only be instances of catalog definitions
+            LOG_ERROR() << "Card not found in card catalog: " << card_id;
         }
     }
     
-    // Shuffle the deck
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(battle.players[player_id].deck.begin(), battle.players[player_id].deck.end(), g);
-    
-    // Draw initial hand
-    battle.players[player_id].hand = DrawInitialHand(battle.players[player_id].deck);
-    LOG_INFO() << "Initialized deck for player " << player_id << ", deck size: " << battle.players[player_id].deck.size() << ", hand size: " << battle.players[player_id].hand.size();
+    return cards;
 }
 
-void BattleManager::DrawCards(BattleState& battle, const std::string& player_id, int count) {
-    auto& deck = battle.players[player_id].deck;
-    auto& hand = battle.players[player_id].hand;
-    
-    for (int i = 0; i < count && !deck.empty(); ++i) {
-        hand.push_back(deck.back());
-        deck.pop_back();
+void BattleManager::EndBattle(const std::string& session_id) {
+    if (RemoveBattle(session_id, false)) {
+        LOG_INFO() << "Battle ended for session: " << session_id;
+    }
+}
+
+std::size_t BattleManager::RunEvictions() {
+    std::vector<std::string> expired;
+    {
+        std::lock_guard lock(eviction_mutex_);
+        expired = eviction_wheel_.Advance(TimerWheel::Clock::now());
+    }
+    // Outside the wheel lock: evicting takes shard locks, which are taken
+    // before the wheel lock elsewhere
+    std::size_t evicted = 0;
+    const auto now_ms = NowMs();
+    for (const auto& session_id : expired) {
+        if (TryEvict(session_id, now_ms)) ++evicted;
+    }
+    return evicted;
+}
+
+void BattleManager::SetEvictionSettings(const EvictionSettings& settings) {
+    finished_grace_ms_ = settings.finished_grace.count();
+    idle_timeout_ms_ = settings.idle_timeout.count();
+    hibernate_after_ms_ = settings.hibernate_after.count();
+}
+
+void BattleManager::SetTurnTimeout(std::chrono::milliseconds timeout) {
+    turn_timeout_ms_ = timeout.count();
+}
+
+std::size_t BattleManager::RunTurnTimers() {
+    std::vector<std::string> expired;
+    {
+        std::lock_guard lock(turn_timer_mutex_);
+        expired = turn_wheel_.Advance(TimerWheel::Clock::now());
+    }
+    // Outside the wheel lock, like RunEvictions: ending a turn schedules
+    // the next turn's timer
+    std::size_t timed_out = 0;
+    const auto now_ms = NowMs();
+    for (const auto& session_id : expired) {
+        if (ExpireTurn(session_id, now_ms)) ++timed_out;
     }
+    return timed_out;
 }
 
-void BattleManager::HandleSpellEffect(BattleState& battle_state, const std::string& player_id, const Card& spell) {
-    if (spell.name == "Lightning Bolt") {
-        // Deal 3 damage to opponent
-        std::string opponent_id;
-        for (const auto& pair : battle_state.players) {
-            if (pair.first != player_id) {
-                opponent_id = pair.first;
-                break;
+std::size_t BattleManager::PendingTurnTimers() {
+    std::lock_guard lock(turn_timer_mutex_);
+    return turn_wheel_.Size();
+}
+
+void BattleManager::StartTurnClock(const std::string& session_id, ResidentBattle& battle) {
+    const auto turn_timeout_ms = turn_timeout_ms_.load(std::memory_order_relaxed);
+    if (turn_timeout_ms <= 0 || battle.finished_at_ms.load(std::memory_order_acquire) != 0) return;
+    const auto deadline_ms = NowMs() + turn_timeout_ms;
+    battle.turn_deadline_ms.store(deadline_ms, std::memory_order_release);
+    ScheduleTurnTimer(session_id, deadline_ms);
+}
+
+void BattleManager::ScheduleTurnTimer(const std::string& session_id, std::int64_t deadline_ms) {
+    const TimerWheel::Clock::time_point deadline{std::chrono::milliseconds{deadline_ms}};
+    std::lock_guard lock(turn_timer_mutex_);
+    turn_wheel_.Schedule(deadline, session_id);
+}
+
+bool BattleManager::ExpireTurn(const std::string& session_id, std::int64_t now_ms) {
+    std::shared_ptr<ResidentBattle> battle;
+    {
+        // Not FindBattle: a timeout must neither rehydrate a battle nor keep
+        // it from going idle
+        auto& shard = GetShard(session_id);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.battles.find(session_id);
+        if (it == shard.battles.end()) return false;
+        battle = it->second;
+    }
+    // Every new turn schedules its own timer, so a timer that finds a later
+    // deadline (or none) belongs to a turn that is over
+    const auto deadline_ms = battle->turn_deadline_ms.load(std::memory_order_acquire);
+    if (deadline_ms == 0 || now_ms < deadline_ms) return false;
+
+    JournalRecord record{JournalRecordType::END_TURN};
+    try {
+        ExecuteAction(session_id, battle, [&](BattleState& battle_state) {
+            {
+                // Hibernation and idle eviction drop the battle from inside
+                // its actor, so if it is still mapped here neither can drop
+                // it before this action is journaled
+                auto& shard = GetShard(session_id);
+                std::lock_guard lock(shard.mutex);
+                auto it = shard.battles.find(session_id);
+                if (it == shard.battles.end() || it->second != battle) {
+                    throw std::runtime_error("Battle no longer resident");
+                }
             }
-        }
-        
-        auto& opponent_state = battle_state.players[opponent_id];
-        opponent_state.health -= 3;
-        
-        if (opponent_state.health <= 0) {
-            EndGame(battle_state, player_id);
-        }
-        
-    } else if (spell.name == "Healing Potion") {
-        // Restore 4 health
-        auto& player_state = battle_state.players[player_id];
-        player_state.health = std::min(player_state.max_health, player_state.health + 4);
-        
-    } else if (spell.name == "Magic Shield") {
-        // Gain 3 defense (add to player's health)
-        auto& player_state = battle_state.players[player_id];
-        player_state.health = std::min(player_state.max_health, player_state.health + 3);
+            // The player may have ended the turn since we looked
+            if (battle_state.is_finished || battle->turn_deadline_ms.load(std::memory_order_relaxed) != deadline_ms) {
+                throw std::runtime_error("Turn already ended");
+            }
+            const auto timed_out_player = battle_state.CurrentPlayerId();
+            record.seat = battle_state.current_seat;
+            ApplyEndTurn(battle_state, battle_state.current_seat);
+            if (!battle_state.is_finished) {
+                battle_state.last_action =
+                    timed_out_player + " ran out of time, " + battle_state.CurrentPlayerId() + "'s turn";
+            }
+        }, &record);
+    } catch (const std::exception&) {
+        return false;
     }
+    turn_timeouts_.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO() << "Turn timed out in battle " << session_id;
+    return true;
 }
 
-void BattleManager::Surrender(const std::string& session_id, const std::string& player_id) {
-    auto& battle_state = active_battles_[session_id];
-    
-    // Find the opponent
-    std::string opponent_id;
-    for (const auto& pair : battle_state.players) {
-        if (pair.first != player_id) {
-            opponent_id = pair.first;
-            break;
+std::int64_t BattleManager::IdleDelayMs() const {
+    return hibernator_ ? hibernate_after_ms_.load(std::memory_order_relaxed)
+                       : idle_timeout_ms_.load(std::memory_order_relaxed);
+}
+
+void BattleManager::ScheduleEviction(const std::string& session_id, std::int64_t deadline_ms) {
+    const TimerWheel::Clock::time_point deadline{std::chrono::milliseconds{deadline_ms}};
+    std::lock_guard lock(eviction_mutex_);
+    eviction_wheel_.Schedule(deadline, session_id);
+}
+
+bool BattleManager::TryEvict(const std::string& session_id, std::int64_t now_ms) {
+    auto& shard = GetShard(session_id);
+    std::shared_ptr<ResidentBattle> battle;
+    {
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.battles.find(session_id);
+        if (it == shard.battles.end()) return false;  // Already gone
+        battle = it->second;
+    }
+
+    const auto finished_at_ms = battle->finished_at_ms.load(std::memory_order_acquire);
+    if (finished_at_ms != 0) {
+        const auto due_ms = finished_at_ms + finished_grace_ms_.load(std::memory_order_relaxed);
+        if (now_ms < due_ms) {
+            ScheduleEviction(session_id, due_ms);
+            return false;
         }
+        if (!RemoveBattle(session_id, true)) return false;
+        evicted_finished_.fetch_add(1, std::memory_order_relaxed);
+        LOG_INFO() << "Evicted finished battle " << session_id;
+        return true;
     }
-    
-    // End the game with the opponent as winner
-    EndGame(battle_state, opponent_id);
-    battle_state.last_action = "Player " + player_id + " surrendered. " + opponent_id + " wins!";
-    
-    LOG_INFO() << "Player " << player_id << " surrendered. " << opponent_id << " wins!";
-    
-    // Save updated state
-    SaveBattleState(session_id, battle_state);
+
+    if (hibernator_) {
+        // Idle battles go to disk whether or not anyone is connected; a
+        // returning player brings them back with the next lookup
+        const auto hibernate_after_ms = hibernate_after_ms_.load(std::memory_order_relaxed);
+        const auto last_access_ms = battle->last_access_ms.load(std::memory_order_relaxed);
+        if (now_ms - last_access_ms < hibernate_after_ms) {
+            ScheduleEviction(session_id, last_access_ms + hibernate_after_ms);
+            return false;
+        }
+        return Hibernate(session_id, battle, last_access_ms);
+    }
+
+    // Asked without holding the shard lock, the probe takes the handler's
+    const auto idle_timeout_ms = idle_timeout_ms_.load(std::memory_order_relaxed);
+    if (presence_probe_ && presence_probe_(session_id)) {
+        ScheduleEviction(session_id, now_ms + idle_timeout_ms);
+        return false;
+    }
+    bool evicted = false;
+    // Inside the actor, so a turn timeout (which does not count as an
+    // access) is either journaled before this or finds the battle gone
+    battle->actor.Execute([&](BattleState&) {
+        // Lookups bump last_access_ms under this lock, so an action either
+        // saw the battle and made it recent, or comes after and finds nothing
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.battles.find(session_id);
+        if (it == shard.battles.end() || it->second != battle) return;
+        // A battle that finished meanwhile has its own timer
+        if (battle->finished_at_ms.load(std::memory_order_acquire) != 0) return;
+        const auto last_access_ms = battle->last_access_ms.load(std::memory_order_relaxed);
+        if (now_ms - last_access_ms < idle_timeout_ms) {
+            ScheduleEviction(session_id, last_access_ms + idle_timeout_ms);
+            return;
+        }
+        shard.battles.erase(it);
+        resident_battles_.fetch_sub(1, std::memory_order_relaxed);
+        JournalRecord record{JournalRecordType::BATTLE_ENDED};
+        record.session_id = session_id;
+        AppendToJournal(record);
+        evicted = true;
+    });
+    if (!evicted) return false;
+    if (snapshot_writer_) snapshot_writer_->MarkDirty(session_id);
+    evicted_idle_.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO() << "Evicted abandoned battle " << session_id;
+    return true;
 }
 
-void BattleManager::EndGame(BattleState& battle_state, const std::string& winner_id) {
-    battle_state.winner = winner_id;
-    battle_state.is_finished = true;
-    battle_state.last_action = "Game over! " + winner_id + " wins!";
-    
-    LOG_INFO() << "Game ended: " << battle_state.last_action;
+bool BattleManager::Hibernate(const std::string& session_id, const std::shared_ptr<ResidentBattle>& battle,
+                              std::int64_t last_access_ms) {
+    // Written while still resident; only a battle nobody touched meanwhile
+    // is dropped, so the file is never behind the battle it replaces
+    auto state = battle->actor.Snapshot();
+    try {
+        hibernator_->Store(session_id, EncodeBattleState(*state));
+    } catch (const std::exception& e) {
+        LOG_ERROR() << "Failed to hibernate battle " << session_id << ": " << e.what();
+        ScheduleEviction(session_id, NowMs() + hibernate_after_ms_.load(std::memory_order_relaxed));
+        return false;
+    }
+
+    auto& shard = GetShard(session_id);
+    bool hibernated = false;
+    // Inside the actor: a turn timeout changes the state without counting
+    // as an access, so the version is what tells whether the file is current
+    battle->actor.Execute([&](BattleState& battle_state) {
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.battles.find(session_id);
+        if (it == shard.battles.end() || it->second != battle) return;
+        if (battle->finished_at_ms.load(std::memory_order_acquire) != 0) return;  // Has its own timer
+        const auto current_access_ms = battle->last_access_ms.load(std::memory_order_relaxed);
+        if (current_access_ms != last_access_ms) {
+            ScheduleEviction(session_id, current_access_ms + hibernate_after_ms_.load(std::memory_order_relaxed));
+            return;
+        }
+        if (battle_state.version != state->version) {
+            // Still idle, only the file is behind: store it again
+            ScheduleEviction(session_id, NowMs());
+            return;
+        }
+        shard.battles.erase(it);
+        shard.hibernated.insert_or_assign(session_id, battle_state.catalog);
+        resident_battles_.fetch_sub(1, std::memory_order_relaxed);
+        hibernated_battles_.fetch_add(1, std::memory_order_relaxed);
+        hibernations_.fetch_add(1, std::memory_order_relaxed);
+        JournalRecord record{JournalRecordType::BATTLE_HIBERNATED};
+        record.session_id = session_id;
+        record.version = state->version;
+        AppendToJournal(record);
+        hibernated = true;
+    });
+    if (hibernated) LOG_INFO() << "Hibernated idle battle " << session_id << " at version " << state->version;
+    return hibernated;
 }
 
-std::vector<Card> BattleManager::LoadDeckCards(const std::vector<std::string>& card_ids) {
-    std::vector<Card> cards;
-    
-    for (const auto& card_id : card_ids) {
-        // Try to find the card in default cards first
-        auto it = std::find_if(default_cards_.begin(), default_cards_.end(),
-                              [&card_id](const Card& card) { return card.id == card_id; });
-        
-        if (it != default_cards_.end()) {
-            cards.push_back(*it);
-        } else {
-            // If not found, create a placeholder card
-            Card placeholder(card_id, "Unknown Card", "Card not found", 1, 1, 1, CardType::CREATURE);
-            cards.push_back(placeholder);
+std::shared_ptr<BattleManager::ResidentBattle> BattleManager::Rehydrate(const std::string& session_id) {
+    auto& shard = GetShard(session_id);
+    // Cards resolve against the catalog the battle ran on, not one loaded
+    // while it was on disk
+    std::shared_ptr<const CardCatalog> catalog;
+    {
+        std::lock_guard lock(shard.mutex);
+        if (auto resident = shard.battles.find(session_id); resident != shard.battles.end()) {
+            // Another lookup got there first
+            resident->second->last_access_ms.store(NowMs(), std::memory_order_relaxed);
+            return resident->second;
         }
+        auto it = shard.hibernated.find(session_id);
+        if (it == shard.hibernated.end()) {
+            throw std::runtime_error("Battle not found for session: " + session_id);
+        }
+        catalog = it->second;
     }
-    
-    return cards;
+    if (!catalog) catalog = GetCardCatalog();
+
+    // Read without the shard lock. Lookups racing to rehydrate the same
+    // battle each read it; the first to publish wins.
+    auto data = hibernator_->Load(session_id);
+    if (!data) {
+        std::lock_guard lock(shard.mutex);
+        if (shard.hibernated.erase(session_id) > 0) hibernated_battles_.fetch_sub(1, std::memory_order_relaxed);
+        LOG_ERROR() << "Hibernated battle " << session_id << " is missing on disk";
+        throw std::runtime_error("Battle not found for session: " + session_id);
+    }
+    std::shared_ptr<ResidentBattle> battle;
+    try {
+        battle = std::make_shared<ResidentBattle>(DecodeBattleState(*data, std::move(catalog)));
+    } catch (const std::exception& e) {
+        // It would fail the same way on every access
+        LOG_ERROR() << "Hibernated battle " << session_id << " cannot be restored, ending it: " << e.what();
+        EndHibernated(session_id);
+        throw std::runtime_error("Battle not found for session: " + session_id);
+    }
+    const auto now_ms = NowMs();
+    battle->last_access_ms = now_ms;
+
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.battles.find(session_id);
+    if (it != shard.battles.end()) {
+        it->second->last_access_ms.store(now_ms, std::memory_order_relaxed);
+        return it->second;
+    }
+    if (shard.hibernated.erase(session_id) == 0) {
+        // Ended while we were reading
+        throw std::runtime_error("Battle not found for session: " + session_id);
+    }
+    // The file stays until the battle ends or is hibernated again; with a
+    // journal, actions from now on are replayed on top of the journaled start
+    shard.battles.emplace(session_id, battle);
+    resident_battles_.fetch_add(1, std::memory_order_relaxed);
+    hibernated_battles_.fetch_sub(1, std::memory_order_relaxed);
+    rehydrations_.fetch_add(1, std::memory_order_relaxed);
+    ScheduleEviction(session_id, now_ms + hibernate_after_ms_.load(std::memory_order_relaxed));
+    // The player to move gets a full turn again
+    StartTurnClock(session_id, *battle);
+    LOG_INFO() << "Rehydrated battle " << session_id;
+    return battle;
 }
 
-std::vector<Card> BattleManager::DrawInitialHand(std::vector<Card>& deck) {
-    std::vector<Card> hand;
-    int cards_to_draw = std::min(4, static_cast<int>(deck.size()));
-    
-    // Draw cards
-    for (int i = 0; i < cards_to_draw; i++) {
-        hand.push_back(deck.back());
-        deck.pop_back();
+std::size_t BattleManager::ExpireHibernated(std::chrono::seconds max_age) {
+    if (!hibernator_) return 0;
+    std::size_t expired = 0;
+    for (const auto& session_id : hibernator_->ListOlderThan(max_age)) {
+        // Files of resident battles are stale copies; the battle owns them
+        if (EndHibernated(session_id)) ++expired;
     }
-    
-    return hand;
+    if (expired > 0) LOG_INFO() << "Expired " << expired << " hibernated battles";
+    return expired;
 }
 
-void BattleManager::EndBattle(const std::string& session_id) {
-    auto it = active_battles_.find(session_id);
-    if (it != active_battles_.end()) {
-        active_battles_.erase(it);
-        LOG_INFO() << "Battle ended for session: " << session_id;
+bool BattleManager::EndHibernated(const std::string& session_id) {
+    {
+        auto& shard = GetShard(session_id);
+        std::lock_guard lock(shard.mutex);
+        if (shard.hibernated.erase(session_id) == 0) return false;
+        hibernated_battles_.fetch_sub(1, std::memory_order_relaxed);
+        JournalRecord record{JournalRecordType::BATTLE_ENDED};
+        record.session_id = session_id;
+        AppendToJournal(record);
+    }
+    try {
+        hibernator_->Remove(session_id);
+    } catch (const std::exception& e) {
+        LOG_ERROR() << "Failed to remove hibernated battle " << session_id << ": " << e.what();
     }
+    if (snapshot_writer_) snapshot_writer_->MarkDirty(session_id);
+    return true;
 }
 
-void BattleManager::InitializeDefaultCards() {
-    default_cards_.clear();
-    default_cards_.push_back(Card("card_001", "Fire Elemental", "A powerful fire creature", 5, 3, 4, CardType::CREATURE));
-    default_cards_.push_back(Card("card_002", "Water Spirit", "A mystical water being", 3, 5, 3, CardType::CREATURE));
-    default_cards_.push_back(Card("card_003", "Lightning Bolt", "Deal 3 damage to target", 0, 0, 2, CardType::SPELL));
-    default_cards_.push_back(Card("card_004", "Dragon", "A mighty dragon", 8, 6, 7, CardType::CREATURE));
-    default_cards_.push_back(Card("card_005", "Healing Potion", "Restore 4 health", 0, 0, 3, CardType::SPELL));
-    default_cards_.push_back(Card("card_006", "Knight", "A noble warrior", 4, 4, 4, CardType::CREATURE));
-    default_cards_.push_back(Card("card_007", "Magic Shield", "Gain 3 defense", 0, 0, 2, CardType::SPELL));
-    default_cards_.push_back(Card("card_008", "Goblin", "A small but fierce creature", 2, 1, 1, CardType::CREATURE));
-    default_cards_.push_back(Card("card_009", "Wizard", "A powerful spellcaster", 3, 2, 5, CardType::CREATURE));
-    default_cards_.push_back(Card("card_010", "Forest Guardian", "Protector of nature", 6, 7, 6, CardType::CREATURE));
-    LOG_INFO() << "Initialized default cards, count: " << default_cards_.size();
-}
-
-void BattleManager::SaveBattleState(const std::string& session_id, const BattleState& state) {
-    // No database update, just save to memory
-    // In a real app, you'd serialize to JSON and save to a file or database
-    // For now, we'll just re-add it to the active_battles_ map
-    LOG_INFO() << "SaveBattleState for session " << session_id << ":";
-    for (const auto& pair : state.players) {
-        const std::string& player_id = pair.first;
-        const PlayerState& player = pair.second;
-        LOG_INFO() << "  Saving player " << player_id << ": hand size=" << player.hand.size() 
-                   << ", deck size=" << player.deck.size() 
-                   << ", field size=" << player.field.size() 
-                   << ", graveyard size=" << player.graveyard.size();
+bool BattleManager::RemoveBattle(const std::string& session_id, bool archive) {
+    auto& shard = GetShard(session_id);
+    std::shared_ptr<ResidentBattle> battle;
+    {
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.battles.find(session_id);
+        if (it != shard.battles.end()) {
+            battle = std::move(it->second);
+            shard.battles.erase(it);
+            resident_battles_.fetch_sub(1, std::memory_order_relaxed);
+        } else if (shard.hibernated.erase(session_id) > 0) {
+            hibernated_battles_.fetch_sub(1, std::memory_order_relaxed);
+        } else {
+            return false;
+        }
+        JournalRecord record{JournalRecordType::BATTLE_ENDED};
+        record.session_id = session_id;
+        AppendToJournal(record);
+    }
+    if (hibernator_) {
+        try {
+            hibernator_->Remove(session_id);
+        } catch (const std::exception& e) {
+            LOG_ERROR() << "Failed to remove hibernated battle " << session_id << ": " << e.what();
+        }
+    }
+    if (snapshot_writer_) {
+        if (archive && battle) {
+            // Waits for commands still in the actor, so the final state is complete
+            snapshot_writer_->Archive(battle->actor.Snapshot());
+        } else {
+            snapshot_writer_->MarkDirty(session_id);
+        }
     }
-    active_battles_[session_id] = state;
+    return true;
 }
 
+std::int64_t BattleManager::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               TimerWheel::Clock::now().time_since_epoch())
+        .count();
+}
 
+BattleManager::Shard& BattleManager::GetShard(const std::string& session_id) {
+    return shards_[std::hash<std::string>{}(session_id) % kShardCount];
+}
 
-BattleState BattleManager::BattleStateFromJson(const std::string& json_str) {
-    BattleState state;
-    auto json = userver::formats::json::FromString(json_str);
-    
-    state.session_id = json["session_id"].As<std::string>();
-    state.current_turn = json["current_turn"].As<std::string>();
-    state.turn_number = json["turn_number"].As<int>();
-    state.winner = json["winner"].As<std::string>();
-    state.is_finished = json["is_finished"].As<bool>();
-    state.last_action = json["last_action"].As<std::string>();
-    
-    auto players_json = json["players"];
-    
-    // For now, assume we know the player IDs from the session
-    // In a real implementation, you'd store the player IDs in the battle state
-    // No database query needed here
-    std::string player1_id = players_json["player1_id"].As<std::string>();
-    std::string player2_id = players_json["player2_id"].As<std::string>();
-    
-    // Load player 1 data
-    if (players_json.HasMember(player1_id)) {
-        auto player_data = players_json[player1_id];
-        PlayerState player;
-        
-        player.player_id = player_data["player_id"].As<std::string>();
-        player.health = player_data["health"].As<int>();
-        player.max_health = player_data["max_health"].As<int>();
-        player.mana = player_data["mana"].As<int>();
-        player.max_mana = player_data["max_mana"].As<int>();
-        player.is_active = player_data["is_active"].As<bool>();
-        
-        // Load hand cards
-        auto hand_json = player_data["hand"];
-        for (const auto& card_json : hand_json) {
-            Card card;
-            card.id = card_json["id"].As<std::string>();
-            card.name = card_json["name"].As<std::string>();
-            card.description = card_json["description"].As<std::string>();
-            card.attack = card_json["attack"].As<int>();
-            card.defense = card_json["defense"].As<int>();
-            card.mana_cost = card_json["mana_cost"].As<int>();
-            card.type = static_cast<CardType>(card_json["type"].As<int>());
-            player.hand.push_back(card);
+std::shared_ptr<BattleManager::ResidentBattle> BattleManager::FindBattle(const std::string& session_id) {
+    auto& shard = GetShard(session_id);
+    {
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.battles.find(session_id);
+        if (it != shard.battles.end()) {
+            it->second->last_access_ms.store(NowMs(), std::memory_order_relaxed);
+            return it->second;
         }
-        
-        // Load field cards
-        auto field_json = player_data["field"];
-        for (const auto& card_json : field_json) {
-            Card card;
-            card.id = card_json["id"].As<std::string>();
-            card.name = card_json["name"].As<std::string>();
-            card.description = card_json["description"].As<std::string>();
-            card.attack = card_json["attack"].As<int>();
-            card.defense = card_json["defense"].As<int>();
-            card.mana_cost = card_json["mana_cost"].As<int>();
-            card.type = static_cast<CardType>(card_json["type"].As<int>());
-            player.field.push_back(card);
+        if (!shard.hibernated.count(session_id)) {
+            throw std::runtime_error("Battle not found for session: " + session_id);
         }
-        
-        state.players[player1_id] = player;
     }
-    
-    // Load player 2 data
-    if (players_json.HasMember(player2_id)) {
-        auto player_data = players_json[player2_id];
-        PlayerState player;
-        
-        player.player_id = player_data["player_id"].As<std::string>();
-        player.health = player_data["health"].As<int>();
-        player.max_health = player_data["max_health"].As<int>();
-        player.mana = player_data["mana"].As<int>();
-        player.max_mana = player_data["max_mana"].As<int>();
-        player.is_active = player_data["is_active"].As<bool>();
-        
-        // Load hand cards
-        auto hand_json = player_data["hand"];
-        for (const auto& card_json : hand_json) {
-            Card card;
-            card.id = card_json["id"].As<std::string>();
-            card.name = card_json["name"].As<std::string>();
-            card.description = card_json["description"].As<std::string>();
-            card.attack = card_json["attack"].As<int>();
-            card.defense = card_json["defense"].As<int>();
-            card.mana_cost = card_json["mana_cost"].As<int>();
-            card.type = static_cast<CardType>(card_json["type"].As<int>());
-            player.hand.push_back(card);
+    return Rehydrate(session_id);
+}
+
+void BattleManager::RunAction(const std::string& session_id, const BattleActor::Command& action,
+                              JournalRecord* record) {
+    ExecuteAction(session_id, FindBattle(session_id), action, record);
+}
+
+void BattleManager::ExecuteAction(const std::string& session_id, const std::shared_ptr<ResidentBattle>& battle,
+                                  const BattleActor::Command& action, JournalRecord* record) {
+    bool finished_now = false;
+    std::int64_t turn_deadline_ms = 0;
+    battle->actor.Execute([&](BattleState& battle_state) {
+        const int turn_number = battle_state.turn_number;
+        action(battle_state);
+        ++battle_state.version;
+        if (battle_state.is_finished && battle->finished_at_ms.load(std::memory_order_relaxed) == 0) {
+            battle->finished_at_ms.store(NowMs(), std::memory_order_release);
+            battle->turn_deadline_ms.store(0, std::memory_order_release);
+            finished_now = true;
+        } else if (battle_state.turn_number != turn_number) {
+            // Set in the actor, so ExpireTurn can tell which turn a timer was for
+            const auto turn_timeout_ms = turn_timeout_ms_.load(std::memory_order_relaxed);
+            turn_deadline_ms = turn_timeout_ms > 0 ? NowMs() + turn_timeout_ms : 0;
+            battle->turn_deadline_ms.store(turn_deadline_ms, std::memory_order_release);
         }
-        
-        // Load field cards
-        auto field_json = player_data["field"];
-        for (const auto& card_json : field_json) {
-            Card card;
-            card.id = card_json["id"].As<std::string>();
-            card.name = card_json["name"].As<std::string>();
-            card.description = card_json["description"].As<std::string>();
-            card.attack = card_json["attack"].As<int>();
-            card.defense = card_json["defense"].As<int>();
-            card.mana_cost = card_json["mana_cost"].As<int>();
-            card.type = static_cast<CardType>(card_json["type"].As<int>());
-            player.field.push_back(card);
+        // Appended in actor order, so the journal sees a battle's actions in
+        // the order they were applied
+        if (record) {
+            record->version = battle_state.version;
+            record->session_id = session_id;
+            AppendToJournal(*record);
         }
-        
-        state.players[player2_id] = player;
+        if (snapshot_writer_) snapshot_writer_->MarkDirty(session_id);
+        // Still inside the actor: listeners observe states in order
+        const StateUpdate update(battle_state, battle->actor, *this);
+        for (const auto& listener : state_listeners_) listener(update);
+    });
+    if (finished_now) {
+        LOG_INFO() << "Game ended in battle " << session_id;
+        ScheduleEviction(session_id, NowMs() + finished_grace_ms_.load(std::memory_order_relaxed));
     }
-    
-    return state;
+    // The timer of the previous turn is left to fire and find nothing to do
+    if (turn_deadline_ms != 0) ScheduleTurnTimer(session_id, turn_deadline_ms);
+}
+
+void BattleManager::AddStateListener(StateListener listener) {
+    state_listeners_.push_back(std::move(listener));
+}
+
+std::size_t BattleManager::AddStateFormat(StateFormat format) {
+    if (state_formats_.size() == BattleActor::kMaxFormats) throw std::runtime_error("Too many state formats");
+    state_formats_.push_back(std::move(format));
+    return state_formats_.size() - 1;
+}
+
+std::shared_ptr<const std::string> BattleManager::StateUpdate::Payload(std::size_t format) const {
+    return actor_.PayloadInCommand(format, battle_manager_.state_formats_.at(format).full);
+}
+
+std::shared_ptr<const std::string> BattleManager::StateUpdate::Delta(std::size_t format) const {
+    const auto& serialize = battle_manager_.state_formats_.at(format).delta;
+    if (!serialize) return nullptr;
+    return actor_.DeltaInCommand(format, serialize);
+}
+
+void BattleManager::SetJournal(std::shared_ptr<BattleJournal> journal) {
+    journal_ = std::move(journal);
+}
+
+void BattleManager::SetSnapshotWriter(std::shared_ptr<BattleSnapshotWriter> snapshot_writer) {
+    snapshot_writer_ = std::move(snapshot_writer);
+}
+
+void BattleManager::SetHibernator(std::shared_ptr<BattleHibernator> hibernator) {
+    std::size_t indexed = 0;
+    for (const auto& session_id : hibernator->List()) {
+        auto& shard = GetShard(session_id);
+        std::lock_guard lock(shard.mutex);
+        // Recovered battles are resident; their files are stale copies
+        if (shard.battles.count(session_id) == 0 && shard.hibernated.emplace(session_id, nullptr).second) ++indexed;
+    }
+    hibernated_battles_.fetch_add(indexed, std::memory_order_relaxed);
+    hibernator_ = std::move(hibernator);
+    LOG_INFO() << "Battle hibernation enabled, " << indexed << " battles on disk";
+}
+
+void BattleManager::SetPresenceProbe(PresenceProbe probe) {
+    presence_probe_ = std::move(probe);
+}
+
+void BattleManager::AppendToJournal(const JournalRecord& record) {
+    if (!journal_) return;
+    try {
+        journal_->Append(record);
+    } catch (const std::exception& e) {
+        // The action is already applied and will be broadcast; keep serving
+        LOG_ERROR() << "Failed to journal action for session " << record.session_id << ": " << e.what();
+    }
+}
+
+std::size_t BattleManager::RetireJournalSegments() {
+    if (!journal_) return 0;
+    std::unordered_set<std::string> carried;
+    return journal_->Retire(
+        [this](const std::string& session_id, const JournalSegmentSummary::Battle& battle) {
+            return JournalCovers(session_id, battle);
+        },
+        [this, &carried](const JournalSegmentSummary& segment) {
+            for (const auto& [session_id, battle] : segment.battles) {
+                if (battle.ended || carried.count(session_id)) continue;
+                // Without its BATTLE_HIBERNATED, recovery would restore a
+                // hibernated battle from its snapshot rather than leave it on
+                // disk. Under the shard lock, so it cannot be rehydrated and
+                // journal an action before this record.
+                auto& shard = GetShard(session_id);
+                std::lock_guard lock(shard.mutex);
+                if (shard.hibernated.count(session_id) == 0) continue;
+                JournalRecord record{JournalRecordType::BATTLE_HIBERNATED};
+                record.session_id = session_id;
+                record.version = battle.max_version;
+                AppendToJournal(record);
+                carried.insert(session_id);
+            }
+        });
+}
+
+bool BattleManager::JournalCovers(const std::string& session_id, const JournalSegmentSummary::Battle& battle) {
+    const auto snapshot_version =
+        snapshot_writer_ ? snapshot_writer_->PersistedVersion(session_id) : std::nullopt;
+    // A snapshot only ever moves forward or goes with its battle, so reading
+    // it first is safe
+    auto& shard = GetShard(session_id);
+    std::lock_guard lock(shard.mutex);
+    const bool live = shard.battles.count(session_id) > 0 || shard.hibernated.count(session_id) > 0;
+    return IsJournalCovered(battle, snapshot_version, live);
+}
+
+std::uint64_t BattleManager::NewBattleSeed() {
+    std::uint64_t counter = next_seed_.fetch_add(1, std::memory_order_relaxed);
+    return BattleRng::SplitMix64(counter);
+}
+
+std::shared_ptr<const CardCatalog> BattleManager::GetCardCatalog() const {
+    return card_catalog_.ReadCopy();
+}
+
+void BattleManager::SetCardCatalogPath(const std::string& path) {
+    card_catalog_path_ = path;
+    card_catalog_stamp_.clear();
+}
+
+bool BattleManager::ReloadCardCatalog() {
+    if (card_catalog_path_.empty()) return false;
+
+    // The compiler replaces the file by rename, so inode + mtime + size
+    // changes with every new version
+    struct stat file_stat;
+    if (::stat(card_catalog_path_.c_str(), &file_stat) != 0) return false;
+    std::string stamp = std::to_string(file_stat.st_ino) + ":" + std::to_string(file_stat.st_mtim.tv_sec) + "." +
+                        std::to_string(file_stat.st_mtim.tv_nsec) + ":" + std::to_string(file_stat.st_size);
+    if (stamp == card_catalog_stamp_) return false;
+    // Remember the stamp before loading so a broken file is reported once
+    card_catalog_stamp_ = stamp;
+
+    auto catalog = CardCatalog::Load(card_catalog_path_);
+    for (const auto& card_id : StarterDeckCardIds()) {
+        // New battles are dealt short decks
+        if (!catalog->Find(card_id)) LOG_ERROR() << "Starter deck card not found in card catalog: " << card_id;
+    }
+    card_catalog_.Assign(catalog);
+    LOG_INFO() << "Published card catalog " << card_catalog_path_ << ", count: " << catalog->Size();
+    return true;
+}
+
+void BattleManager::UpdateBattleState(const std::string& session_id, const BattleActor::Command& update) {
+    // Not journaled: arbitrary updates cannot be replayed, so they must not
+    // change anything the rules depend on
+    LOG_INFO() << "UpdateBattleState for session " << session_id;
+    RunAction(session_id, update);
 }
 
 void BattleManager::UpdatePlayerStats(const std::string& player_id, bool won) {
@@ -0,0 +1,78 @@
+#include "../include/managers/battle_manager.hpp"
+#include "../include/battle_replay.hpp"
+#include <algorithm>
+#include <userver/logging/log.hpp>
+
+namespace cardbattle {
+
+extern GameSessionManager* session_manager;
+
+BattleManager::RecoveryStats BattleManager::RecoverBattles(
+    const std::string& journal_dir, std::vector<BattleState> snapshots, unsigned threads,
+    std::vector<std::shared_ptr<const JournalSegmentSummary>>* segment_summaries) {
+    const auto started_at = std::chrono::steady_clock::now();
+    RecoveryStats stats;
+    threads = std::max(threads, 1u);
+
+    // 1. Read segments in parallel
+    const auto segments = BattleJournal::ListSegments(journal_dir);
+    std::vector<std::vector<OwnedJournalRecord>> records(segments.size());
+    std::vector<std::shared_ptr<JournalSegmentSummary>> summaries(segments.size());
+    ParallelFor(segments.size(), threads, [&](std::size_t i) {
+        auto summary = std::make_shared<JournalSegmentSummary>();
+        summary->path = segments[i];
+        bool intact = BattleJournal::ReadSegment(segments[i], [&](const JournalRecord& record) {
+            records[i].emplace_back(record);
+            summary->Add(record);
+        });
+        if (!intact) LOG_WARNING() << "Journal segment " << segments[i] << " ends in a torn record";
+        summaries[i] = std::move(summary);
+    });
+    stats.segments = segments.size();
+    if (segment_summaries) segment_summaries->assign(summaries.begin(), summaries.end());
+
+    // 2-4. Group by battle, pick bases and replay
+    auto replay = ReplayJournal(records, std::move(snapshots), GetCardCatalog(), threads);
+    stats.records = replay.records;
+    for (const auto& [session_id, error] : replay.failed) {
+        LOG_ERROR() << "Failed to recover battle " << session_id << ": " << error;
+    }
+    stats.failed = replay.failed.size();
+
+    // 5. Publish
+    for (auto& state : replay.battles) {
+        const auto session_id = state.session_id;
+        GameSession session;
+        session.id = session_id;
+        session.host_id = state.players[kHostSeat].player_id;
+        session.guest_id = state.players[kGuestSeat].player_id;
+        session.status = state.is_finished ? "finished" : "active";
+        session_manager->RestoreSession(session);
+
+        // Eviction timers start over: finished battles get their grace
+        // period, running ones the idle timeout
+        const bool finished = state.is_finished;
+        auto battle = std::make_shared<ResidentBattle>(std::move(state));
+        const auto now_ms = NowMs();
+        battle->last_access_ms = now_ms;
+        if (finished) battle->finished_at_ms = now_ms;
+        const auto delay_ms = finished ? finished_grace_ms_.load() : IdleDelayMs();
+
+        auto& shard = GetShard(session_id);
+        std::lock_guard lock(shard.mutex);
+        if (shard.battles.insert_or_assign(session_id, std::move(battle)).second) {
+            resident_battles_.fetch_add(1, std::memory_order_relaxed);
+        }
+        ScheduleEviction(session_id, now_ms + delay_ms);
+        // Downtime does not count against the player to move
+        StartTurnClock(session_id, *shard.battles.at(session_id));
+        ++stats.battles;
+    }
+
+    stats.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_at);
+    LOG_INFO() << "Recovered " << stats.battles << " battles (" << stats.failed << " failed) from " << stats.records
+               << " journal records in " << stats.segments << " segments in " << stats.duration.count() << "ms";
+    return stats;
+}
+
+} // namespace cardbattle
@@ -0,0 +1,119 @@
+#include "../include/managers/battle_snapshot_writer.hpp"
+#include "../include/managers/battle_manager.hpp"
+#include "../include/battle_state_codec.hpp"
+#include "../sqlite_db.hpp"
+#include <chrono>
+#include <mutex>
+#include <userver/logging/log.hpp>
+
+namespace cardbattle {
+
+BattleSnapshotWriter::BattleSnapshotWriter(BattleManager& battle_manager, std::unique_ptr<SQLiteDB> db,
+                                           std::unordered_map<std::string, std::uint64_t> persisted)
+    : battle_manager_(battle_manager), db_(std::move(db)), persisted_(std::move(persisted)) {
+    // Flushes run on the fs task processor and may wait out the main
+    // connection's writes; that one keeps failing fast
+    db_->SetBusyTimeout(5000);
+}
+
+BattleSnapshotWriter::~BattleSnapshotWriter() = default;
+
+void BattleSnapshotWriter::MarkDirty(const std::string& session_id) {
+    std::lock_guard lock(mutex_);
+    if (dirty_.insert(session_id).second) {
+        dirty_count_.store(dirty_.size() + archived_.size(), std::memory_order_relaxed);
+    }
+}
+
+void BattleSnapshotWriter::Archive(std::shared_ptr<const BattleState> state) {
+    std::lock_guard lock(mutex_);
+    archived_.insert_or_assign(state->session_id, std::move(state));
+    dirty_count_.store(dirty_.size() + archived_.size(), std::memory_order_relaxed);
+}
+
+void BattleSnapshotWriter::Flush() {
+    std::unordered_set<std::string> batch;
+    std::unordered_map<std::string, std::shared_ptr<const BattleState>> archived;
+    {
+        std::lock_guard lock(mutex_);
+        batch.swap(dirty_);
+        archived.swap(archived_);
+        dirty_count_.store(0, std::memory_order_relaxed);
+    }
+    if (batch.empty() && archived.empty()) return;
+
+    const std::string now = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+    // battles.session_id references sessions, which otherwise live only in
+    // memory. Session ids are reused, so the row takes the status of the
+    // battle written now: recovery skips the battles of finished sessions.
+    SQLiteDB::BatchStatement sessions{
+        "INSERT INTO sessions (id, player1_id, player2_id, status, created_at) VALUES (?1, ?2, ?3, ?4, ?5) "
+        "ON CONFLICT(id) DO UPDATE SET player1_id = excluded.player1_id, player2_id = excluded.player2_id, "
+        "status = excluded.status",
+        {}};
+    SQLiteDB::BatchStatement upserts{
+        "INSERT INTO battles (id, session_id, state, last_update) VALUES (?1, ?1, ?2, ?3) "
+        "ON CONFLICT(id) DO UPDATE SET state = excluded.state, last_update = excluded.last_update",
+        {},
+        {2}};
+    SQLiteDB::BatchStatement deletes{"DELETE FROM battles WHERE id = ?1", {}};
+    // What the table holds once the batch commits; nullopt for no loadable row
+    std::vector<std::pair<std::string, std::optional<std::uint64_t>>> written;
+
+    for (const auto& [session_id, state] : archived) {
+        sessions.rows.push_back({session_id, state->players[kHostSeat].player_id,
+                                 state->players[kGuestSeat].player_id, "finished", now});
+        upserts.rows.push_back({session_id, EncodeBattleState(*state), now});
+        written.emplace_back(session_id, std::nullopt);
+    }
+    for (const auto& session_id : batch) {
+        if (archived.count(session_id)) continue;  // Gone from memory, but kept
+        // Peeked, so flushing neither rehydrates battles nor keeps them awake
+        auto state = battle_manager_.PeekBattleState(session_id);
+        if (!state) {
+            // A hibernated battle keeps its last row
+            if (!battle_manager_.IsHibernated(session_id)) {
+                deletes.rows.push_back({session_id});
+                written.emplace_back(session_id, std::nullopt);
+            }
+            continue;
+        }
+        sessions.rows.push_back({session_id, state->players[kHostSeat].player_id,
+                                 state->players[kGuestSeat].player_id, "active", now});
+        upserts.rows.push_back({session_id, EncodeBattleState(*state), now});
+        written.emplace_back(session_id, state->version);
+    }
+
+    if (!db_->ExecuteBatch({sessions, upserts, deletes})) {
+        // Put the battles back so the next flush retries them
+        failed_flushes_.fetch_add(1, std::memory_order_relaxed);
+        LOG_ERROR() << "Failed to write " << batch.size() + archived.size()
+                    << " battle snapshots: " << db_->GetLastError();
+        std::lock_guard lock(mutex_);
+        dirty_.merge(batch);
+        archived_.merge(archived);
+        dirty_count_.store(dirty_.size() + archived_.size(), std::memory_order_relaxed);
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto& [session_id, version] : written) {
+            if (version) {
+                persisted_.insert_or_assign(session_id, *version);
+            } else {
+                persisted_.erase(session_id);
+            }
+        }
+    }
+    written_count_.fetch_add(upserts.rows.size(), std::memory_order_relaxed);
+    archived_count_.fetch_add(archived.size(), std::memory_order_relaxed);
+}
+
+std::optional<std::uint64_t> BattleSnapshotWriter::PersistedVersion(const std::string& session_id) {
+    std::lock_guard lock(mutex_);
+    auto it = persisted_.find(session_id);
+    if (it == persisted_.end()) return std::nullopt;
+    return it->second;
+}
+
+} // namespace cardbattle
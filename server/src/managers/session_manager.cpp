@@ -34,6 +34,16 @@ void GameSessionManager::JoinSession(const std::string& session_id, const std::s
     user_active_session_[player2_id] = session_id;
 }
 
+std::string GameSessionManager::AddBot(const std::string& session_id, const std::string& host_id) {
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end()) throw std::runtime_error("Session not found");
+    if (it->second.host_id != host_id) throw std::runtime_error("Only the host can add a bot");
+    // One bot per session at most, so the session id keeps it unique
+    std::string bot_id = std::string(kBotPlayerIdPrefix) + session_id;
+    JoinSession(session_id, bot_id);
+    return bot_id;
+}
+
 std::vector<GameSession> GameSessionManager::GetWaitingSessions() {
     std::vector<GameSession> waiting_sessions;
     for (const auto& pair : sessions_) {
@@ -64,10 +74,21 @@ void GameSessionManager::RemovePlayerFromSession(const std::string& session_id,
     if (it->second.host_id == player_id) it->second.host_id = "";
     else if (it->second.guest_id == player_id) it->second.guest_id = "";
     user_active_session_.erase(player_id);
+    // A bot does not stay behind on its own
+    if (IsBotPlayer(it->second.guest_id) && it->second.host_id.empty()) {
+        user_active_session_.erase(it->second.guest_id);
+        it->second.guest_id = "";
+    }
     if (it->second.host_id.empty() && it->second.guest_id.empty()) sessions_.erase(it);
     else it->second.status = "waiting";
 }
 
+void GameSessionManager::RestoreSession(const GameSession& session) {
+    sessions_[session.id] = session;
+    if (!session.host_id.empty()) user_active_session_[session.host_id] = session.id;
+    if (!session.guest_id.empty()) user_active_session_[session.guest_id] = session.id;
+}
+
 void GameSessionManager::ClearOldSessions() {
     // Optionally remove sessions older than X time
 }
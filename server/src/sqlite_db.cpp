@@ -1,4 +1,5 @@
 #include "sqlite_db.hpp"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
@@ -32,6 +33,10 @@ SQLiteDB::~SQLiteDB() {
     }
 }
 
+void SQLiteDB::SetBusyTimeout(int milliseconds) {
+    if (db_) sqlite3_busy_timeout(db_, milliseconds);
+}
+
 bool SQLiteDB::Execute(const std::string& sql) {
     if (!db_) {
         last_error_ = "Database not initialized";
@@ -69,6 +74,50 @@ bool SQLiteDB::Execute(const std::string& sql, const std::vector<std::string>& p
     return success;
 }
 
+bool SQLiteDB::ExecuteBatch(const std::vector<BatchStatement>& statements) {
+    if (!db_) {
+        last_error_ = "Database not initialized";
+        return false;
+    }
+    if (!Execute("BEGIN IMMEDIATE")) return false;
+    
+    for (const auto& statement : statements) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db_, statement.sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            last_error_ = sqlite3_errmsg(db_);
+            Execute("ROLLBACK");
+            return false;
+        }
+        for (const auto& row : statement.rows) {
+            for (size_t i = 0; i < row.size(); ++i) {
+                const int index = static_cast<int>(i + 1);
+                if (std::find(statement.blob_params.begin(), statement.blob_params.end(), index) != statement.blob_params.end()) {
+                    sqlite3_bind_blob(stmt, index, row[i].data(), static_cast<int>(row[i].size()), SQLITE_STATIC);
+                } else {
+                    sqlite3_bind_text(stmt, index, row[i].c_str(), static_cast<int>(row[i].size()), SQLITE_STATIC);
+                }
+            }
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                last_error_ = sqlite3_errmsg(db_);
+                sqlite3_finalize(stmt);
+                Execute("ROLLBACK");
+                return false;
+            }
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    
+    if (!Execute("COMMIT")) {
+        std::string error = last_error_;
+        Execute("ROLLBACK");
+        last_error_ = error;
+        return false;
+    }
+    return true;
+}
+
 bool SQLiteDB::Query(const std::string& sql, std::vector<std::vector<std::string>>& results) {
     if (!db_) {
         last_error_ = "Database not initialized";
@@ -83,8 +132,9 @@ bool SQLiteDB::Query(const std::string& sql, std::vector<std::vector<std::string
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         std::vector<std::string> row;
         for (int i = 0; i < cols; ++i) {
-            const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
-            row.push_back(val ? val : "");
+            // By length, so blob columns with embedded NULs come back whole
+            const char* val = static_cast<const char*>(sqlite3_column_blob(stmt, i));
+            row.emplace_back(val ? val : "", static_cast<size_t>(sqlite3_column_bytes(stmt, i)));
         }
         results.push_back(row);
     }
@@ -109,8 +159,9 @@ bool SQLiteDB::Query(const std::string& sql, const std::vector<std::string>& par
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         std::vector<std::string> row;
         for (int i = 0; i < cols; ++i) {
-            const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
-            row.push_back(val ? val : "");
+            // By length, so blob columns with embedded NULs come back whole
+            const char* val = static_cast<const char*>(sqlite3_column_blob(stmt, i));
+            row.emplace_back(val ? val : "", static_cast<size_t>(sqlite3_column_bytes(stmt, i)));
         }
         results.push_back(row);
     }
@@ -11,11 +11,26 @@
 
 class SQLiteDB {
 public:
+    // One statement run once per parameter row, see ExecuteBatch
+    struct BatchStatement {
+        std::string sql;
+        std::vector<std::vector<std::string>> rows;
+        std::vector<int> blob_params;  // 1-based parameters bound as blobs rather than text
+    };
+
     SQLiteDB(const std::string& db_path);
     ~SQLiteDB();
 
+    // Wait up to this long for a lock held by another connection instead of
+    // failing with SQLITE_BUSY right away (the default). Blocks the calling
+    // thread, so only for connections used off the main task processor.
+    void SetBusyTimeout(int milliseconds);
+
     bool Execute(const std::string& sql);
     bool Execute(const std::string& sql, const std::vector<std::string>& params);
+    // Runs the statements in order inside one transaction, each prepared once
+    // and stepped for every row; rolls back everything on the first failure
+    bool ExecuteBatch(const std::vector<BatchStatement>& statements);
     bool Query(const std::string& sql, std::vector<std::vector<std::string>>& results);
     bool Query(const std::string& sql, const std::vector<std::string>& params, std::vector<std::vector<std::string>>& results);
     std::string GetLastError() const;
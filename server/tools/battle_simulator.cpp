@@ -0,0 +1,341 @@
+// Headless battle simulator: plays games with the server's rules
+// (battle_rules.hpp) on all cores, without userver, networking or logging.
+// Used for balance testing of the card set and as a throughput benchmark of
+// the rules engine.
+//
+//   BattleSimulator [--games N] [--threads N] [--seed N] [--max-turns N]
+//                   [--host random|greedy] [--guest random|greedy]
+//                   [--catalog cards.bin]
+//
+// Game i is seeded from --seed and i alone, so a run gives the same results
+// on any number of threads.
+#include "../include/battle_rules.hpp"
+#include "../include/card_catalog.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace cardbattle;
+
+// Spreads [0, count) over the workers as one contiguous range each. A worker
+// takes chunks off the front of its own range; once that is empty it steals
+// the back half of another worker's range. Long games on one worker thus
+// even out without a shared queue, and each range lock is taken once per
+// chunk.
+class WorkStealingScheduler {
+public:
+    WorkStealingScheduler(std::uint64_t count, unsigned workers, std::uint64_t chunk)
+        : workers_(workers), chunk_(chunk), ranges_(std::make_unique<Range[]>(workers)) {
+        for (unsigned i = 0; i < workers; ++i) {
+            ranges_[i].begin = count * i / workers;
+            ranges_[i].end = count * (i + 1) / workers;
+        }
+    }
+
+    // Next chunk for `worker`; false once no work is left to take
+    bool Next(unsigned worker, std::uint64_t& begin, std::uint64_t& end) {
+        if (TakeOwn(worker, begin, end)) return true;
+        for (unsigned i = 1; i < workers_; ++i) {
+            auto& victim = ranges_[(worker + i) % workers_];
+            std::uint64_t stolen_begin;
+            std::uint64_t stolen_end;
+            {
+                std::lock_guard lock(victim.mutex);
+                const std::uint64_t remaining = victim.end - victim.begin;
+                if (remaining == 0) continue;
+                stolen_end = victim.end;
+                stolen_begin = victim.end - (remaining + 1) / 2;
+                victim.end = stolen_begin;
+            }
+            {
+                auto& own = ranges_[worker];
+                std::lock_guard lock(own.mutex);
+                own.begin = stolen_begin;
+                own.end = stolen_end;
+            }
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return TakeOwn(worker, begin, end);
+        }
+        return false;
+    }
+
+    std::uint64_t Steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Range {
+        std::mutex mutex;
+        std::uint64_t begin = 0;
+        std::uint64_t end = 0;
+    };
+
+    bool TakeOwn(unsigned worker, std::uint64_t& begin, std::uint64_t& end) {
+        auto& own = ranges_[worker];
+        std::lock_guard lock(own.mutex);
+        if (own.begin == own.end) return false;
+        begin = own.begin;
+        end = std::min(own.end, own.begin + chunk_);
+        own.begin = end;
+        return true;
+    }
+
+    const unsigned workers_;
+    const std::uint64_t chunk_;
+    std::unique_ptr<Range[]> ranges_;
+    std::atomic<std::uint64_t> steals_{0};
+};
+
+// Picks one of `actions` (never empty) for the player to act
+using Policy = BattleAction (*)(const BattleState& state, const std::vector<BattleAction>& actions, BattleRng& rng);
+
+BattleAction ChooseRandom(const BattleState&, const std::vector<BattleAction>& actions, BattleRng& rng) {
+    return actions[rng.NextBelow(static_cast<std::uint32_t>(actions.size()))];
+}
+
+// Scripted play: the most expensive useful card first, then trades that
+// kill without losing the attacker, then face damage, then end the turn
+BattleAction ChooseGreedy(const BattleState& state, const std::vector<BattleAction>& actions, BattleRng&) {
+    const auto& catalog = *state.catalog;
+    const auto& player = state.players[state.current_seat];
+    const auto& opponent = state.players[OpponentSeat(state.current_seat)];
+
+    const BattleAction* best_play = nullptr;
+    int best_cost = -1;
+    for (const auto& action : actions) {
+        if (action.type != BattleAction::Type::PLAY_CARD) continue;
+        const CardDefinition definition = catalog.Get(player.hand[action.arg0].definition);
+        const bool only_heals_self = definition.type == CardType::SPELL &&
+                                     std::all_of(definition.effects.begin(), definition.effects.end(),
+                                                 [](const CardEffect& effect) {
+                                                     return effect.op == EffectOp::HEAL &&
+                                                            effect.target == EffectTarget::SELF;
+                                                 });
+        if (only_heals_self && player.health == player.max_health) continue;
+        if (definition.mana_cost > best_cost) {
+            best_cost = definition.mana_cost;
+            best_play = &action;
+        }
+    }
+    if (best_play) return *best_play;
+
+    const BattleAction* face = nullptr;
+    for (const auto& action : actions) {
+        if (action.type != BattleAction::Type::ATTACK) continue;
+        if (action.arg1 == kNoSeat) {
+            if (!face) face = &action;
+            continue;
+        }
+        const Card& attacker = player.field[action.arg0];
+        const Card& target = opponent.field[action.arg1];
+        if (attacker.attack >= target.defense && target.attack < attacker.defense) return action;
+    }
+    if (face) return *face;
+    return actions.back();  // END_TURN
+}
+
+Policy ParsePolicy(const std::string& name) {
+    if (name == "random") return ChooseRandom;
+    if (name == "greedy") return ChooseGreedy;
+    throw std::runtime_error("Unknown policy: " + name + " (expected random or greedy)");
+}
+
+struct CardStats {
+    std::uint64_t played = 0;
+    std::uint64_t played_by_winner = 0;
+};
+
+// Per worker, merged at the end; aligned so workers never share a cache line
+struct alignas(64) Stats {
+    std::uint64_t games = 0;
+    std::uint64_t wins[2] = {0, 0};  // By seat
+    std::uint64_t unfinished = 0;    // Stopped at --max-turns
+    std::uint64_t turns = 0;
+    std::uint64_t actions = 0;
+    std::vector<CardStats> cards;  // By catalog index
+
+    void Merge(const Stats& other) {
+        games += other.games;
+        wins[kHostSeat] += other.wins[kHostSeat];
+        wins[kGuestSeat] += other.wins[kGuestSeat];
+        unfinished += other.unfinished;
+        turns += other.turns;
+        actions += other.actions;
+        for (std::size_t i = 0; i < cards.size(); ++i) {
+            cards[i].played += other.cards[i].played;
+            cards[i].played_by_winner += other.cards[i].played_by_winner;
+        }
+    }
+};
+
+struct Options {
+    std::uint64_t games = 100000;
+    unsigned threads = 0;  // One per core
+    std::uint64_t seed = 1;
+    int max_turns = 200;
+    Policy policies[2] = {ChooseGreedy, ChooseGreedy};
+    std::string host_policy = "greedy";
+    std::string guest_policy = "greedy";
+    std::string catalog_path;  // Built-in cards if empty
+};
+
+// Scratch buffers reused across the games of one worker
+struct Scratch {
+    std::vector<BattleAction> actions;
+    std::vector<std::uint16_t> played[2];
+};
+
+void PlayGame(const Options& options, const std::shared_ptr<const CardCatalog>& catalog, std::uint64_t game,
+              Scratch& scratch, Stats& stats) {
+    std::uint64_t seed_source = options.seed + game;
+    const std::uint64_t seed = BattleRng::SplitMix64(seed_source);
+    BattleState state = NewBattleState("sim", "host", "guest", seed, catalog);
+    BattleRng policy_rng(~seed);
+    scratch.played[kHostSeat].clear();
+    scratch.played[kGuestSeat].clear();
+
+    while (!state.is_finished && state.turn_number <= options.max_turns) {
+        ListLegalActions(state, scratch.actions);
+        const int seat = state.current_seat;
+        const BattleAction action = options.policies[seat](state, scratch.actions, policy_rng);
+        if (action.type == BattleAction::Type::PLAY_CARD) {
+            scratch.played[seat].push_back(state.players[seat].hand[action.arg0].definition);
+        }
+        ApplyAction(state, action);
+        ++stats.actions;
+    }
+
+    ++stats.games;
+    stats.turns += static_cast<std::uint64_t>(std::min(state.turn_number, options.max_turns));
+    int winner_seat = kNoSeat;
+    if (state.is_finished) {
+        winner_seat = state.SeatOf(state.winner);
+        ++stats.wins[winner_seat];
+    } else {
+        ++stats.unfinished;
+    }
+    for (int seat = 0; seat < 2; ++seat) {
+        for (auto definition : scratch.played[seat]) {
+            ++stats.cards[definition].played;
+            if (seat == winner_seat) ++stats.cards[definition].played_by_winner;
+        }
+    }
+}
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+        const std::string value = argv[++i];
+        if (arg == "--games") {
+            options.games = std::stoull(value);
+        } else if (arg == "--threads") {
+            options.threads = static_cast<unsigned>(std::stoul(value));
+        } else if (arg == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (arg == "--max-turns") {
+            options.max_turns = std::stoi(value);
+        } else if (arg == "--host") {
+            options.policies[kHostSeat] = ParsePolicy(value);
+            options.host_policy = value;
+        } else if (arg == "--guest") {
+            options.policies[kGuestSeat] = ParsePolicy(value);
+            options.guest_policy = value;
+        } else if (arg == "--catalog") {
+            options.catalog_path = value;
+        } else {
+            throw std::runtime_error("Unknown option " + arg);
+        }
+    }
+    if (options.threads == 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+    return options;
+}
+
+double Percent(std::uint64_t part, std::uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+}
+
+void Report(const Options& options, const CardCatalog& catalog, const Stats& stats, double seconds,
+            std::uint64_t steals) {
+    const double games_per_second = static_cast<double>(stats.games) / seconds;
+    std::printf("%llu games (%s vs %s) on %u threads in %.2fs: %.0f games/s, %.0f games/s/core, %llu steals\n",
+                static_cast<unsigned long long>(stats.games), options.host_policy.c_str(),
+                options.guest_policy.c_str(), options.threads, seconds, games_per_second,
+                games_per_second / options.threads, static_cast<unsigned long long>(steals));
+    const double games = static_cast<double>(std::max<std::uint64_t>(stats.games, 1));
+    std::printf("host wins %.1f%%, guest wins %.1f%%, unfinished %.1f%%; %.1f turns and %.1f actions per game\n\n",
+                Percent(stats.wins[kHostSeat], stats.games), Percent(stats.wins[kGuestSeat], stats.games),
+                Percent(stats.unfinished, stats.games), static_cast<double>(stats.turns) / games,
+                static_cast<double>(stats.actions) / games);
+
+    // Win rate of the player who played the card; far from 50% hints at a
+    // card that is too strong or too weak for its cost
+    std::printf("%-10s %-18s %4s %12s %14s\n", "card", "name", "cost", "played/game", "win% if played");
+    for (std::size_t i = 0; i < catalog.Size(); ++i) {
+        const CardDefinition definition = catalog.Get(static_cast<std::uint16_t>(i));
+        const auto& card = stats.cards[i];
+        std::printf("%-10.*s %-18.*s %4d %12.2f %14.1f\n", static_cast<int>(definition.id.size()),
+                    definition.id.data(), static_cast<int>(definition.name.size()), definition.name.data(),
+                    definition.mana_cost, static_cast<double>(card.played) / games,
+                    Percent(card.played_by_winner, card.played));
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = ParseOptions(argc, argv);
+        const auto catalog =
+            options.catalog_path.empty() ? MakeBuiltinCardCatalog() : CardCatalog::Load(options.catalog_path);
+
+        std::vector<Stats> worker_stats(options.threads);
+        for (auto& stats : worker_stats) stats.cards.resize(catalog->Size());
+        WorkStealingScheduler scheduler(options.games, options.threads, 64);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        const auto started_at = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned worker = 0; worker < options.threads; ++worker) {
+            workers.emplace_back([&, worker] {
+                Scratch scratch;
+                std::uint64_t begin;
+                std::uint64_t end;
+                try {
+                    while (scheduler.Next(worker, begin, end)) {
+                        for (std::uint64_t game = begin; game < end; ++game) {
+                            PlayGame(options, catalog, game, scratch, worker_stats[worker]);
+                        }
+                    }
+                } catch (...) {
+                    std::lock_guard lock(error_mutex);
+                    if (!error) error = std::current_exception();
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+        if (error) std::rethrow_exception(error);
+
+        Stats total;
+        total.cards.resize(catalog->Size());
+        for (const auto& stats : worker_stats) total.Merge(stats);
+        Report(options, *catalog, total, seconds, scheduler.Steals());
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
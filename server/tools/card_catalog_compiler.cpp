@@ -0,0 +1,44 @@
+// Compiles the text card catalog into the binary image the server maps at
+// startup: CardCatalogCompiler <cards.txt> <cards.bin>
+#include "../include/card_catalog.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <cards.txt> <cards.bin>" << std::endl;
+        return 2;
+    }
+    const std::string source_path = argv[1];
+    const std::string output_path = argv[2];
+
+    try {
+        std::ifstream source(source_path);
+        if (!source) throw std::runtime_error("Failed to open " + source_path);
+        auto cards = cardbattle::CardCatalog::ParseText(source, source_path);
+        std::string image = cardbattle::CardCatalog::Compile(cards);
+
+        // Check the image maps back before publishing it
+        cardbattle::CardCatalog::FromImage(image, output_path);
+
+        // Write next to the target and rename, so a running server never maps
+        // a half-written file
+        const std::string temp_path = output_path + ".tmp";
+        {
+            std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+            output.write(image.data(), static_cast<std::streamsize>(image.size()));
+            output.flush();
+            if (!output) throw std::runtime_error("Failed to write " + temp_path);
+        }
+        if (std::rename(temp_path.c_str(), output_path.c_str()) != 0) {
+            std::remove(temp_path.c_str());
+            throw std::runtime_error("Failed to rename " + temp_path + " to " + output_path);
+        }
+        std::cout << "Compiled " << cards.size() << " cards into " << output_path << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
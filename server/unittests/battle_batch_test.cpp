@@ -0,0 +1,163 @@
+// Checks the BattleBatch kernels against the scalar rules: many battles
+// played with random legal moves, each lane compared after every step.
+// Usage: battle_batch_test
+
+#include "battle_batch.hpp"
+#include "battle_rules.hpp"
+#include "card_catalog.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace cardbattle;
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                    \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__,     \
+                         __LINE__, #condition);                              \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (false)
+
+template <typename Zone>
+bool SameCards(const Zone& a, const Zone& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (a[i].definition != b[i].definition || a[i].attack != b[i].attack || a[i].defense != b[i].defense ||
+            a[i].used_this_turn != b[i].used_this_turn) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Everything the kernels keep; strings other than the winner are not
+bool SameBattle(const BattleState& a, const BattleState& b) {
+    if (a.current_seat != b.current_seat || a.turn_number != b.turn_number || a.is_finished != b.is_finished ||
+        a.winner != b.winner) {
+        return false;
+    }
+    for (int seat = 0; seat < 2; ++seat) {
+        const auto& x = a.players[seat];
+        const auto& y = b.players[seat];
+        if (x.health != y.health || x.max_health != y.max_health || x.mana != y.mana || x.max_mana != y.max_mana ||
+            x.is_active != y.is_active || !SameCards(x.hand, y.hand) || !SameCards(x.deck, y.deck) ||
+            !SameCards(x.field, y.field) || !SameCards(x.graveyard, y.graveyard)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestRoundTrip() {
+    auto catalog = MakeBuiltinCardCatalog();
+    BattleBatch batch(3, catalog);
+    BattleState state = NewBattleState("1", "host", "guest", 7, catalog);
+    batch.Load(1, state);
+    BattleState stored = state;
+    stored.players[0].hand.clear();
+    stored.players[1].health = 1;
+    batch.Store(1, stored);
+    EXPECT(SameBattle(state, stored));
+    EXPECT(batch.Health(0)[1] == 30);
+    EXPECT(batch.FieldCount(1)[1] == 0);
+
+    BattleState other = NewBattleState("2", "host", "guest", 7, MakeBuiltinCardCatalog());
+    bool threw = false;
+    try {
+        batch.Load(0, other);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT(threw);
+}
+
+// Lanes move in lockstep, each with its own random legal move: attacks and
+// end turns through the kernels, card plays through the rules and reloaded
+void TestMatchesRules() {
+    constexpr std::size_t kLanes = 300;  // Not a multiple of the vector width
+    auto catalog = MakeBuiltinCardCatalog();
+    std::mt19937_64 random(42);
+    BattleBatch batch(kLanes, catalog);
+    std::vector<BattleState> reference;
+    for (std::size_t lane = 0; lane < kLanes; ++lane) {
+        reference.push_back(NewBattleState(std::to_string(lane), "host", "guest", random(), catalog));
+        batch.Load(lane, reference.back());
+    }
+
+    std::vector<std::int16_t> attacking(kLanes), ending(kLanes), attacker(kLanes), target(kLanes), ready(kLanes);
+    std::vector<BattleAction> actions;
+    int attacks = 0, finished = 0;
+    for (int step = 0; step < 2000; ++step) {
+        batch.FindReadyAttacker(ready.data());
+        for (std::size_t lane = 0; lane < kLanes; ++lane) {
+            BattleState& state = reference[lane];
+            attacking[lane] = ending[lane] = 0;
+            ListLegalActions(state, actions);
+
+            int first_ready = -1;
+            for (const auto& action : actions) {
+                if (action.type == BattleAction::Type::ATTACK) {
+                    first_ready = action.arg0;
+                    break;
+                }
+            }
+            EXPECT(ready[lane] == first_ready);
+
+            if (actions.empty()) continue;
+            const BattleAction action = actions[random() % actions.size()];
+            if (action.type == BattleAction::Type::PLAY_CARD) {
+                ApplyAction(state, action);
+                batch.Load(lane, state);
+            } else if (action.type == BattleAction::Type::ATTACK) {
+                ApplyAction(state, action);
+                attacking[lane] = 1;
+                attacker[lane] = static_cast<std::int16_t>(action.arg0);
+                target[lane] = static_cast<std::int16_t>(action.arg1);
+                ++attacks;
+            } else {
+                ApplyAction(state, action);
+                ending[lane] = 1;
+            }
+        }
+        batch.Attack(attacking.data(), attacker.data(), target.data());
+        batch.EndTurn(ending.data());
+
+        for (std::size_t lane = 0; lane < kLanes; ++lane) {
+            BattleState stored = reference[lane];
+            batch.Store(lane, stored);
+            if (!SameBattle(stored, reference[lane])) {
+                std::fprintf(stderr, "lane %zu differs after step %d\n", lane, step);
+                ++g_failures;
+                return;
+            }
+        }
+    }
+    for (std::size_t lane = 0; lane < kLanes; ++lane) {
+        finished += batch.Finished()[lane];
+        if (batch.Finished()[lane]) EXPECT(reference[lane].players[batch.Winner()[lane]].player_id == reference[lane].winner);
+    }
+    EXPECT(attacks > 0);
+    EXPECT(finished == static_cast<int>(kLanes));
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip();
+    TestMatchesRules();
+    if (g_failures != 0) {
+        std::fprintf(stderr, "%d expectation(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All battle batch tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+// Tests for the Monte Carlo tree search behind the server's bot.
+// Usage: battle_mcts_test
+
+#include "battle_mcts.hpp"
+#include "card_catalog.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace cardbattle;
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                    \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__,     \
+                         __LINE__, #condition);                              \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (false)
+
+const auto kNoDeadline = std::chrono::steady_clock::time_point::max();
+
+MctsSettings Iterations(std::size_t count) {
+    MctsSettings settings;
+    settings.max_iterations = count;
+    settings.rollout_depth = 20;
+    return settings;
+}
+
+bool SameAction(const BattleAction& a, const BattleAction& b) {
+    return a.type == b.type && a.arg0 == b.arg0 && a.arg1 == b.arg1;
+}
+
+// Has the bot move with `trees` trees of `iterations` each
+BattleAction Search(const BattleState& state, std::uint64_t seed, std::size_t iterations, int trees = 2) {
+    std::vector<MctsRootStats> stats;
+    for (int tree = 0; tree < trees; ++tree) {
+        stats.push_back(RunMctsTree(state, seed + tree, Iterations(iterations), kNoDeadline));
+    }
+    return PickMctsAction(stats);
+}
+
+void TestRootStats() {
+    const BattleState state = NewBattleState("1", "host", "guest", 3, MakeBuiltinCardCatalog());
+    const auto stats = RunMctsTree(state, 11, Iterations(200), kNoDeadline);
+    std::vector<BattleAction> legal;
+    ListLegalActions(state, legal);
+    EXPECT(stats.iterations == 200);
+    EXPECT(stats.actions.size() == legal.size());
+    EXPECT(stats.visits.size() == legal.size());
+    std::uint64_t visits = 0;
+    for (std::size_t i = 0; i < legal.size() && i < stats.actions.size(); ++i) {
+        EXPECT(SameAction(stats.actions[i], legal[i]));
+        EXPECT(stats.rewards[i] >= 0 && stats.rewards[i] <= stats.visits[i]);
+        visits += stats.visits[i];
+    }
+    EXPECT(visits == 200);
+
+    // Same seed, same search
+    const auto again = RunMctsTree(state, 11, Iterations(200), kNoDeadline);
+    EXPECT(again.visits == stats.visits);
+
+    // The search never changes the state it is given
+    EXPECT(state.version == 0 && state.players[0].hand.size() == 4);
+
+    BattleState finished = state;
+    finished.is_finished = true;
+    EXPECT(RunMctsTree(finished, 1, Iterations(10), kNoDeadline).actions.empty());
+}
+
+void TestDeadline() {
+    const BattleState state = NewBattleState("1", "host", "guest", 3, MakeBuiltinCardCatalog());
+    // Past deadline: still one iteration, so there is always a move
+    const auto stats = RunMctsTree(state, 1, MctsSettings{}, std::chrono::steady_clock::now());
+    EXPECT(stats.iterations == 1);
+    EXPECT(!stats.actions.empty());
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto timed = RunMctsTree(state, 1, MctsSettings{}, start + std::chrono::milliseconds{50});
+    EXPECT(std::chrono::steady_clock::now() - start < std::chrono::seconds{1});
+    EXPECT(timed.iterations > 1);
+}
+
+void TestPickSumsTrees() {
+    MctsRootStats a, b;
+    a.actions = b.actions = {{BattleAction::Type::PLAY_CARD, 0, 0}, {BattleAction::Type::END_TURN, 0, 0}};
+    a.visits = {10, 3};
+    b.visits = {0, 8};
+    a.rewards = b.rewards = {0, 0};
+    EXPECT(PickMctsAction({a}).type == BattleAction::Type::PLAY_CARD);
+    EXPECT(PickMctsAction({a, b}).type == BattleAction::Type::END_TURN);
+    EXPECT(PickMctsAction({MctsRootStats{}, b}).type == BattleAction::Type::END_TURN);
+
+    bool threw = false;
+    try {
+        PickMctsAction({MctsRootStats{}});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT(threw);
+}
+
+// The opponent is in reach: the bot finishes the game this turn
+void TestTakesLethal() {
+    auto catalog = MakeBuiltinCardCatalog();
+    BattleState state = NewBattleState("1", "host", "guest", 5, catalog);
+    for (std::uint16_t definition = 0; definition < catalog->Size(); ++definition) {
+        const Card card = catalog->Instantiate(definition);
+        if (card.attack >= 3) {
+            state.players[kHostSeat].field.push_back(card);
+            break;
+        }
+    }
+    EXPECT(!state.players[kHostSeat].field.empty());
+    state.players[kGuestSeat].health = 3;
+    for (int move = 0; move < 20 && !state.is_finished && state.current_seat == kHostSeat; ++move) {
+        ApplyAction(state, Search(state, move, 300));
+    }
+    EXPECT(state.is_finished);
+    EXPECT(state.winner == "host");
+}
+
+// A small search already beats a player that picks any legal move
+void TestBeatsRandom() {
+    auto catalog = MakeBuiltinCardCatalog();
+    BattleRng random(99);
+    std::vector<BattleAction> actions;
+    constexpr int kGames = 10;
+    int wins = 0;
+    for (int game = 0; game < kGames; ++game) {
+        BattleState state = NewBattleState(std::to_string(game), "host", "guest", game, catalog);
+        for (int move = 0; move < 1000 && !state.is_finished; ++move) {
+            if (state.current_seat == kGuestSeat) {
+                ApplyAction(state, Search(state, game * 1000 + move, 100));
+            } else {
+                ListLegalActions(state, actions);
+                ApplyAction(state, actions[random.NextBelow(static_cast<std::uint32_t>(actions.size()))]);
+            }
+        }
+        wins += state.winner == "guest";
+    }
+    EXPECT(wins >= 8);
+}
+
+} // namespace
+
+int main() {
+    TestRootStats();
+    TestDeadline();
+    TestPickSumsTrees();
+    TestTakesLethal();
+    TestBeatsRandom();
+    if (g_failures != 0) {
+        std::fprintf(stderr, "%d expectation(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All battle MCTS tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+// Checks journal replay and segment retirement: battles are played, ended,
+// hibernated and snapshotted at random while their records go into
+// segments, the segments recovery no longer needs are retired the way
+// BattleManager::RetireJournalSegments does it, and replaying what is left
+// must still give back exactly the battles that were live.
+// Usage: battle_replay_test
+
+#include "battle_replay.hpp"
+#include "battle_rules.hpp"
+#include "battle_state_codec.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+using namespace cardbattle;
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                    \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__,     \
+                         __LINE__, #condition);                              \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (false)
+
+JournalRecord View(const OwnedJournalRecord& record) {
+    JournalRecord view;
+    view.type = record.type;
+    view.seat = record.seat;
+    view.arg0 = record.arg0;
+    view.arg1 = record.arg1;
+    view.version = record.version;
+    view.seed = record.seed;
+    view.session_id = record.session_id;
+    view.host_id = record.host_id;
+    view.guest_id = record.guest_id;
+    return view;
+}
+
+// The parts of the server recovery depends on: resident and hibernated
+// battles, the snapshot table and the journal
+class Server {
+public:
+    explicit Server(std::size_t records_per_segment) : records_per_segment_(records_per_segment) { Roll(); }
+
+    void Start(const std::string& session_id, std::uint64_t seed) {
+        resident_[session_id] = NewBattleState(session_id, "host-" + session_id, "guest-" + session_id, seed, catalog_);
+        OwnedJournalRecord record;
+        record.type = JournalRecordType::BATTLE_STARTED;
+        record.session_id = session_id;
+        record.seed = seed;
+        record.host_id = "host-" + session_id;
+        record.guest_id = "guest-" + session_id;
+        Append(record);
+    }
+
+    void Act(const std::string& session_id, std::mt19937_64& random) {
+        auto& state = resident_.at(session_id);
+        std::vector<BattleAction> actions;
+        ListLegalActions(state, actions);
+        if (actions.empty()) return;
+        const auto action = actions[random() % actions.size()];
+        OwnedJournalRecord record;
+        record.seat = state.current_seat;
+        record.arg0 = action.arg0;
+        record.arg1 = action.arg1;
+        switch (action.type) {
+            case BattleAction::Type::PLAY_CARD:
+                record.type = JournalRecordType::PLAY_CARD;
+                break;
+            case BattleAction::Type::ATTACK:
+                record.type = JournalRecordType::ATTACK;
+                break;
+            case BattleAction::Type::END_TURN:
+                record.type = JournalRecordType::END_TURN;
+                break;
+        }
+        ApplyJournaled(state, record.type, record.seat, record.arg0, record.arg1);
+        record.version = ++state.version;
+        rehydrated_.erase(session_id);
+        record.session_id = session_id;
+        Append(record);
+    }
+
+    void End(const std::string& session_id) {
+        resident_.erase(session_id);
+        rehydrated_.erase(session_id);
+        OwnedJournalRecord record;
+        record.type = JournalRecordType::BATTLE_ENDED;
+        record.session_id = session_id;
+        Append(record);
+    }
+
+    void Hibernate(const std::string& session_id) {
+        auto node = resident_.extract(session_id);
+        rehydrated_.erase(session_id);
+        OwnedJournalRecord record;
+        record.type = JournalRecordType::BATTLE_HIBERNATED;
+        record.version = node.mapped().version;
+        record.session_id = session_id;
+        hibernated_.insert(std::move(node));
+        Append(record);
+    }
+
+    void Rehydrate(const std::string& session_id) {
+        resident_.insert(hibernated_.extract(session_id));
+        rehydrated_.insert(session_id);
+    }
+
+    // BattleSnapshotWriter::Flush with every battle dirty: rows of resident
+    // battles are written, hibernated ones keep theirs, gone ones lose them
+    void FlushSnapshots() {
+        for (auto it = rows_.begin(); it != rows_.end();) {
+            const bool live = resident_.count(it->first) || hibernated_.count(it->first);
+            it = live ? std::next(it) : rows_.erase(it);
+        }
+        for (const auto& [session_id, state] : resident_) rows_.insert_or_assign(session_id, state);
+    }
+
+    bool SnapshotIsCurrent(const std::string& session_id) const {
+        auto it = rows_.find(session_id);
+        return it != rows_.end() && it->second.version == resident_.at(session_id).version;
+    }
+
+    // BattleJournal::Retire with BattleManager's callbacks
+    std::size_t Retire() {
+        std::vector<std::shared_ptr<const JournalSegmentSummary>> sealed(summaries_.begin(), summaries_.end() - 1);
+        const auto count = RetirableSegments(sealed, [&](const std::string& session_id,
+                                                         const JournalSegmentSummary::Battle& battle) {
+            std::optional<std::uint64_t> snapshot_version;
+            if (auto it = rows_.find(session_id); it != rows_.end()) snapshot_version = it->second.version;
+            const bool live = resident_.count(session_id) || hibernated_.count(session_id);
+            return IsJournalCovered(battle, snapshot_version, live);
+        });
+        std::unordered_set<std::string> carried;
+        for (std::size_t i = 0; i < count; ++i) {
+            for (const auto& [session_id, battle] : sealed[i]->battles) {
+                if (battle.ended || !hibernated_.count(session_id) || !carried.insert(session_id).second) continue;
+                OwnedJournalRecord record;
+                record.type = JournalRecordType::BATTLE_HIBERNATED;
+                record.version = battle.max_version;
+                record.session_id = session_id;
+                Append(record);
+            }
+        }
+        segments_.erase(segments_.begin(), segments_.begin() + static_cast<std::ptrdiff_t>(count));
+        summaries_.erase(summaries_.begin(), summaries_.begin() + static_cast<std::ptrdiff_t>(count));
+        retired_ += count;
+        return count;
+    }
+
+    // Encoded states of what recovery restores, by session
+    std::map<std::string, std::string> Recover(const std::vector<std::vector<OwnedJournalRecord>>& segments) const {
+        std::vector<BattleState> snapshots;
+        for (const auto& [session_id, state] : rows_) snapshots.push_back(state);
+        auto result = ReplayJournal(segments, std::move(snapshots), catalog_, 4);
+        EXPECT(result.failed.empty());
+        for (const auto& [session_id, error] : result.failed) {
+            std::fprintf(stderr, "  %s: %s\n", session_id.c_str(), error.c_str());
+        }
+        std::map<std::string, std::string> recovered;
+        for (const auto& state : result.battles) recovered[state.session_id] = EncodeBattleState(state);
+        return recovered;
+    }
+
+    // Whether recovery restored exactly the live battles. One rehydrated
+    // but not played since may also be left to the hibernator, whose file
+    // holds the same state.
+    bool Matches(const std::map<std::string, std::string>& recovered) const {
+        for (const auto& [session_id, state] : resident_) {
+            auto it = recovered.find(session_id);
+            if (it == recovered.end() ? !rehydrated_.count(session_id) : it->second != EncodeBattleState(state)) {
+                return false;
+            }
+        }
+        for (const auto& [session_id, state] : recovered) {
+            if (!resident_.count(session_id)) return false;
+        }
+        return true;
+    }
+
+    const std::vector<std::vector<OwnedJournalRecord>>& Segments() const { return segments_; }
+    const std::vector<std::vector<OwnedJournalRecord>>& History() const { return history_; }
+    std::map<std::string, BattleState>& ResidentBattles() { return resident_; }
+    std::map<std::string, BattleState>& HibernatedBattles() { return hibernated_; }
+    std::size_t Retired() const { return retired_; }
+
+private:
+    void Append(const OwnedJournalRecord& record) {
+        if (segments_.back().size() == records_per_segment_) Roll();
+        segments_.back().push_back(record);
+        history_.back().push_back(record);
+        summaries_.back()->Add(View(record));
+    }
+
+    void Roll() {
+        segments_.emplace_back();
+        history_.emplace_back();
+        summaries_.push_back(std::make_shared<JournalSegmentSummary>());
+    }
+
+    const std::shared_ptr<const CardCatalog> catalog_ = MakeBuiltinCardCatalog();
+    const std::size_t records_per_segment_;
+    std::map<std::string, BattleState> resident_;
+    std::map<std::string, BattleState> hibernated_;
+    std::map<std::string, BattleState> rows_;
+    std::unordered_set<std::string> rehydrated_;  // Not played since
+    std::vector<std::vector<OwnedJournalRecord>> segments_;  // What is left on disk
+    std::vector<std::vector<OwnedJournalRecord>> history_;   // Everything ever appended
+    std::vector<std::shared_ptr<JournalSegmentSummary>> summaries_;
+    std::size_t retired_ = 0;
+};
+
+std::string Pick(const std::map<std::string, BattleState>& battles, std::mt19937_64& random) {
+    auto it = battles.begin();
+    std::advance(it, static_cast<std::ptrdiff_t>(random() % battles.size()));
+    return it->first;
+}
+
+void TestRecoveryMatchesAfterRetirement(bool snapshots) {
+    std::mt19937_64 random(snapshots ? 11 : 12);
+    Server server(64);
+    int next_session = 0;
+    for (int step = 0; step < 20000; ++step) {
+        auto& resident = server.ResidentBattles();
+        auto& hibernated = server.HibernatedBattles();
+        const auto roll = random() % 100;
+        if (resident.size() < 8 && roll < 5) {
+            // Now and then an id comes back, as session ids may
+            const auto id = next_session > 0 && roll == 0 ? random() % next_session : next_session++;
+            const auto session_id = "s" + std::to_string(id);
+            if (!resident.count(session_id) && !hibernated.count(session_id)) server.Start(session_id, random());
+        } else if (!resident.empty() && roll < 90) {
+            const auto session_id = Pick(resident, random);
+            if (resident.at(session_id).is_finished) {
+                server.End(session_id);
+            } else {
+                server.Act(session_id, random);
+            }
+        } else if (!resident.empty() && roll < 93) {
+            server.End(Pick(resident, random));
+        } else if (!resident.empty() && roll < 96) {
+            // Finished battles are evicted, never hibernated; idle ones go
+            // long after their last snapshot was written
+            const auto session_id = Pick(resident, random);
+            if (!resident.at(session_id).is_finished && (!snapshots || server.SnapshotIsCurrent(session_id))) {
+                server.Hibernate(session_id);
+            }
+        } else if (!hibernated.empty() && roll < 98) {
+            server.Rehydrate(Pick(hibernated, random));
+        } else if (!hibernated.empty()) {
+            // Expired from disk
+            const auto session_id = Pick(hibernated, random);
+            server.Rehydrate(session_id);
+            server.End(session_id);
+        }
+
+        if (step % 100 == 99) {
+            if (snapshots) server.FlushSnapshots();
+            server.Retire();
+            EXPECT(server.Matches(server.Recover(server.Segments())));
+        }
+    }
+    // Everything but the live battles' tails goes
+    EXPECT(server.Retired() > 0);
+    EXPECT(server.Segments().size() < server.History().size() / 2);
+}
+
+void TestSummary() {
+    JournalSegmentSummary summary;
+    OwnedJournalRecord record;
+    record.session_id = "a";
+    record.type = JournalRecordType::PLAY_CARD;
+    record.version = 7;
+    summary.Add(View(record));
+    record.type = JournalRecordType::BATTLE_ENDED;
+    record.version = 0;
+    summary.Add(View(record));
+    EXPECT(summary.battles.at("a").ended);
+    // A reused id starts over
+    record.type = JournalRecordType::BATTLE_STARTED;
+    summary.Add(View(record));
+    EXPECT(!summary.battles.at("a").ended);
+    EXPECT(summary.battles.at("a").max_version == 0);
+
+    const JournalSegmentSummary::Battle ended{0, true};
+    const JournalSegmentSummary::Battle running{5, false};
+    EXPECT(IsJournalCovered(ended, std::nullopt, false));
+    EXPECT(!IsJournalCovered(ended, 9, false));  // The row would bring it back
+    EXPECT(IsJournalCovered(running, 5, true));
+    EXPECT(!IsJournalCovered(running, 4, true));
+    EXPECT(!IsJournalCovered(running, std::nullopt, true));
+    EXPECT(IsJournalCovered(running, std::nullopt, false));
+}
+
+} // namespace
+
+int main() {
+    TestSummary();
+    TestRecoveryMatchesAfterRetirement(true);
+    TestRecoveryMatchesAfterRetirement(false);
+    if (g_failures != 0) {
+        std::fprintf(stderr, "%d expectation(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All battle replay tests passed\n");
+    return EXIT_SUCCESS;
+}
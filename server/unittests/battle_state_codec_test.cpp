@@ -0,0 +1,258 @@
+// Round-trip tests for the binary BattleState codec.
+// Usage: battle_state_codec_test
+
+#include "battle_state_codec.hpp"
+#include "card_catalog.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+using namespace cardbattle;
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                    \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__,     \
+                         __LINE__, #condition);                              \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (false)
+
+constexpr const char* kCards =
+    "fire_imp|Fire Imp|A small demon|3|2|2|creature|\n"
+    "stone_golem|Stone Golem|Slow but sturdy|2|6|4|creature|\n"
+    "fireball|Fireball|Deals 3 damage|0|0|3|spell|damage:opponent:3\n"
+    "heal|Heal|Restores 4 health|0|0|2|spell|heal:self:4\n";
+
+std::shared_ptr<const CardCatalog> MakeCatalog(bool reversed) {
+    std::istringstream input(kCards);
+    auto specs = CardCatalog::ParseText(input, "test");
+    if (reversed) std::reverse(specs.begin(), specs.end());
+    return CardCatalog::FromImage(CardCatalog::Compile(specs), "test");
+}
+
+BattleState MakeBattle(const std::shared_ptr<const CardCatalog>& catalog, std::uint64_t seed) {
+    BattleState state;
+    state.catalog = catalog;
+    state.session_id = "session-" + std::to_string(seed);
+    state.version = 1000 + seed;
+    state.current_seat = static_cast<int>(seed % 2);
+    state.turn_number = static_cast<int>(seed % 40) + 1;
+    state.last_action = "Attack with Fire Imp";
+    state.seed = seed * 0x9E3779B97F4A7C15ull;
+    state.rng.Seed(state.seed);
+    state.rng.Next();
+
+    BattleRng rng;
+    rng.Seed(seed);
+    for (int seat = 0; seat < 2; ++seat) {
+        auto& player = state.players[seat];
+        player.player_id = seat == kHostSeat ? "host-user" : "guest-user-with-a-longer-id";
+        player.health = static_cast<int>(rng.NextBelow(31)) - 5;  // Negative after overkill
+        player.max_health = 30;
+        player.mana = static_cast<int>(rng.NextBelow(11));
+        player.max_mana = 10;
+        player.is_active = seat == state.current_seat;
+        auto random_card = [&] {
+            Card card = catalog->Instantiate(static_cast<std::uint16_t>(rng.NextBelow(catalog->Size())));
+            card.attack = static_cast<std::int16_t>(card.attack + static_cast<int>(rng.NextBelow(5)) - 2);
+            card.defense = static_cast<std::int16_t>(card.defense - static_cast<int>(rng.NextBelow(300)));
+            card.used_this_turn = rng.NextBelow(2) == 1;
+            return card;
+        };
+        for (std::uint32_t i = rng.NextBelow(10); i > 0; --i) player.hand.push_back(random_card());
+        for (std::uint32_t i = rng.NextBelow(30); i > 0; --i) player.deck.push_back(random_card());
+        for (std::uint32_t i = rng.NextBelow(7); i > 0; --i) player.field.push_back(random_card());
+        for (std::uint32_t i = rng.NextBelow(20); i > 0; --i) player.graveyard.push_back(random_card());
+    }
+    if (seed % 3 == 0) {
+        state.is_finished = true;
+        state.winner = state.players[kGuestSeat].player_id;
+    }
+    return state;
+}
+
+template <typename Zone>
+bool SameCards(const Zone& left, const std::shared_ptr<const CardCatalog>& left_catalog, const Zone& right,
+               const std::shared_ptr<const CardCatalog>& right_catalog) {
+    if (left.size() != right.size()) return false;
+    for (std::size_t i = 0; i < left.size(); ++i) {
+        if (left_catalog->Get(left[i].definition).id != right_catalog->Get(right[i].definition).id ||
+            left[i].attack != right[i].attack || left[i].defense != right[i].defense ||
+            left[i].used_this_turn != right[i].used_this_turn) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SameState(const BattleState& left, const BattleState& right) {
+    if (left.session_id != right.session_id || left.version != right.version ||
+        left.current_seat != right.current_seat || left.turn_number != right.turn_number ||
+        left.winner != right.winner || left.is_finished != right.is_finished ||
+        left.last_action != right.last_action || left.seed != right.seed) {
+        return false;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (left.rng.State()[i] != right.rng.State()[i]) return false;
+    }
+    for (int seat = 0; seat < 2; ++seat) {
+        const auto& a = left.players[seat];
+        const auto& b = right.players[seat];
+        if (a.player_id != b.player_id || a.health != b.health || a.max_health != b.max_health ||
+            a.mana != b.mana || a.max_mana != b.max_mana || a.is_active != b.is_active ||
+            !SameCards(a.hand, left.catalog, b.hand, right.catalog) ||
+            !SameCards(a.deck, left.catalog, b.deck, right.catalog) ||
+            !SameCards(a.field, left.catalog, b.field, right.catalog) ||
+            !SameCards(a.graveyard, left.catalog, b.graveyard, right.catalog)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Throws(std::string_view data, const std::shared_ptr<const CardCatalog>& catalog) {
+    try {
+        DecodeBattleState(data, catalog);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void TestRoundTrip() {
+    auto catalog = MakeCatalog(false);
+    for (std::uint64_t seed = 1; seed <= 500; ++seed) {
+        auto state = MakeBattle(catalog, seed);
+        auto encoded = EncodeBattleState(state);
+        auto decoded = DecodeBattleState(encoded, catalog);
+        EXPECT(SameState(state, decoded));
+        EXPECT(decoded.catalog == catalog);
+        // Deterministic, so equal states give equal snapshots
+        EXPECT(EncodeBattleState(decoded) == encoded);
+    }
+}
+
+void TestEmptyState() {
+    auto catalog = MakeCatalog(false);
+    BattleState state;
+    state.catalog = catalog;
+    auto decoded = DecodeBattleState(EncodeBattleState(state), catalog);
+    EXPECT(SameState(state, decoded));
+}
+
+void TestRngContinues() {
+    auto catalog = MakeCatalog(false);
+    auto state = MakeBattle(catalog, 42);
+    auto decoded = DecodeBattleState(EncodeBattleState(state), catalog);
+    for (int i = 0; i < 100; ++i) EXPECT(state.rng.Next() == decoded.rng.Next());
+}
+
+void TestReorderedCatalog() {
+    // Cards are stored by id, so a catalog with a different order still
+    // resolves every card to the same definition
+    auto catalog = MakeCatalog(false);
+    auto reordered = MakeCatalog(true);
+    auto state = MakeBattle(catalog, 7);
+    auto decoded = DecodeBattleState(EncodeBattleState(state), reordered);
+    EXPECT(SameState(state, decoded));
+}
+
+void TestCatalogReloadWhileHibernated() {
+    // BattleManager hibernates a battle with the catalog it runs on and
+    // decodes it against that one, whatever was loaded in between
+    auto pinned = MakeCatalog(false);
+    auto state = MakeBattle(pinned, 12);
+    const auto stored = EncodeBattleState(state);
+
+    // The reload rebalances Fireball and drops Heal
+    std::istringstream input(
+        "fire_imp|Fire Imp|A small demon|3|2|2|creature|\n"
+        "stone_golem|Stone Golem|Slow but sturdy|2|6|4|creature|\n"
+        "fireball|Fireball|Deals 5 damage|0|0|5|spell|damage:opponent:5\n");
+    auto reloaded = CardCatalog::FromImage(CardCatalog::Compile(CardCatalog::ParseText(input, "reloaded")), "reloaded");
+
+    auto rehydrated = DecodeBattleState(stored, pinned);
+    EXPECT(rehydrated.catalog == pinned);
+    EXPECT(SameState(state, rehydrated));
+    const auto fireball = rehydrated.catalog->Find("fireball");
+    EXPECT(fireball && rehydrated.catalog->Get(*fireball).mana_cost == 3);
+    EXPECT(rehydrated.catalog->Find("heal").has_value());
+
+    // What the reloaded catalog would have made of it
+    EXPECT(Throws(stored, reloaded));
+}
+
+void TestMalformedInput() {
+    auto catalog = MakeCatalog(false);
+    auto encoded = EncodeBattleState(MakeBattle(catalog, 9));
+
+    EXPECT(Throws("", catalog));
+    EXPECT(Throws("{\"session_id\":\"1\"}", catalog));
+    for (std::size_t size = 0; size < encoded.size(); ++size) {
+        EXPECT(Throws(std::string_view(encoded).substr(0, size), catalog));
+    }
+    EXPECT(Throws(encoded + '\0', catalog));
+
+    auto future_version = encoded;
+    future_version[2] = static_cast<char>(kBattleStateCodecVersion + 1);
+    EXPECT(Throws(future_version, catalog));
+
+    // A card the catalog no longer has
+    std::istringstream input("fire_imp|Fire Imp|A small demon|3|2|2|creature|\n");
+    auto smaller = CardCatalog::FromImage(CardCatalog::Compile(CardCatalog::ParseText(input, "small")), "small");
+    EXPECT(Throws(encoded, smaller));
+}
+
+void TestMalformedEffects() {
+    // damage:opponent with an amount whose bytes stand out in the image
+    std::istringstream input("bolt|Bolt|Unlikely damage|0|0|1|spell|damage:opponent:12345\n");
+    const auto image = CardCatalog::Compile(CardCatalog::ParseText(input, "effects"));
+    const std::string effect = {static_cast<char>(EffectOp::DAMAGE), static_cast<char>(EffectTarget::OPPONENT),
+                                '\x39', '\x30'};
+    const auto at = image.find(effect);
+    EXPECT(at != std::string::npos);
+    if (at == std::string::npos) return;
+
+    auto loads = [](std::string bytes) {
+        try {
+            CardCatalog::FromImage(std::move(bytes), "effects");
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        return true;
+    };
+    EXPECT(loads(image));
+    auto bad_op = image;
+    bad_op[at] = static_cast<char>(static_cast<int>(EffectOp::DRAW) + 1);
+    EXPECT(!loads(bad_op));
+    auto bad_target = image;
+    bad_target[at + 1] = static_cast<char>(static_cast<int>(EffectTarget::OPPONENT_FIELD) + 1);
+    EXPECT(!loads(bad_target));
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip();
+    TestEmptyState();
+    TestRngContinues();
+    TestReorderedCatalog();
+    TestCatalogReloadWhileHibernated();
+    TestMalformedInput();
+    TestMalformedEffects();
+    if (g_failures != 0) {
+        std::fprintf(stderr, "%d expectation(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All battle state codec tests passed\n");
+    return EXIT_SUCCESS;
+}
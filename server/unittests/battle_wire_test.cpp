@@ -0,0 +1,212 @@
+// Tests for the binary battle socket protocol.
+// Usage: battle_wire_test
+
+#include "battle_rules.hpp"
+#include "battle_wire.hpp"
+#include "card_catalog.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace cardbattle;
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                    \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__,     \
+                         __LINE__, #condition);                              \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (false)
+
+// What a client should see of `state`, built straight from it
+template <typename Zone>
+std::vector<WireCard> ExpectedZone(const Zone& zone, const CardCatalog& catalog) {
+    std::vector<WireCard> cards;
+    for (const auto& card : zone) {
+        const CardDefinition definition = catalog.Get(card.definition);
+        cards.push_back(WireCard{std::string(definition.id), std::string(definition.name), card.attack,
+                                 card.defense, definition.mana_cost, static_cast<int>(definition.type)});
+    }
+    return cards;
+}
+
+WireBattleState Expected(const BattleState& state) {
+    WireBattleState expected;
+    expected.session_id = state.session_id;
+    expected.version = state.version;
+    expected.current_turn = state.CurrentPlayerId();
+    expected.turn_number = state.turn_number;
+    expected.is_finished = state.is_finished;
+    expected.winner = state.winner;
+    expected.last_action = state.last_action;
+    for (int seat = 0; seat < 2; ++seat) {
+        const auto& player = state.players[seat];
+        auto& wire = expected.players[seat];
+        wire.player_id = player.player_id;
+        wire.health = player.health;
+        wire.max_health = player.max_health;
+        wire.mana = player.mana;
+        wire.max_mana = player.max_mana;
+        wire.is_active = player.is_active;
+        wire.hand = ExpectedZone(player.hand, *state.catalog);
+        wire.field = ExpectedZone(player.field, *state.catalog);
+        wire.deck_count = static_cast<int>(player.deck.size());
+        wire.graveyard = ExpectedZone(player.graveyard, *state.catalog);
+    }
+    return expected;
+}
+
+bool ApplyThrows(WireBattleState state, std::string_view delta) {
+    try {
+        ApplyWireDelta(state, delta);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+bool DecodeThrows(std::string_view data) {
+    try {
+        DecodeWireState(data);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+bool DecodeActionThrows(std::string_view data) {
+    try {
+        DecodeClientAction(data);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Random games: every state decodes to what it shows, and a client that
+// applies every delta to the first state stays in step with the battle
+void TestStatesAndDeltas() {
+    const auto catalog = MakeBuiltinCardCatalog();
+    std::vector<BattleAction> actions;
+    for (std::uint64_t seed = 1; seed <= 100; ++seed) {
+        BattleState state = NewBattleState("session-" + std::to_string(seed), "host", "guest", seed, catalog);
+        WireBattleState client = DecodeWireState(EncodeWireState(state));
+        EXPECT(client == Expected(state));
+        BattleRng rng(seed);
+        for (int step = 0; step < 300 && !state.is_finished; ++step) {
+            const BattleState before = state;
+            ListLegalActions(state, actions);
+            ApplyAction(state, actions[rng.NextBelow(static_cast<std::uint32_t>(actions.size()))]);
+            ++state.version;
+            ApplyWireDelta(client, EncodeWireDelta(before, state));
+            EXPECT(client == Expected(state));
+            EXPECT(DecodeWireState(EncodeWireState(state)) == client);
+        }
+    }
+}
+
+void TestDeltaIsSmall() {
+    const auto catalog = MakeBuiltinCardCatalog();
+    BattleState state = NewBattleState("1", "host", "guest", 5, catalog);
+    for (int turn = 0; turn < 6; ++turn) ApplyEndTurn(state, state.current_seat);
+    const BattleState before = state;
+    ApplyEndTurn(state, state.current_seat);
+    ++state.version;
+    EXPECT(EncodeWireDelta(before, state).size() * 3 < EncodeWireState(state).size());
+    // Nothing changed: only the header
+    EXPECT(EncodeWireDelta(state, state).size() < 8);
+}
+
+void TestDeltaNeedsBaseVersion() {
+    const auto catalog = MakeBuiltinCardCatalog();
+    BattleState state = NewBattleState("1", "host", "guest", 5, catalog);
+    WireBattleState client = DecodeWireState(EncodeWireState(state));
+    const BattleState before = state;
+    ApplyEndTurn(state, state.current_seat);
+    ++state.version;
+    const auto delta = EncodeWireDelta(before, state);
+
+    WireBattleState ahead = client;
+    ahead.version = 7;
+    EXPECT(ApplyThrows(ahead, delta));
+    // A truncated delta leaves the client where it was
+    for (std::size_t size = 0; size < delta.size(); ++size) {
+        WireBattleState copy = client;
+        try {
+            ApplyWireDelta(copy, std::string_view(delta).substr(0, size));
+            EXPECT(false);
+        } catch (const std::runtime_error&) {
+        }
+        EXPECT(copy == client);
+    }
+    EXPECT(!ApplyThrows(client, delta));
+}
+
+void TestMalformedState() {
+    const auto catalog = MakeBuiltinCardCatalog();
+    const auto encoded = EncodeWireState(NewBattleState("1", "host", "guest", 9, catalog));
+    EXPECT(DecodeThrows(""));
+    EXPECT(DecodeThrows("{\"session_id\":\"1\"}"));
+    for (std::size_t size = 0; size < encoded.size(); ++size) {
+        EXPECT(DecodeThrows(std::string_view(encoded).substr(0, size)));
+    }
+    EXPECT(DecodeThrows(encoded + '\0'));
+}
+
+void TestClientActions() {
+    std::vector<ClientAction> cases(8);
+    cases[0].type = ClientAction::Type::JOIN_SESSION;
+    cases[0].session_id = "session";
+    cases[0].user_id = "0d5c9a2e-6f1b-4c7a-9e3d-1b2c3d4e5f60";
+    cases[0].delta_updates = true;
+    cases[1].type = ClientAction::Type::PLAY_CARD;
+    cases[1].hand_index = 3;
+    cases[2].type = ClientAction::Type::ATTACK;
+    cases[2].attacker_index = 1;
+    cases[2].target_index = kNoSeat;
+    cases[3].type = ClientAction::Type::END_TURN;
+    cases[4].type = ClientAction::Type::SURRENDER;
+    cases[5].type = ClientAction::Type::GET_BATTLE_STATE;
+    cases[6].type = ClientAction::Type::RESYNC;
+    cases[7].type = ClientAction::Type::JOIN_SESSION;
+    cases[7].deflate = true;
+    for (const auto& action : cases) {
+        const auto encoded = EncodeClientAction(action);
+        EXPECT(DecodeClientAction(encoded) == action);
+        for (std::size_t size = 0; size < encoded.size(); ++size) {
+            EXPECT(DecodeActionThrows(std::string_view(encoded).substr(0, size)));
+        }
+        EXPECT(DecodeActionThrows(encoded + '\0'));
+    }
+    std::string unknown = EncodeClientAction(cases[3]);
+    unknown[1] = 99;
+    EXPECT(DecodeActionThrows(unknown));
+    EXPECT(DecodeActionThrows("{\"action\":\"end_turn\"}"));
+    std::string unknown_flag = EncodeClientAction(cases[0]);
+    unknown_flag.back() |= 0x80;
+    EXPECT(DecodeActionThrows(unknown_flag));
+}
+
+} // namespace
+
+int main() {
+    TestStatesAndDeltas();
+    TestDeltaIsSmall();
+    TestDeltaNeedsBaseVersion();
+    TestMalformedState();
+    TestClientActions();
+    if (g_failures != 0) {
+        std::fprintf(stderr, "%d expectation(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All battle wire tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+// Tests for battle socket frame compression.
+// Usage: frame_deflate_test
+
+#include "battle_wire.hpp"
+#include "frame_deflate.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace cardbattle;
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                    \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__,     \
+                         __LINE__, #condition);                              \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (false)
+
+// Repetitive like a battle state: the same keys and card names each time
+std::string StateLike(int version) {
+    std::string text = "{\"success\":true,\"session_id\":\"123456\",\"version\":" + std::to_string(version) +
+                       ",\"players\":{";
+    for (int card = 0; card < 12; ++card) {
+        text += "{\"id\":\"fire_imp\",\"name\":\"Fire Imp\",\"attack\":" + std::to_string((card + version) % 7) +
+                ",\"defense\":2,\"mana_cost\":2,\"type\":0},";
+    }
+    return text + "}}";
+}
+
+// Poorly compressible, and larger than the deflater's chunk
+std::string Noise(std::size_t size) {
+    std::string text(size, '\0');
+    std::uint32_t x = 2463534242u;
+    for (auto& c : text) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        c = static_cast<char>(x);
+    }
+    return text;
+}
+
+bool InflateThrows(FrameInflater& inflater, std::string_view frame) {
+    try {
+        inflater.Inflate(frame);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void TestRoundTrip(bool context_takeover) {
+    FrameDeflater deflater(6, context_takeover);
+    FrameInflater inflater(context_takeover);
+    std::vector<std::string> messages;
+    for (int version = 0; version < 20; ++version) messages.push_back(StateLike(version));
+    messages.push_back("");
+    messages.push_back(Noise(100000));
+    messages.push_back(StateLike(99));
+    for (const auto& message : messages) {
+        const std::string frame = deflater.Deflate(message);
+        EXPECT(!frame.empty() && frame[0] == static_cast<char>(WireMessageType::DEFLATED));
+        EXPECT(inflater.Inflate(frame) == message);
+    }
+}
+
+void TestContextTakeover() {
+    FrameDeflater takeover(6, true);
+    FrameDeflater standalone(6, false);
+    const std::string first = StateLike(1);
+    const std::string second = StateLike(2);
+    EXPECT(takeover.Deflate(first).size() * 2 < first.size());
+    EXPECT(standalone.Deflate(first).size() * 2 < first.size());
+    // The second state is mostly the first one over again
+    const std::size_t with_window = takeover.Deflate(second).size();
+    const std::string alone = standalone.Deflate(second);
+    EXPECT(with_window * 2 < alone.size());
+    // Without context takeover a frame does not depend on what came before,
+    // so one frame can go to every client
+    FrameDeflater fresh(6, false);
+    EXPECT(fresh.Deflate(second) == alone);
+}
+
+void TestMalformedFrame() {
+    FrameInflater inflater(false);
+    EXPECT(InflateThrows(inflater, ""));
+    EXPECT(InflateThrows(inflater, "{\"success\":true}"));
+    std::string garbage(1, static_cast<char>(WireMessageType::DEFLATED));
+    garbage += "\xff\xff\xff\xff\xff\xff";
+    EXPECT(InflateThrows(inflater, garbage));
+    // Usable again after an error without context takeover
+    FrameDeflater deflater(1, false);
+    EXPECT(inflater.Inflate(deflater.Deflate(StateLike(3))) == StateLike(3));
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip(true);
+    TestRoundTrip(false);
+    TestContextTakeover();
+    TestMalformedFrame();
+    if (g_failures != 0) {
+        std::fprintf(stderr, "%d expectation(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All frame deflate tests passed\n");
+    return EXIT_SUCCESS;
+}
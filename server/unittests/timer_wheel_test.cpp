@@ -0,0 +1,149 @@
+// Tests for the timer wheel behind battle eviction and turn timers.
+// Usage: timer_wheel_test
+
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+using cardbattle::TimerWheel;
+using std::chrono::milliseconds;
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                    \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            std::fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__,     \
+                         __LINE__, #condition);                              \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (false)
+
+const TimerWheel::Clock::time_point kStart{};
+
+std::vector<std::string> Sorted(std::vector<std::string> keys) {
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+void TestFiresAtDeadline() {
+    TimerWheel wheel(milliseconds{10}, 8, 1, kStart);
+    wheel.Schedule(kStart + milliseconds{25}, "a");  // Rounds up to tick 3
+    wheel.Schedule(kStart + milliseconds{30}, "b");
+    EXPECT(wheel.Size() == 2);
+    EXPECT(wheel.Advance(kStart + milliseconds{29}).empty());
+    EXPECT(Sorted(wheel.Advance(kStart + milliseconds{30})) == (std::vector<std::string>{"a", "b"}));
+    EXPECT(wheel.Size() == 0);
+}
+
+void TestLaterRounds() {
+    // With one level, deadlines several revolutions out share slots with
+    // near ones
+    TimerWheel wheel(milliseconds{10}, 4, 1, kStart);
+    wheel.Schedule(kStart + milliseconds{10}, "near");
+    wheel.Schedule(kStart + milliseconds{50}, "far");
+    wheel.Schedule(kStart + milliseconds{130}, "farther");
+    EXPECT(wheel.Advance(kStart + milliseconds{10}) == std::vector<std::string>{"near"});
+    EXPECT(wheel.Advance(kStart + milliseconds{40}).empty());
+    EXPECT(wheel.Advance(kStart + milliseconds{50}) == std::vector<std::string>{"far"});
+    EXPECT(wheel.Advance(kStart + milliseconds{120}).empty());
+    EXPECT(wheel.Advance(kStart + milliseconds{130}) == std::vector<std::string>{"farther"});
+}
+
+void TestLongStall() {
+    // Jumping many revolutions ahead fires everything due, once
+    TimerWheel wheel(milliseconds{10}, 4, 3, kStart);
+    for (int i = 1; i <= 20; ++i) wheel.Schedule(kStart + milliseconds{10 * i}, std::to_string(i));
+    wheel.Schedule(kStart + milliseconds{1000}, "later");
+    EXPECT(wheel.Advance(kStart + milliseconds{500}).size() == 20);
+    EXPECT(wheel.Size() == 1);
+    EXPECT(wheel.Advance(kStart + milliseconds{1000}) == std::vector<std::string>{"later"});
+}
+
+void TestPastDeadline() {
+    TimerWheel wheel(milliseconds{10}, 8, 1, kStart);
+    wheel.Advance(kStart + milliseconds{100});
+    wheel.Schedule(kStart + milliseconds{50}, "late");
+    EXPECT(wheel.Advance(kStart + milliseconds{105}).empty());
+    EXPECT(wheel.Advance(kStart + milliseconds{110}) == std::vector<std::string>{"late"});
+}
+
+void TestCascade() {
+    // 4 slots per level: level 1 slots span 40ms, level 2 slots 160ms
+    TimerWheel wheel(milliseconds{10}, 4, 3, kStart);
+    wheel.Schedule(kStart + milliseconds{30}, "level0");
+    wheel.Schedule(kStart + milliseconds{70}, "level1");
+    wheel.Schedule(kStart + milliseconds{400}, "level2");
+    wheel.Schedule(kStart + milliseconds{5000}, "beyond");
+    std::vector<std::string> fired;
+    std::vector<int> fired_at;
+    for (int ms = 10; ms <= 5000; ms += 10) {
+        for (auto& key : wheel.Advance(kStart + milliseconds{ms})) {
+            fired.push_back(std::move(key));
+            fired_at.push_back(ms);
+        }
+    }
+    EXPECT(fired == (std::vector<std::string>{"level0", "level1", "level2", "beyond"}));
+    EXPECT(fired_at == (std::vector<int>{30, 70, 400, 5000}));
+    EXPECT(wheel.Size() == 0);
+}
+
+void TestMatchesSortedDeadlines() {
+    // Every timer fires on the first Advance at or past its deadline,
+    // whatever level it started on and however far apart the calls are
+    TimerWheel wheel(milliseconds{1}, 8, 3, kStart);
+    std::uint64_t seed = 42;
+    auto next = [&seed](int bound) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<int>((seed >> 33) % static_cast<std::uint64_t>(bound));
+    };
+    std::vector<int> deadline_of;
+    int now = 0;
+    int late = 0;
+    while (now < 20000) {
+        for (int i = next(4); i > 0; --i) {
+            const int deadline = now + 1 + next(next(2) ? 50 : 3000);
+            wheel.Schedule(kStart + milliseconds{deadline}, std::to_string(deadline_of.size()));
+            deadline_of.push_back(deadline);
+        }
+        const int previous = now;
+        now += next(10) == 0 ? 1 + next(200) : 1;
+        for (const auto& key : wheel.Advance(kStart + milliseconds{now})) {
+            const int deadline = deadline_of[std::stoul(key)];
+            if (deadline > now || deadline <= previous) ++late;
+            deadline_of[std::stoul(key)] = -1;
+        }
+    }
+    EXPECT(late == 0);
+    std::size_t pending = 0;
+    for (int deadline : deadline_of) {
+        if (deadline >= 0) {
+            ++pending;
+            EXPECT(deadline > now);
+        }
+    }
+    EXPECT(wheel.Size() == pending);
+}
+
+} // namespace
+
+int main() {
+    TestFiresAtDeadline();
+    TestLaterRounds();
+    TestLongStall();
+    TestPastDeadline();
+    TestCascade();
+    TestMatchesSortedDeadlines();
+    if (g_failures != 0) {
+        std::fprintf(stderr, "%d expectation(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("All timer wheel tests passed\n");
+    return EXIT_SUCCESS;
+}